@@ -12,12 +12,18 @@
 #define ANALYSERTRACK_H_INCLUDED
 
 class AnalyserTrack : public Component,
-                      public Slider::Listener
+                      public Slider::Listener,
+                      public ComboBox::Listener,
+                      private Timer
 {
 public:
     AnalyserTrack (String channelName)
     :   channelNameLabel                  ("AnalyserTrack", channelName),
         gainLabel                         ("gainLabel", "Gain:"),
+        overlapLabel                      ("overlapLabel", "Overlap:"),
+        spectralResolutionLabel           ("spectralResolutionLabel", "Spectral window:"),
+        harmonicResolutionLabel           ("harmonicResolutionLabel", "Pitch window:"),
+        windowShapeLabel                  ("windowShapeLabel", "Window shape:"),
         audioScrollingDisplay             (1),
         featureListView                   (featureListModel),
         audioSourceTypeSelectorController (getAudioSourceTypeString)
@@ -55,6 +61,46 @@ public:
 
         addAndMakeVisible (channelNameLabel);
 
+        /* Item IDs are the number of hops per analysis window. */
+        overlapLabel.setJustificationType (Justification::centredRight);
+        overlapComboBox.addItem ("50%",   2);
+        overlapComboBox.addItem ("75%",   4);
+        overlapComboBox.addItem ("87.5%", 8);
+        overlapComboBox.setSelectedId (2, dontSendNotification);
+        overlapComboBox.addListener (this);
+        addAndMakeVisible (overlapLabel);
+        addAndMakeVisible (overlapComboBox);
+
+        /* Item IDs are the AnalysisResolution + 1. */
+        for (int r = 0; r < (int) AnalysisResolution::numResolutions; ++r)
+        {
+            spectralResolutionComboBox.addItem (AnalysisResolution::getName ((AnalysisResolution::eResolution) r), r + 1);
+            harmonicResolutionComboBox.addItem (AnalysisResolution::getName ((AnalysisResolution::eResolution) r), r + 1);
+        }
+
+        spectralResolutionComboBox.setSelectedId ((int) AnalysisResolution::enMedium + 1, dontSendNotification);
+        harmonicResolutionComboBox.setSelectedId ((int) AnalysisResolution::enMedium + 1, dontSendNotification);
+        spectralResolutionComboBox.addListener (this);
+        harmonicResolutionComboBox.addListener (this);
+        spectralResolutionLabel.setJustificationType (Justification::centredRight);
+        harmonicResolutionLabel.setJustificationType (Justification::centredRight);
+        addAndMakeVisible (spectralResolutionLabel);
+        addAndMakeVisible (spectralResolutionComboBox);
+        addAndMakeVisible (harmonicResolutionLabel);
+        addAndMakeVisible (harmonicResolutionComboBox);
+
+        /* Item IDs are the WindowTable::eShape + 1. */
+        for (int shape = 0; shape < (int) WindowTable::numShapes; ++shape)
+            windowShapeComboBox.addItem (WindowTable::getName ((WindowTable::eShape) shape), shape + 1);
+
+        windowShapeComboBox.setSelectedId ((int) WindowTable::enHann + 1, dontSendNotification);
+        windowShapeComboBox.addListener (this);
+        windowShapeLabel.setJustificationType (Justification::centredRight);
+        addAndMakeVisible (windowShapeLabel);
+        addAndMakeVisible (windowShapeComboBox);
+
+        captureStatsLabel.setJustificationType (Justification::centredLeft);
+        addAndMakeVisible (captureStatsLabel);
     }
 
     ~AnalyserTrack()
@@ -73,6 +119,11 @@ public:
         setOnsetDetectionTypeCallback     (nullptr);
         setFeatureValueQueryCallback      (nullptr);
         setGainChangedCallback            (nullptr);
+        setCaptureStatsQueryCallback      (nullptr);
+        setOverlapChangedCallback         (nullptr);
+        setSpectralResolutionChangedCallback (nullptr);
+        setHarmonicResolutionChangedCallback (nullptr);
+        setWindowShapeChangedCallback (nullptr);
     }
 
     void setChannelName (String n) { channelNameLabel.setText (n, dontSendNotification); }
@@ -101,6 +152,20 @@ public:
         sliderLabelBounds.removeFromLeft (10);
         gainLabel.setBounds (sliderLabelBounds.removeFromLeft (100));
         gainSlider.setBounds (sliderLabelBounds.removeFromLeft (100));
+        sliderLabelBounds.removeFromLeft (10);
+        overlapLabel.setBounds (sliderLabelBounds.removeFromLeft (100));
+        overlapComboBox.setBounds (sliderLabelBounds.removeFromLeft (80));
+        sliderLabelBounds.removeFromLeft (10);
+        spectralResolutionLabel.setBounds (sliderLabelBounds.removeFromLeft (110));
+        spectralResolutionComboBox.setBounds (sliderLabelBounds.removeFromLeft (80));
+        sliderLabelBounds.removeFromLeft (10);
+        harmonicResolutionLabel.setBounds (sliderLabelBounds.removeFromLeft (100));
+        harmonicResolutionComboBox.setBounds (sliderLabelBounds.removeFromLeft (80));
+        sliderLabelBounds.removeFromLeft (10);
+        windowShapeLabel.setBounds (sliderLabelBounds.removeFromLeft (100));
+        windowShapeComboBox.setBounds (sliderLabelBounds.removeFromLeft (120));
+        sliderLabelBounds.removeFromLeft (10);
+        captureStatsLabel.setBounds (sliderLabelBounds.removeFromLeft (300));
     }
 
     void sliderValueChanged (Slider* s) override
@@ -110,10 +175,44 @@ public:
                 gainChangedCallback ((float) s->getValue());
     }
 
+    void comboBoxChanged (ComboBox* c) override
+    {
+        if (c == &overlapComboBox)
+            if (overlapChangedCallback != nullptr)
+                overlapChangedCallback (c->getSelectedId());
+
+        if (c == &spectralResolutionComboBox)
+            if (spectralResolutionChangedCallback != nullptr)
+                spectralResolutionChangedCallback ((AnalysisResolution::eResolution) (c->getSelectedId() - 1));
+
+        if (c == &harmonicResolutionComboBox)
+            if (harmonicResolutionChangedCallback != nullptr)
+                harmonicResolutionChangedCallback ((AnalysisResolution::eResolution) (c->getSelectedId() - 1));
+
+        if (c == &windowShapeComboBox)
+            if (windowShapeChangedCallback != nullptr)
+                windowShapeChangedCallback ((WindowTable::eShape) (c->getSelectedId() - 1));
+    }
+
     void stopAnimation() 
     { 
         featureListView.setFeatureValueQueryCallback (nullptr); 
         featureListView.stopTimer(); 
+        stopTimer();
+        captureStatsQueryCallback = nullptr;
+    }
+
+    void timerCallback() override
+    {
+        if (captureStatsQueryCallback == nullptr)
+            return;
+
+        const CaptureStats stats = captureStatsQueryCallback();
+        captureStatsLabel.setText (String ("Dropped: ") + String (stats.samplesDropped)
+                                   + " (" + String (stats.numOverruns) + " overruns) | Max fill: "
+                                   + String (roundToInt (stats.getMaxFillProportion() * 100.0f)) + "% | Gated: "
+                                   + String (roundToInt (stats.getGatedProportion() * 100.0f)) + "%",
+                                   dontSendNotification);
     }
 
     AudioVisualiserComponent&  getAudioDisplayComponent()     { return audioScrollingDisplay; }
@@ -157,19 +256,42 @@ public:
         }
     } 
 
-    void startAnimation() { featureListView.startAnimation(); }
+    void startAnimation() 
+    { 
+        featureListView.startAnimation(); 
+        startTimerHz (4);
+    }
 
     void setOnsetSensitivityCallback   (std::function<void (float)> f)                                         { featureListView.setOnsetSensitivityCallback (f); }
     void setOnsetWindowSizeCallback    (std::function<void (int)> f)                                           { featureListView.setOnsetWindowLengthCallback (f); }
     void setOnsetDetectionTypeCallback (std::function<void (OnsetDetector::eOnsetDetectionType)> f)            { featureListView.setOnsetDetectionTypeCallback (f); }
     void setFeatureValueQueryCallback  (std::function<float (AudioFeatures::eAudioFeature, float maxValue)> f) { featureListView.setFeatureValueQueryCallback (f); }
     void setGainChangedCallback        (std::function<void (float)> f)                                         { gainChangedCallback = f; }
+    void setCaptureStatsQueryCallback  (std::function<CaptureStats()> f)                                       { captureStatsQueryCallback = f; }
+    void setOverlapChangedCallback     (std::function<void (int hopsPerWindow)> f)                             { overlapChangedCallback = f; }
+    void setSpectralResolutionChangedCallback (std::function<void (AnalysisResolution::eResolution)> f)        { spectralResolutionChangedCallback = f; }
+    void setHarmonicResolutionChangedCallback (std::function<void (AnalysisResolution::eResolution)> f)        { harmonicResolutionChangedCallback = f; }
+    void setWindowShapeChangedCallback        (std::function<void (WindowTable::eShape)> f)                    { windowShapeChangedCallback = f; }
 
 private:
     std::function<void (float)>     gainChangedCallback;
+    std::function<CaptureStats()>   captureStatsQueryCallback;
+    std::function<void (int)>       overlapChangedCallback;
+    std::function<void (AnalysisResolution::eResolution)> spectralResolutionChangedCallback;
+    std::function<void (AnalysisResolution::eResolution)> harmonicResolutionChangedCallback;
+    std::function<void (WindowTable::eShape)>             windowShapeChangedCallback;
     Label                           channelNameLabel;
+    Label                           captureStatsLabel;
     Label                           gainLabel;
     Slider                          gainSlider;
+    Label                           overlapLabel;
+    ComboBox                        overlapComboBox;
+    Label                           spectralResolutionLabel;
+    ComboBox                        spectralResolutionComboBox;
+    Label                           harmonicResolutionLabel;
+    ComboBox                        harmonicResolutionComboBox;
+    Label                           windowShapeLabel;
+    ComboBox                        windowShapeComboBox;
     AudioSampleBuffer               bufferToPush;
     AudioVisualiserComponent        audioScrollingDisplay;
     AudioFileTransportController    audioFileTransportController;
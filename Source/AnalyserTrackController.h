@@ -14,43 +14,62 @@
 class AnalyserTrackController
 {
 public:
-    AnalyserTrackController (AudioDeviceManager& deviceManagerRef, int channelToAnalyse, String nameOfInputChannel, String ip, String secondaryIP, String bundle)
-    :   audioDataCollectorHarm    (channelToAnalyse),
-        audioDataCollectorSpec    (channelToAnalyse),
-        audioAnalyserHarm         (audioDataCollectorHarm, features, 2048),
-        audioAnalyserSpec         (audioDataCollectorSpec, features, 2048),
+    /* If batchedAnalyserToUse isn't null, this track's analysers run on it instead of their own threads. */
+    AnalyserTrackController (AudioDeviceManager& deviceManagerRef, MultiChannelAudioCapture& captureRef, int channelToAnalyse, String nameOfInputChannel, String ip, String secondaryIP, String bundle,
+                             BatchedRealTimeAnalyser* batchedAnalyserToUse = nullptr)
+    :   audioDataCollectorHarm    (captureRef.getRing (channelToAnalyse)),
+        audioDataCollectorSpec    (captureRef.getRing (channelToAnalyse)),
+        audioAnalyserHarm         (audioDataCollectorHarm, features, AnalysisResolution::getWindowSize (AnalysisResolution::enMedium, getDefaultSampleRate())),
+        audioAnalyserSpec         (audioDataCollectorSpec, features, AnalysisResolution::getWindowSize (AnalysisResolution::enMedium, getDefaultSampleRate())),
+        spectralStage             (AnalysisResolution::getWindowSize (AnalysisResolution::enMedium, getDefaultSampleRate())),
+        harmonicStage             (AnalysisResolution::getWindowSize (AnalysisResolution::enMedium, getDefaultSampleRate())),
+        cepstralStage             (AnalysisResolution::getWindowSize (AnalysisResolution::enMedium, getDefaultSampleRate())),
+        chromaStage               (AnalysisResolution::getWindowSize (AnalysisResolution::enMedium, getDefaultSampleRate())),
+        multiPitchStage           (AnalysisResolution::getWindowSize (AnalysisResolution::enMedium, getDefaultSampleRate())),
         oscFeatureSender          (features, ip, bundle),
         secondaryOSCFeatureSender (features, secondaryIP, bundle),
         deviceManager             (deviceManagerRef),
+        capture                   (captureRef),
+        batchedAnalyser           (batchedAnalyserToUse),
         channelName               (nameOfInputChannel)
     {
         enabled = channelToAnalyse >= 0;
 
+        oscFeatureSender.setCaptureStatsQueryCallback          ([this]() { return getCaptureStats(); });
+        secondaryOSCFeatureSender.setCaptureStatsQueryCallback ([this]() { return getCaptureStats(); });
+        oscFeatureSender.setCapturePositionQueryCallback          ([this]() { return capture.getSamplePosition(); });
+        secondaryOSCFeatureSender.setCapturePositionQueryCallback ([this]() { return capture.getSamplePosition(); });
+
         if (enabled)
         {
             audioDataCollectorHarm.setNotifyAnalysisThreadCallback ([this]()
             {
-                audioAnalyserHarm.notify();
+                notifyAnalysisThread (audioAnalyserHarm);
             });
-            deviceManager.addAudioCallback (&audioDataCollectorHarm);
 
             audioDataCollectorSpec.setNotifyAnalysisThreadCallback ([this]()
             {
-                audioAnalyserSpec.notify();
+                notifyAnalysisThread (audioAnalyserSpec);
             });
-            deviceManager.addAudioCallback (&audioDataCollectorSpec);
+            capture.addReader (&audioDataCollectorSpec);
 
-            audioFilePlayer.setupAudioCallback (deviceManager);
+            AudioCaptureRing& ring = captureRef.getRing (channelToAnalyse);
+            audioFilePlayer.setupAudioCallback (deviceManager, channelToAnalyse, [this, &ring] (const float* data, int numSamples)
+            {
+                capture.writePlayback (ring, data, numSamples);
+            });
         } 
+
+        updateAnalysisRouting();
     }
 
     ~AnalyserTrackController()
     {
         if (enabled)
         {
-            deviceManager.removeAudioCallback (audioFilePlayer.getAudioSourcePlayer());
-            deviceManager.removeAudioCallback (&audioDataCollectorHarm);
-            deviceManager.removeAudioCallback (&audioDataCollectorSpec);
+            audioFilePlayer.removeAudioCallback (deviceManager);
+            setHarmonicReaderRegistered (false);
+            capture.removeReader (&audioDataCollectorSpec);
         }
         stopAnalysis();
         audioDataCollectorHarm.setNotifyAnalysisThreadCallback (nullptr);
@@ -62,7 +81,7 @@ public:
     {
         audioDataCollectorHarm.setBufferToDrawUpdatedCallback  (nullptr);
         audioDataCollectorSpec.setBufferToDrawUpdatedCallback  (nullptr);
-        audioAnalyserSpec.setOnsetDetectedCallback             (nullptr);
+        spectralStage.setOnsetDetectedCallback                 (nullptr);
         setGUITrackSamplesPerBlockCallback                = nullptr;
     }
 
@@ -71,13 +90,14 @@ public:
         stopAnalysis();
         guiTrack->setChannelName (getChannelName());
         guiTrack->getOSCSettingsController().getView().setBundleAddress (oscBundleAddress);
-        audioDataCollectorHarm.setBufferToDrawUpdatedCallback ([this, guiTrack] (AudioSampleBuffer& b) 
+        //the spectral analyser always runs, so its collector feeds the display
+        audioDataCollectorSpec.setBufferToDrawUpdatedCallback ([this, guiTrack] (AudioSampleBuffer& b) 
         {
             if (guiTrack != nullptr)
                 guiTrack->updateBufferToPush (&b);
         });
 
-        audioAnalyserSpec.setOnsetDetectedCallback ([this, guiTrack] () 
+        spectralStage.setOnsetDetectedCallback ([this, guiTrack] () 
         {
             if (guiTrack != nullptr)
                 guiTrack->featureTriggered (AudioFeatures::eAudioFeature::enOnset);            
@@ -88,6 +108,8 @@ public:
             return getAudioFeature (featureType) / maxValue;
         });
 
+        guiTrack->setCaptureStatsQueryCallback ([this]() { return getCaptureStats(); });
+
         //switches between listening to input or output
         guiTrack->setAudioSourceTypeChangedCallback ([this, guiTrack] (eAudioSourceType type) 
         { 
@@ -129,9 +151,15 @@ public:
             audioDataCollectorSpec.setGain (g);
         });
 
-        guiTrack->setOnsetSensitivityCallback   ([this] (float s)                              { audioAnalyserSpec.setOnsetDetectionSensitivity (s); });
-        guiTrack->setOnsetWindowSizeCallback    ([this] (int s)                                { audioAnalyserSpec.setOnsetWindowLength (s); });
-        guiTrack->setOnsetDetectionTypeCallback ([this] (OnsetDetector::eOnsetDetectionType t) { audioAnalyserSpec.setOnsetDetectionType (t); });
+        guiTrack->setOverlapChangedCallback ([this] (int hopsPerWindow) { setHopsPerWindow (hopsPerWindow); });
+
+        guiTrack->setSpectralResolutionChangedCallback ([this] (AnalysisResolution::eResolution r) { spectralResolution = r; updateAnalysisRouting(); });
+        guiTrack->setHarmonicResolutionChangedCallback ([this] (AnalysisResolution::eResolution r) { harmonicResolution = r; updateAnalysisRouting(); });
+        guiTrack->setWindowShapeChangedCallback        ([this] (WindowTable::eShape s)             { setWindowShape (s); });
+
+        guiTrack->setOnsetSensitivityCallback   ([this] (float s)                              { spectralStage.setOnsetDetectionSensitivity (s); });
+        guiTrack->setOnsetWindowSizeCallback    ([this] (int s)                                { spectralStage.setOnsetWindowLength (s); });
+        guiTrack->setOnsetDetectionTypeCallback ([this] (OnsetDetector::eOnsetDetectionType t) { spectralStage.setOnsetDetectionType (t); });
         guiTrack->setPlayPressedCallback        ([this] ()                                     { audioFilePlayer.play(); clearAnalysisBuffers(); });
         guiTrack->setPausePressedCallback       ([this] ()                                     { audioFilePlayer.pause(); clearAnalysisBuffers(); });
         guiTrack->setStopPressedCallback        ([this] ()                                     { audioFilePlayer.stop(); clearAnalysisBuffers(); });
@@ -164,6 +192,157 @@ public:
         guiTrack->startAnimation();
     }
 
+    /* Sets the overlap of both analysers' windows, e.g. 2, 4 and 8 hops per window give 50%, 75% and 87.5% overlap. */
+    void setHopsPerWindow (int hopsPerWindow)
+    {
+        jassert (hopsPerWindow > 0);
+        audioAnalyserHarm.getOverlapper().setHopSize (audioAnalyserHarm.getOverlapper().getWindowSize() / hopsPerWindow);
+        audioAnalyserSpec.getOverlapper().setHopSize (audioAnalyserSpec.getOverlapper().getWindowSize() / hopsPerWindow);
+    }
+
+    /* Sets the analysis window used by both analysers and the pitch estimator. */
+    void setWindowShape (WindowTable::eShape shape)
+    {
+        const bool wasRunning = isAnalysing();
+        stopAnalysis();
+
+        audioAnalyserSpec.setWindowShape (shape);
+        audioAnalyserHarm.setWindowShape (shape);
+        harmonicStage.setWindowShape (shape);
+
+        if (wasRunning)
+            startAnalysis();
+    }
+
+    /* 
+        Assigns the feature stages to analysers. The spectral stage always runs on audioAnalyserSpec. When the 
+        harmonic stage wants the same resolution it runs there too and shares the frame, otherwise it gets 
+        audioAnalyserHarm to itself. An idle analyser's collector is unsubscribed from the capture ring.
+    */
+    void updateAnalysisRouting()
+    {
+        const bool wasRunning = isAnalysing();
+        stopAnalysis();
+
+        audioAnalyserSpec.clearStages();
+        audioAnalyserHarm.clearStages();
+        setAnalyserWindowSize (audioAnalyserSpec, spectralResolution);
+        audioAnalyserSpec.addStage (&spectralStage);
+        audioAnalyserSpec.addStage (&cepstralStage);
+
+        const bool harmonicSharesFrame = harmonicResolution == spectralResolution;
+
+        if (harmonicSharesFrame)
+        {
+            audioAnalyserSpec.addStage (&harmonicStage);
+            audioAnalyserSpec.addStage (&chromaStage);
+            audioAnalyserSpec.addStage (&multiPitchStage);
+        }
+        else
+        {
+            setAnalyserWindowSize (audioAnalyserHarm, harmonicResolution);
+            audioAnalyserHarm.addStage (&harmonicStage);
+            audioAnalyserHarm.addStage (&chromaStage);
+            audioAnalyserHarm.addStage (&multiPitchStage);
+        }
+
+        setHarmonicReaderRegistered (! harmonicSharesFrame);
+
+        if (wasRunning)
+            startAnalysis();
+    }
+
+    /* Changes how many MFCCs are calculated (and sent over OSC), from how many mel bands. */
+    void setMFCCConfiguration (int numCoefficients, int numBands)
+    {
+        jassert (numCoefficients > 0 && numCoefficients <= numBands);
+        const bool wasRunning = isAnalysing();
+        stopAnalysis();
+
+        cepstralStage.setNumCoefficientsAndBands (numCoefficients, numBands);
+        features.setVectorFeatureSize (AudioFeatures::eVectorFeature::enMFCCs, numCoefficients);
+
+        if (wasRunning)
+            startAnalysis();
+    }
+
+    /* Sets the chromagram's resolution (12 or 36 bins per octave) and its tuning, in cents from A440. */
+    void setChromaConfiguration (int binsPerOctave, double tuningOffsetCents)
+    {
+        const bool wasRunning = isAnalysing();
+        stopAnalysis();
+
+        chromaStage.setResolutionAndTuning (binsPerOctave, tuningOffsetCents);
+        features.setVectorFeatureSize (AudioFeatures::eVectorFeature::enChroma, binsPerOctave);
+
+        if (wasRunning)
+            startAnalysis();
+    }
+
+    /* 
+        Sets how many simultaneous pitches (up to 16) are reported for chords, and the range (in Hz) their 
+        fundamentals are searched over. Low notes need the long harmonic resolution to separate their harmonics.
+    */
+    void setMultiPitchConfiguration (int maxNumPitches, double minFrequency, double maxFrequency)
+    {
+        const bool wasRunning = isAnalysing();
+        stopAnalysis();
+
+        multiPitchStage.setConfiguration (maxNumPitches, minFrequency, maxFrequency);
+        features.setVectorFeatureSize (AudioFeatures::eVectorFeature::enPitches, 2 * maxNumPitches);
+
+        if (wasRunning)
+            startAnalysis();
+    }
+
+    /* 
+        Limits pitch estimation to fundamentals between minFrequency and maxFrequency (in Hz). A narrow range 
+        (a voice, say) is cheaper to search and can't jump an octave outside it. The search only reaches lags of 
+        half the harmonic window, so the lowest pitches also need a long enough harmonic resolution.
+    */
+    void setPitchRange (double minFrequency, double maxFrequency)
+    {
+        const bool wasRunning = isAnalysing();
+        stopAnalysis();
+
+        harmonicStage.setPitchRange (minFrequency, maxFrequency);
+
+        if (wasRunning)
+            startAnalysis();
+    }
+
+    /* 
+        How many frames (up to 7) the pitch tracker waits before deciding a frame's pitch. Waiting lets later 
+        frames correct octave errors, at the cost of that many hops of latency on the pitch and voicing.
+    */
+    void setPitchTrackingLag (int numFrames)
+    {
+        const bool wasRunning = isAnalysing();
+        stopAnalysis();
+
+        harmonicStage.setPitchTrackingLag (numFrames);
+
+        if (wasRunning)
+            startAnalysis();
+    }
+
+    /* 
+        Skips the analysis of both resolutions while the track is quiet: the features read as silence once the level 
+        has stayed under closeThresholdDb (dBFS RMS, after the track's gain) for holdMs, and analysis resumes as soon 
+        as a hop reaches openThresholdDb.
+    */
+    void setSilenceGate (bool shouldBeEnabled, float openThresholdDb, float closeThresholdDb, double holdMs)
+    {
+        const bool wasRunning = isAnalysing();
+        stopAnalysis();
+
+        audioAnalyserHarm.setSilenceGate (shouldBeEnabled, openThresholdDb, closeThresholdDb, holdMs / 1000.0);
+        audioAnalyserSpec.setSilenceGate (shouldBeEnabled, openThresholdDb, closeThresholdDb, holdMs / 1000.0);
+
+        if (wasRunning)
+            startAnalysis();
+    }
+
     void clearAnalysisBuffers()
     {
         audioDataCollectorHarm.clearBuffer();
@@ -172,42 +351,131 @@ public:
 
     float getAudioFeature      (AudioFeatures::eAudioFeature featureType) const { return features.getValue (featureType); }
 
-    void prepareToPlay (int samplesPerBlockExpected, double sampleRate)
+    /* The combined health counters of this track's collectors. Safe to call from any thread. */
+    CaptureStats getCaptureStats() const
+    {
+        CaptureStats stats = audioDataCollectorHarm.getStats();
+        stats.add (audioDataCollectorSpec.getStats());
+        return stats;
+    }
+
+    void prepareToPlay (int samplesPerBlockExpected, double newSampleRate)
     {
         stopAnalysis();
+        sampleRate = newSampleRate;
         audioAnalyserHarm.sampleRateChanged (sampleRate);
         audioAnalyserSpec.sampleRateChanged (sampleRate);
+        //window lengths are in ms, so the window sizes follow the sample rate
+        updateAnalysisRouting();
 
         if (setGUITrackSamplesPerBlockCallback != nullptr)
             setGUITrackSamplesPerBlockCallback (samplesPerBlockExpected);
         
-        audioAnalyserHarm.startThread (4);
+        startAnalysis();
+    }
+
+    void startAnalysis()
+    {
+        if (batchedAnalyser != nullptr)
+        {
+            if (audioAnalyserHarm.hasStages())
+                batchedAnalyser->addAnalyser (&audioAnalyserHarm);
+
+            batchedAnalyser->addAnalyser (&audioAnalyserSpec);
+            return;
+        }
+
+        if (audioAnalyserHarm.hasStages())
+            audioAnalyserHarm.startThread (4);
+
         audioAnalyserSpec.startThread (4);
-        audioDataCollectorHarm.setExpectedSamplesPerBlock (samplesPerBlockExpected);
-        audioDataCollectorSpec.setExpectedSamplesPerBlock (samplesPerBlockExpected);
     }
 
     void stopAnalysis()
     {
+        if (batchedAnalyser != nullptr)
+        {
+            batchedAnalyser->removeAnalyser (&audioAnalyserHarm);
+            batchedAnalyser->removeAnalyser (&audioAnalyserSpec);
+            return;
+        }
+
         audioAnalyserHarm.stopThread (100);
         audioAnalyserSpec.stopThread (100);
     }
 
+    bool isAnalysing()
+    {
+        if (batchedAnalyser != nullptr)
+            return batchedAnalyser->containsAnalyser (&audioAnalyserSpec);
+
+        return audioAnalyserSpec.isThreadRunning();
+    }
+
     String getChannelName() const noexcept { return channelName; }
     bool isEnabled()        const noexcept { return enabled; }
 private: 
+    /* Called from the audio thread when a collector has a hop ready. */
+    void notifyAnalysisThread (RealTimeAnalyser& analyser)
+    {
+        if (batchedAnalyser != nullptr)
+            batchedAnalyser->notify();
+        else
+            analyser.notify();
+    }
+
+    /* Used to size the analysers until the device reports its sample rate. */
+    static double getDefaultSampleRate() noexcept { return 48000.0; }
+
+    void setAnalyserWindowSize (RealTimeAnalyser& analyser, AnalysisResolution::eResolution resolution)
+    {
+        const int windowSize = AnalysisResolution::getWindowSize (resolution, sampleRate);
+
+        if (analyser.getWindowSize() != windowSize)
+            analyser.setWindowSize (windowSize);
+    }
+
+    void setHarmonicReaderRegistered (bool shouldBeRegistered)
+    {
+        if (! enabled || shouldBeRegistered == harmonicReaderRegistered)
+            return;
+
+        if (shouldBeRegistered)
+        {
+            audioDataCollectorHarm.clearBuffer();
+            capture.addReader (&audioDataCollectorHarm);
+        }
+        else
+        {
+            capture.removeReader (&audioDataCollectorHarm);
+        }
+
+        harmonicReaderRegistered = shouldBeRegistered;
+    }
+
     std::function<void (int)> setGUITrackSamplesPerBlockCallback;
     AudioFilePlayer          audioFilePlayer;
     AudioFeatures            features;
     AudioDataCollector       audioDataCollectorHarm;
     AudioDataCollector       audioDataCollectorSpec;
-    RealTimeHarmonicAnalyser audioAnalyserHarm;
-    RealTimeSpectralAnalyser audioAnalyserSpec;
+    RealTimeAnalyser         audioAnalyserHarm;
+    RealTimeAnalyser         audioAnalyserSpec;
+    SpectralAnalysisStage    spectralStage;
+    HarmonicAnalysisStage    harmonicStage;
+    CepstralAnalysisStage    cepstralStage;
+    ChromaAnalysisStage      chromaStage;
+    MultiPitchAnalysisStage  multiPitchStage;
     OSCFeatureAnalysisOutput oscFeatureSender;
     OSCFeatureAnalysisOutput secondaryOSCFeatureSender;
     AudioDeviceManager       &deviceManager;
+    MultiChannelAudioCapture &capture;
+    BatchedRealTimeAnalyser  *batchedAnalyser;
     String                   channelName;
     bool                     enabled { true };
+    bool                     harmonicReaderRegistered { false };
+    double                   sampleRate { getDefaultSampleRate() };
+    AnalysisResolution::eResolution spectralResolution { AnalysisResolution::enMedium };
+    AnalysisResolution::eResolution harmonicResolution { AnalysisResolution::enMedium };
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (AnalyserTrackController);
 };
 
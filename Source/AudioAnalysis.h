@@ -109,7 +109,7 @@ struct AudioAnalyser
         previousF0 (0.0),
         fftIn      (numChannels, windowSize),
         fftOut     (numChannels, windowSize / 2 + 1),
-        fft        (/*order*/int (log(windowSize)/log(2) + 1e-6), /*inverse*/false),
+        fft        (windowSize),
         complexForwardFFT (int (log(windowSize)/log(2) + 1e-6), false),
         complexInverseFFT (int (log(windowSize)/log(2) + 1e-6), true),
         analyseSpectralCharacteristics (spectralFeatures),
@@ -181,7 +181,7 @@ struct AudioAnalyser
             scaleBufferWithBartlettWindowing (fftIn);
             
             jassert (numFFTInputSamples <= 4096);
-            float temp[4096];
+            float temp[8192];
 
             if (analyseHarmonicCharacteristics)
             {
@@ -205,7 +205,7 @@ struct AudioAnalyser
                 //complexInverseFFT.perform (complexFFTOut.getData(), complexFFTAutoCorrelation.getData());
                 //analyseAutoCorrelation (complexFFTAutoCorrelation.getData(), fftIn.getNumSamples());
 
-                fft.performFrequencyOnlyForwardTransform (temp);
+                fft.performFrequencyOnlyForward (temp, numFFTInputSamples * 2);
 
                 auto fftOutErr = 0.0f;
                 //for (int i = 0; i < numFFTInputSamples; i++)
@@ -260,20 +260,18 @@ struct AudioAnalyser
 
         size_t numBins = (size_t) fftResults.getNumSamples();// /2 /2
 
-        //calculate mean bin magnitude and maximum bin magnitude
-        double meanMagnitude = 0.0;
+        //calculate the total bin magnitude
         double magnitudeSum = 0.0;
         for (size_t i = 0; i < numBins; i++)
         {
             double binMagnitude = (double) fftResults.getSample (channel, (int)i);
             magnitudeSum += binMagnitude;
         }
-        meanMagnitude = magnitudeSum / (double) numBins;
 
         if (magnitudeSum < 0.001)
             return {0.0, 0.0, 0.0};
 
-        fillPeakBinsAndFrequencyHistogram (fftResults, channel, peakBins, frequencyHistogram, meanMagnitude);
+        fillPeakBinsAndFrequencyHistogram (fftResults, channel, peakBins, frequencyHistogram);
 
         F0Candidate f0 = estimateF0AndHERFromFrequencyHistogram (fftResults, channel, frequencyHistogram, magnitudeSum);
         if (previousF0 != f0.frequency && previousF0 > 10.0)
@@ -347,41 +345,18 @@ struct AudioAnalyser
         return higher / lower;
     }
 
+    /* Finds the channel's peaks with the same SpectralPeaks as the real-time analysers, and builds the histogram of their bin intervals. */
     void fillPeakBinsAndFrequencyHistogram (AudioSampleBuffer& fftResults, 
                                             int channel, 
                                             std::vector<int>& peakBins, 
-                                            std::vector<F0Candidate>& histogram,
-                                            double meanMagnitude)
+                                            std::vector<F0Candidate>& histogram)
     {
-        size_t numBins = (size_t) fftResults.getNumSamples();
-        for (size_t bin = 0; bin < numBins; bin++)
-        {
-            bool peak = binIsPeak ((int) bin, fftResults, channel, meanMagnitude);
-            
-            if (peak)
-                addNewPeakBinAndUpdateHistogram ((int) bin, peakBins, histogram);
-        }
-    }
-
-    bool binIsPeak (int bin, AudioSampleBuffer& fftResults, int channel, double meanMagnitude)
-    {
-        int numBins = fftResults.getNumSamples();
-        double binMagnitude = (double) fftResults.getSample (channel, bin);
-        //return binMagnitude > meanMagnitude;
-        
-        if (binMagnitude <= meanMagnitude)
-            return false;
+        const int numBins = fftResults.getNumSamples();
+        spectralPeaks.setSize (numBins);
+        spectralPeaks.findPeaks (fftResults.getReadPointer (channel), numBins, nyquist / (double) numBins);
 
-        //offsets to ensure no out of bounds checks
-        int leftBinOffset  = bin < 2 ? 2 - bin : 0;
-        int rightBinOffset = bin >= numBins - 2 ? 2 - ((numBins - 1) - bin) : 0; 
-        for (int neighbour = bin - (2 - leftBinOffset); neighbour < bin + (2 - rightBinOffset); neighbour++)
-        {
-            double neighbourMagnitude = (double) fftResults.getSample (channel, neighbour);
-            if (neighbour != bin && neighbourMagnitude > binMagnitude)
-                return false;
-        }
-        return true;
+        for (auto& peak : spectralPeaks)
+            addNewPeakBinAndUpdateHistogram (peak.bin, peakBins, histogram);
     }
 
     void addNewPeakBinAndUpdateHistogram (int newPeakBin, std::vector<int>& peakBins, std::vector<F0Candidate>& histogram)
@@ -664,21 +639,16 @@ struct AudioAnalyser
         return indexOfMax;
     }
 
-    static void scaleBufferWithBartlettWindowing (AudioSampleBuffer& source) // TODO: change to DSPMultiBlock
+    static void scaleBufferWithBartlettWindowing (AudioSampleBuffer& source)
     {
-        int numSamples = source.getNumSamples();
-        
-        for (int channel = 0; channel < source.getNumChannels(); ++channel)
-        {
-            source.applyGainRamp (channel, 0, numSamples / 2, 0.0f, 1.0f);
-            source.applyGainRamp (channel, numSamples / 2, numSamples / 2, 1.0f, 0.0f);
-        }
+        RealTimeWindower::scaleBufferWithBartlettWindowing (source);
     }
     
     void setWindowSize (int samplesPerWindow)
     {
         fftIn.setSize  (fftIn.getNumChannels(),  samplesPerWindow);
         fftOut.setSize (fftOut.getNumChannels(), samplesPerWindow / 2 + 1);
+        fft.setWindowSize (samplesPerWindow);
 
         //fftAutoCorrelationData.allocate (samplesPerWindow, true);
         //complexFFTIn.allocate              (samplesPerWindow, true);
@@ -690,7 +660,7 @@ struct AudioAnalyser
     double              previousF0;
     AudioSampleBuffer   fftIn;
     AudioSampleBuffer   fftOut;
-    FFT                 fft;
+    RealTimeFFT         fft;
     FFT                 complexForwardFFT;
     FFT                 complexInverseFFT;
     //HeapBlock<FFT::Complex> complexFFTIn;
@@ -698,6 +668,7 @@ struct AudioAnalyser
     //HeapBlock<FFT::Complex> complexFFTAutoCorrelation;
     //HeapBlock<float>    fftAutoCorrelationData;
     std::vector<double> previousBinMagnitudes;
+    SpectralPeaks       spectralPeaks;
     bool                analyseSpectralCharacteristics;
     bool                analyseHarmonicCharacteristics;
     
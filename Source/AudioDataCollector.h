@@ -13,86 +13,376 @@
 
 //==============================================================================
 /*
-    Periodically collects the incoming audio into a buffer that is used for audio feature extraction
+    Ring buffer holding the captured audio of a single device channel.
+
+    There is exactly one writer (the audio thread, via MultiChannelAudioCapture) and any number of
+    readers (AudioDataCollectors), each of which keeps its own read position. writePosition is an
+    absolute (monotonic) sample position. The writer publishes a block by storing writePosition after
+    the samples have been copied, so a reader never touches samples at or above the position it loaded.
+    The writer never waits for readers: a reader that falls more than a ring's worth behind is lapped
+    and has to skip forward.
+
+    writePosition advances with the device sample clock even while the ring has no readers (see advance()),
+    so any position read from the ring is a sample-accurate time stamp for the capture stream.
+
+    Alongside the samples the writer records the energy of every energySegmentSize() samples, so readers can 
+    measure the level of any stretch of the ring (see getMeanSquare()) without reading the audio.
 */
-class AudioDataCollector : public AudioIODeviceCallback
+class AudioCaptureRing
 {
 public:
-    AudioDataCollector (int audioChannelToCollect)
-    :   channelToCollect (audioChannelToCollect)
+    AudioCaptureRing (int ringSize)
     {
-        circleBuffer.setSize (1, 4096);
-        circleBuffer.clear();
+        jassert (isPowerOfTwo (ringSize));
+        ring.setSize (1, ringSize);
+        ring.clear();
+        segmentEnergies.calloc ((size_t) (ringSize / energySegmentSize()));
     }
 
-    void audioDeviceAboutToStart (AudioIODevice* d) override
+    /* The number of samples each recorded energy covers. Much shorter than any hop, so a hop's level is accurate. */
+    static int energySegmentSize() noexcept { return 32; }
+
+    /* Audio thread only. */
+    void write (const float* data, int numSamples) noexcept
     {
-        jassert(channelToCollect <= d->getActiveInputChannels().getHighestBit());
+        jassert (numSamples <= ring.getNumSamples());
+        const int64 currentWritePosition = writePosition.get();
+        const int   writeIndex           = getRingIndex (currentWritePosition);
+
+        const int numBeforeWrap          = jmin (numSamples, ring.getNumSamples() - writeIndex);
+        float* ringData                  = ring.getWritePointer (0);
+
+        /* At most two contiguous block copies: up to the end of the ring, then from its start. */
+        FloatVectorOperations::copy (ringData + writeIndex, data, numBeforeWrap);
+
+        if (numBeforeWrap < numSamples)
+            FloatVectorOperations::copy (ringData, data + numBeforeWrap, numSamples - numBeforeWrap);
+
+        accumulateSegmentEnergies (currentWritePosition, data, numSamples);
+
+        /* Publish the new samples. Nothing after this point writes to the ring. */
+        writePosition.set (currentWritePosition + numSamples);
     }
 
-    void audioDeviceStopped() override
-    { }
+    /* Audio thread only. Writes a block of silence, for a channel the device didn't deliver. */
+    void writeSilence (int numSamples) noexcept
+    {
+        jassert (numSamples <= ring.getNumSamples());
+        const int64 currentWritePosition = writePosition.get();
+        const int   writeIndex           = getRingIndex (currentWritePosition);
+        const int   numBeforeWrap        = jmin (numSamples, ring.getNumSamples() - writeIndex);
 
-    void audioDeviceIOCallback (const float** inputChannelData, int numInputChannels,
-                                float** outputChannelData, int numOutputChannels,
-                                int numberOfSamples) override
+        ring.clear (0, writeIndex, numBeforeWrap);
+
+        if (numBeforeWrap < numSamples)
+            ring.clear (0, 0, numSamples - numBeforeWrap);
+
+        accumulateSegmentEnergies (currentWritePosition, nullptr, numSamples);
+        writePosition.set (currentWritePosition + numSamples);
+    }
+
+    /* Audio thread only. Moves the clock on without copying, for blocks nobody is reading. */
+    void advance (int numSamples) noexcept
     {
-        ignoreUnused (numInputChannels);
-        ignoreUnused (numOutputChannels);
-        const float* const* channelData = collectInput ? inputChannelData : outputChannelData;
+        writePosition.set (writePosition.get() + numSamples);
+    }
 
-        if (collectInput)
-            jassert (numInputChannels >= channelToCollect);
-        if (!collectInput)
-            jassert (numOutputChannels >= channelToCollect);
+    /*
+        The mean square of the samples from startPosition, from the energies of the segments that overlap them,
+        so up to a segment either side is included. Segments the audio thread hasn't finished are left out, and
+        if that leaves none the level is unknown and -1 is returned. Any thread.
+    */
+    float getMeanSquare (int64 startPosition, int numSamples) const noexcept
+    {
+        const int   segmentSize  = energySegmentSize();
+        const int64 firstSegment = startPosition / segmentSize;
+        const int64 endSegment   = jmin ((startPosition + numSamples + segmentSize - 1) / segmentSize, 
+                                         getWritePosition() / segmentSize);
 
-        analysisBufferUpdating.set (1);
+        if (endSegment <= firstSegment)
+            return -1.0f;
 
-        if (writeIndex + numberOfSamples <= circleBuffer.getNumSamples())
+        float energy = 0.0f;
+        for (int64 segment = firstSegment; segment < endSegment; ++segment)
+            energy += segmentEnergies[getSegmentIndex (segment)];
+
+        return energy / (float) ((endSegment - firstSegment) * segmentSize);
+    }
+
+    int64        getWritePosition()               const noexcept { return writePosition.get(); }
+    int          getRingIndex (int64 position)    const noexcept { return (int) (position & (int64) (ring.getNumSamples() - 1)); }
+    int          getSize()                        const noexcept { return ring.getNumSamples(); }
+    const float* getReadPointer()                 const noexcept { return ring.getReadPointer (0); }
+
+    /* Any thread. When the ring isn't collecting input, its track's AudioFilePlayer writes it instead (see MultiChannelAudioCapture::writePlayback()). */
+    void setCollectInput (bool shouldCollectInput)      noexcept { collectInput.set (shouldCollectInput ? 1 : 0); }
+    bool isCollectingInput()                      const noexcept { return collectInput.get() != 0; }
+
+    void addReader()                                    noexcept { ++numReaders; }
+    void removeReader()                                 noexcept { numReaders -= 1; }
+    bool hasReaders()                             const noexcept { return numReaders.get() > 0; }
+
+private:
+    /* 
+        Adds the squares of a block to the energies of the segments it covers. A segment is restarted from its 
+        first sample, so it always holds the energy of the last samples written to its part of the ring. 
+        Null data is a block of silence.
+    */
+    void accumulateSegmentEnergies (int64 position, const float* data, int numSamples) noexcept
+    {
+        const int segmentSize = energySegmentSize();
+
+        while (numSamples > 0)
         {
-            circleBuffer.copyFrom (0, writeIndex, channelData[channelToCollect], numberOfSamples);
+            const int offsetInSegment = (int) (position & (int64) (segmentSize - 1));
+            const int numInSegment    = jmin (numSamples, segmentSize - offsetInSegment);
+
+            const float energy = data == nullptr             ? 0.0f
+                               : numInSegment == segmentSize ? getSegmentEnergy (data) 
+                                                             : getEnergy (data, numInSegment);
+
+            float& segmentEnergy = segmentEnergies[getSegmentIndex (position / segmentSize)];
+            segmentEnergy = offsetInSegment == 0 ? energy : segmentEnergy + energy;
+
+            position   += numInSegment;
+            numSamples -= numInSegment;
+
+            if (data != nullptr)
+                data += numInSegment;
         }
-        else
+    }
+
+    /* A whole segment, in 8 independent sums so the loop vectorises. */
+    static float getSegmentEnergy (const float* __restrict data) noexcept
+    {
+        const int numLanes = 8;
+        float sums[numLanes] = {};
+
+        for (int i = 0; i < energySegmentSize(); i += numLanes)
+            for (int lane = 0; lane < numLanes; ++lane)
+                sums[lane] += data[i + lane] * data[i + lane];
+
+        return ((sums[0] + sums[1]) + (sums[2] + sums[3])) + ((sums[4] + sums[5]) + (sums[6] + sums[7]));
+    }
+
+    static float getEnergy (const float* data, int numSamples) noexcept
+    {
+        float energy = 0.0f;
+        for (int i = 0; i < numSamples; ++i)
+            energy += data[i] * data[i];
+
+        return energy;
+    }
+
+    int getSegmentIndex (int64 segment) const noexcept { return (int) (segment & (int64) (ring.getNumSamples() / energySegmentSize() - 1)); }
+
+    AudioSampleBuffer ring;
+    HeapBlock<float>  segmentEnergies;
+    Atomic<int64>     writePosition { 0 };
+    Atomic<int>       numReaders    { 0 };
+    Atomic<int>       collectInput  { 1 };
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (AudioCaptureRing)
+};
+
+//==============================================================================
+/*
+    A snapshot of the health counters of one or more collectors. All counts are totals since the collector
+    was created, so a poller can diff successive snapshots to get rates.
+*/
+struct CaptureStats
+{
+    /* Combines the stats of several collectors (e.g. all the collectors of one track). */
+    void add (const CaptureStats& other) noexcept
+    {
+        samplesDropped    += other.samplesDropped;
+        numOverruns       += other.numOverruns;
+        numUnderruns      += other.numUnderruns;
+        readerWaitSeconds += other.readerWaitSeconds;
+        numFrames         += other.numFrames;
+        numGatedFrames    += other.numGatedFrames;
+        maxFillLevel       = jmax (maxFillLevel, other.maxFillLevel);
+        capacity           = jmax (capacity, other.capacity);
+    }
+
+    /* The highest fill level seen, as a proportion of the ring size. */
+    float getMaxFillProportion() const noexcept { return capacity > 0 ? (float) maxFillLevel / (float) capacity : 0.0f; }
+
+    /* The proportion of analysed frames that were skipped by the silence gate. */
+    float getGatedProportion()   const noexcept { return numFrames > 0 ? (float) numGatedFrames / (float) numFrames : 0.0f; }
+
+    int64  samplesDropped    { 0 };   // unread samples that were overwritten by the audio thread
+    int64  numOverruns       { 0 };   // number of times the reader was lapped
+    int64  numUnderruns      { 0 };   // number of reads that found fewer samples than they asked for
+    double readerWaitSeconds { 0.0 }; // total time the analysis thread has spent waiting for samples
+    int64  numFrames         { 0 };   // frames read by the analysers
+    int64  numGatedFrames    { 0 };   // frames the silence gate published as silence without analysing
+    int    maxFillLevel      { 0 };   // the most unread samples seen waiting for the reader
+    int    capacity          { 0 };
+};
+
+//==============================================================================
+/*
+    Periodically collects the incoming audio of one channel into a buffer that is used for audio feature
+    extraction. Each collector is a reader of a shared AudioCaptureRing, so any number of analysers can
+    collect the same channel without the audio thread copying it more than once.
+*/
+class AudioDataCollector
+{
+public:
+    AudioDataCollector (AudioCaptureRing& ringToCollect)
+    :   ring         (ringToCollect),
+        readPosition (ringToCollect.getWritePosition())
+    {}
+
+    /* Returns true when at least numSamplesRequired unread samples have been published by the audio thread. */
+    bool isAnalysisBufferReady (int numSamplesRequired) const
+    {
+        return getNumSamplesAvailable() >= numSamplesRequired;
+    }
+
+    /*
+        A read-only view of unread samples, pointing straight into the ring. Because the samples may wrap
+        around the end of the ring they are split into a head segment and a (possibly empty) tail segment
+        that starts at the beginning of the ring.
+    */
+    struct AnalysisBufferView
+    {
+        int getNumSamples() const noexcept { return numHeadSamples + numTailSamples; }
+
+        const float* head           { nullptr };
+        const float* tail           { nullptr };
+        int          numHeadSamples { 0 };
+        int          numTailSamples { 0 };
+        int64        startPosition  { 0 };
+    };
+
+    /*
+        Only call this from the analysis thread, and only once isAnalysisBufferReady() has returned true.
+        The view stays valid until finishedReading() is called with it. The view is empty if the buffer was
+        cleared since isAnalysisBufferReady() was checked.
+    */
+    AnalysisBufferView getAnalysisBufferView (int numSamplesRequired)
+    {
+        jassert (numSamplesRequired <= ring.getSize());
+        AnalysisBufferView view;
+
+        const bool wasCleared = clearRequested.compareAndSetBool (0, 1);
+
+        if (wasCleared)
+            readPosition.set (ring.getWritePosition());
+
+        int64 currentReadPosition        = readPosition.get();
+        const int64 currentWritePosition = ring.getWritePosition();
+
+        /* If the audio thread has lapped us, skip to the oldest samples that are still intact. */
+        if (currentWritePosition - currentReadPosition > (int64) ring.getSize())
         {
-            for (int index = 0; index < numberOfSamples; index++)
-            {
-                const int modIndex = (index + writeIndex) % circleBuffer.getNumSamples();
-                circleBuffer.setSample (0, modIndex, channelData[channelToCollect][index]);
-            }
+            const int64 newReadPosition = currentWritePosition - numSamplesRequired;
+            samplesDropped += newReadPosition - currentReadPosition;
+            ++numOverruns;
+            currentReadPosition = newReadPosition;
         }
-        
-        writeIndex = (writeIndex + numberOfSamples) % circleBuffer.getNumSamples();
 
-        analysisBufferUpdating.set (0);
+        view.startPosition = currentReadPosition;
 
-        if (notifyAnalysisThread != nullptr)
-            notifyAnalysisThread();
+        if (currentWritePosition - currentReadPosition < (int64) numSamplesRequired)
+        {
+            /* a read cut short by a clear isn't the analysis being starved */
+            if (! wasCleared)
+                ++numUnderruns;
+
+            return view;
+        }
+
+        const float* ringData = ring.getReadPointer();
+        const int readIndex   = ring.getRingIndex (currentReadPosition);
+        view.head             = ringData + readIndex;
+        view.numHeadSamples   = jmin (numSamplesRequired, ring.getSize() - readIndex);
+        view.tail             = ringData;
+        view.numTailSamples   = numSamplesRequired - view.numHeadSamples;
+        return view;
     }
 
-    AudioSampleBuffer getAnalysisBuffer (int numSamplesRequired)
+    /*
+        Copies the samples of a view into destination with the collector's gain applied, as one multiply-copy
+        per segment. When the gain has changed since the last hop it is ramped across this hop rather than
+        stepped, so gain changes don't put discontinuities into the analysis windows.
+    */
+    void copyViewWithGain (const AnalysisBufferView& view, float* destination)
     {
-        AudioSampleBuffer buffer = AudioSampleBuffer();
-        buffer.clear();
-        buffer.setSize (1, numSamplesRequired);
-        while (analysisBufferUpdating.get() == 1 || indexesOverlap (numSamplesRequired)) {}
-        if (analysisBufferUpdating.get() != 1)
+        const float targetGain = gain.get();
+
+        if (targetGain == currentGain)
         {
-            const bool wrap = readIndex + numSamplesRequired > circleBuffer.getNumSamples();
-            for (int index = 0; index < numSamplesRequired; index++)
-            {
-                int rIndex = index + readIndex;
-                    
-                if (wrap)
-                    rIndex = rIndex % circleBuffer.getNumSamples();
+            copySegmentWithGain (destination, view.head, view.numHeadSamples, currentGain);
+            copySegmentWithGain (destination + view.numHeadSamples, view.tail, view.numTailSamples, currentGain);
+            return;
+        }
 
-                buffer.setSample (0, index, circleBuffer.getReadPointer (0)[rIndex] * gain);
-            }
-            readIndex = (readIndex + numSamplesRequired) % circleBuffer.getNumSamples();
-            updateBufferToDraw (buffer);
+        const int numSamples = view.getNumSamples();
+        const float gainIncrement = numSamples > 0 ? (targetGain - currentGain) / (float) numSamples : 0.0f;
+        copySegmentWithGainRamp (destination, view.head, view.numHeadSamples, currentGain, gainIncrement);
+        copySegmentWithGainRamp (destination + view.numHeadSamples, view.tail, view.numTailSamples,
+                                 currentGain + gainIncrement * (float) view.numHeadSamples, gainIncrement);
+        currentGain = targetGain;
+    }
+
+    /* Releases the samples of a view returned by getAnalysisBufferView() back to the audio thread. */
+    void finishedReading (const AnalysisBufferView& view)
+    {
+        if (view.getNumSamples() <= 0)
+            return;
+
+        /* If the audio thread wrapped onto the view while it was being read, part of it was overwritten. */
+        const int64 oldestIntactPosition = ring.getWritePosition() - (int64) ring.getSize();
+
+        if (oldestIntactPosition > view.startPosition)
+        {
+            samplesDropped += jmin (oldestIntactPosition - view.startPosition, (int64) view.getNumSamples());
+            ++numOverruns;
         }
-        return buffer;
+
+        readPosition.set (view.startPosition + view.getNumSamples());
     }
-    
+
+    /* Called by the analysis thread with the time it spent blocked waiting for samples. */
+    void addReaderWaitTicks (int64 ticks) noexcept { readerWaitTicks += ticks; }
+
+    /* Called by the analysis thread for every frame it reads, and whether its silence gate skipped it. */
+    void addFrame (bool wasGated) noexcept
+    {
+        ++numFrames;
+
+        if (wasGated)
+            ++numGatedFrames;
+    }
+
+    /* 
+        The mean square of captured samples with the gain applied, from the ring's segment energies (see 
+        AudioCaptureRing::getMeanSquare()), or -1 if it isn't known yet. Analysis thread only.
+    */
+    float getMeanSquare (int64 startPosition, int numSamples) const noexcept
+    {
+        const float meanSquare = ring.getMeanSquare (startPosition, numSamples);
+        return meanSquare < 0.0f ? meanSquare : meanSquare * currentGain * currentGain;
+    }
+
+    /* Safe to call from any thread. */
+    CaptureStats getStats() const noexcept
+    {
+        CaptureStats stats;
+        stats.samplesDropped    = samplesDropped.get();
+        stats.numOverruns       = numOverruns.get();
+        stats.numUnderruns      = numUnderruns.get();
+        stats.readerWaitSeconds = Time::highResolutionTicksToSeconds (readerWaitTicks.get());
+        stats.numFrames         = numFrames.get();
+        stats.numGatedFrames    = numGatedFrames.get();
+        stats.maxFillLevel      = maxFillLevel.get();
+        stats.capacity          = ring.getSize();
+        return stats;
+    }
+
     void updateBufferToDraw (AudioSampleBuffer& buffer)
     {
         if (bufferToDrawUpdated != nullptr)
@@ -101,42 +391,202 @@ public:
         }
     }
 
-    bool indexesOverlap (int numSamplesToFill)
+    int getNumSamplesAvailable() const noexcept
     {
-        if (writeIndex < readIndex)
-            if (readIndex < writeIndex + expectedSamplesPerBlock)
-                return true;
-        if (readIndex < writeIndex)
-            if (writeIndex < readIndex + numSamplesToFill)
-                return true;
-        return false;
-            
+        return (int) jmin (ring.getWritePosition() - readPosition.get(), (int64) ring.getSize());
+    }
+
+    /* Called on the audio thread after the ring has been written. */
+    void notifyIfReady()
+    {
+        const int numSamplesAvailable = getNumSamplesAvailable();
+
+        /* The audio thread is the only writer of maxFillLevel. */
+        if (numSamplesAvailable > maxFillLevel.get())
+            maxFillLevel.set (numSamplesAvailable);
+
+        if (notifyAnalysisThread != nullptr && numSamplesAvailable >= samplesRequiredByReader.get())
+            notifyAnalysisThread();
     }
 
     void setBufferToDrawUpdatedCallback  (std::function<void (AudioSampleBuffer&)> f) { bufferToDrawUpdated = f; }
     void setNotifyAnalysisThreadCallback (std::function<void()> f)                    { notifyAnalysisThread = f; }
 
-    void toggleCollectInput         (bool shouldCollectInput) noexcept { clearBuffer(); collectInput = shouldCollectInput; }
-    void setExpectedSamplesPerBlock (int spb)                 noexcept { expectedSamplesPerBlock = spb; }
+    /* The analysis thread is only woken once this many samples are waiting to be read. */
+    void setSamplesRequiredByReader (int numSamples)                 noexcept { samplesRequiredByReader.set (numSamples); }
+
+    void toggleCollectInput         (bool shouldCollectInput) noexcept { clearBuffer(); ring.setCollectInput (shouldCollectInput); }
+
+    /* Safe to call from any thread: the reader discards everything published so far on its next read. */
+    void clearBuffer() { clearRequested.set (1); }
+    void setGain (float g) { gain.set (g); }
+    float getGain() const noexcept { return gain.get(); }
 
-    void clearBuffer() { circleBuffer.clear(); }
-    void setChannelToCollect (int c) { channelToCollect = c; }
-    void setGain (float g) { gain = g; }
+    AudioCaptureRing& getRing() noexcept { return ring; }
 private:
-    AudioSampleBuffer                        circleBuffer;
+    static void copySegmentWithGain (float* destination, const float* source, int numSamples, float g) noexcept
+    {
+        if (numSamples <= 0)
+            return;
+
+        if (g == 1.0f)
+            FloatVectorOperations::copy (destination, source, numSamples);
+        else
+            FloatVectorOperations::copyWithMultiply (destination, source, g, numSamples);
+    }
+
+    static void copySegmentWithGainRamp (float* destination, const float* source, int numSamples, float startGain, float gainIncrement) noexcept
+    {
+        for (int i = 0; i < numSamples; ++i)
+            destination[i] = source[i] * (startGain + gainIncrement * (float) i);
+    }
+
+    AudioCaptureRing&                        ring;
+    Atomic<int64>                            readPosition;
     std::function<void (AudioSampleBuffer&)> bufferToDrawUpdated;
     std::function<void()>                    notifyAnalysisThread;
-    float gain                               { 1.0f };
-    Atomic<int> analysisBufferUpdating       { 0 };
-    int writeIndex                           { 0 };
-    int readIndex                            { 0 };
-    int expectedSamplesPerBlock              { 512 };
-    int channelToCollect                     { 0 };
-    bool collectInput                        { true };
+    Atomic<float> gain                       { 1.0f };
+    float currentGain                        { 1.0f };
+    Atomic<int>   samplesRequiredByReader    { 1 };
+    Atomic<int>   clearRequested             { 0 };
+    Atomic<int64> samplesDropped             { 0 };
+    Atomic<int64> numOverruns                { 0 };
+    Atomic<int64> numUnderruns               { 0 };
+    Atomic<int64> readerWaitTicks            { 0 };
+    Atomic<int64> numFrames                  { 0 };
+    Atomic<int64> numGatedFrames             { 0 };
+    Atomic<int>   maxFillLevel               { 0 };
 
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (AudioDataCollector)
 };
 
+//==============================================================================
+/*
+    The single device-level capture callback. Every audio block, each active channel is copied once into
+    its own AudioCaptureRing, and then every registered AudioDataCollector is given the chance to wake
+    its analysis thread. A ring whose track is playing a file is written by that track's AudioFilePlayer 
+    instead (see writePlayback()). The rings are allocated up front so the audio thread never allocates and the
+    message thread can hand out rings while the device is running.
+*/
+class MultiChannelAudioCapture : public AudioIODeviceCallback
+{
+public:
+    /* 
+        The default ring holds two of the longest analysis windows at 192kHz (windows are set in ms, so they 
+        grow with the sample rate), so even the longest hop has room to spare. 
+    */
+    MultiChannelAudioCapture (int maxNumChannels, int ringSize = 65536)
+    :   disconnectedRing (ringSize)
+    {
+        for (int channel = 0; channel < maxNumChannels; ++channel)
+            rings.add (new AudioCaptureRing (ringSize));
+
+        readers.ensureStorageAllocated (maxNumChannels * 4);
+    }
+
+    void audioDeviceAboutToStart (AudioIODevice*) override
+    { }
+
+    void audioDeviceStopped() override
+    { }
+
+    void audioDeviceIOCallback (const float** inputChannelData, int numInputChannels,
+                                float** outputChannelData, int numOutputChannels,
+                                int numberOfSamples) override
+    {
+        ignoreUnused (outputChannelData, numOutputChannels);
+
+        for (int channel = 0; channel < rings.size(); ++channel)
+        {
+            AudioCaptureRing& ring = *rings.getUnchecked (channel);
+
+            //a ring playing a file is written by its track's player (see writePlayback())
+            if (! ring.isCollectingInput())
+                continue;
+
+            if (! ring.hasReaders())
+            {
+                ring.advance (numberOfSamples);
+                continue;
+            }
+
+            //every ring moves on every block, so its positions stay on the device clock even if the channel isn't delivered
+            if (channel < numInputChannels && inputChannelData[channel] != nullptr)
+                ring.write (inputChannelData[channel], numberOfSamples);
+            else
+                ring.writeSilence (numberOfSamples);
+        }
+
+        const SpinLock::ScopedTryLockType readersLock (readersMutex);
+
+        if (readersLock.isLocked())
+            for (auto reader : readers)
+                reader->notifyIfReady();
+
+        samplesCaptured.set (samplesCaptured.get() + numberOfSamples);
+    }
+
+    /*
+        Audio thread only, called by a track's AudioFilePlayer with each block it has rendered for the track's channel. 
+        While the ring is playing a file this replaces the device input, so the track analyses its own player's output. 
+        A null block (no such output channel) is written as silence.
+    */
+    void writePlayback (AudioCaptureRing& ring, const float* data, int numberOfSamples)
+    {
+        if (ring.isCollectingInput() || &ring == &disconnectedRing)
+            return;
+
+        if (data != nullptr)
+            ring.write (data, numberOfSamples);
+        else
+            ring.writeSilence (numberOfSamples);
+
+        const SpinLock::ScopedTryLockType readersLock (readersMutex);
+
+        if (readersLock.isLocked())
+            for (auto reader : readers)
+                if (&reader->getRing() == &ring)
+                    reader->notifyIfReady();
+    }
+
+    /* The number of samples the device has delivered since the capture was created. */
+    int64 getSamplePosition() const noexcept { return samplesCaptured.get(); }
+
+    /* Returns the ring for a device input channel. Invalid channels get a ring that is never written. */
+    AudioCaptureRing& getRing (int channel)
+    {
+        if (isPositiveAndBelow (channel, rings.size()))
+            return *rings.getUnchecked (channel);
+
+        return disconnectedRing;
+    }
+
+    void addReader (AudioDataCollector* reader)
+    {
+        reader->getRing().addReader();
+        const SpinLock::ScopedLockType readersLock (readersMutex);
+        readers.addIfNotAlreadyThere (reader);
+    }
+
+    void removeReader (AudioDataCollector* reader)
+    {
+        {
+            const SpinLock::ScopedLockType readersLock (readersMutex);
+            readers.removeFirstMatchingValue (reader);
+        }
+        reader->getRing().removeReader();
+    }
+
+private:
+    OwnedArray<AudioCaptureRing> rings;
+    AudioCaptureRing             disconnectedRing;
+    Array<AudioDataCollector*>   readers;
+    SpinLock                     readersMutex;
+    Atomic<int64>                samplesCaptured { 0 };
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (MultiChannelAudioCapture)
+};
+
 
 
 #endif  // AUDIODATACOLLECTOR_H_INCLUDED
@@ -11,7 +11,13 @@
 #ifndef AUDIOFILEPLAYER_H_INCLUDED
 #define AUDIOFILEPLAYER_H_INCLUDED
 
-class AudioFilePlayer
+/*
+    Plays a file out of the device, for a track that analyses a file instead of its input. The player is its own 
+    device callback, so after rendering each block it hands the output channel its track analyses to the 
+    playback tap: any other callback would only see the device's shared output buffer, which holds whatever the 
+    last player rendered.
+*/
+class AudioFilePlayer : private AudioIODeviceCallback
 {
 public:
     AudioFilePlayer ()
@@ -27,15 +33,21 @@ public:
         audioSourcePlayer.setSource (nullptr);
     }
 
-    void setupAudioCallback (AudioDeviceManager& deviceManager)
+    /* 
+        The tap is called on the audio thread with each rendered block of outputChannel, or with nullptr if the 
+        device has no such channel.
+    */
+    void setupAudioCallback (AudioDeviceManager& deviceManager, int outputChannel, std::function<void (const float*, int)> playbackTap)
     {
-        deviceManager.addAudioCallback (&audioSourcePlayer);
+        tappedChannel = outputChannel;
+        tap           = playbackTap;
         audioSourcePlayer.setSource    (&audioTransportSource);
+        deviceManager.addAudioCallback (this);
     }
 
-    AudioSourcePlayer* getAudioSourcePlayer()
+    void removeAudioCallback (AudioDeviceManager& deviceManager)
     {
-        return &audioSourcePlayer;
+        deviceManager.removeAudioCallback (this);
     }
 
     void loadFileIntoTransport (const File& audioFile)
@@ -67,11 +79,26 @@ public:
     bool hasFile() { return currentAudioFileSource != nullptr; }
 
 private:
+    void audioDeviceIOCallback (const float** inputChannelData, int numInputChannels,
+                                float** outputChannelData, int numOutputChannels,
+                                int numberOfSamples) override
+    {
+        audioSourcePlayer.audioDeviceIOCallback (inputChannelData, numInputChannels, outputChannelData, numOutputChannels, numberOfSamples);
+
+        if (tap != nullptr)
+            tap (isPositiveAndBelow (tappedChannel, numOutputChannels) ? outputChannelData[tappedChannel] : nullptr, numberOfSamples);
+    }
+
+    void audioDeviceAboutToStart (AudioIODevice* device) override { audioSourcePlayer.audioDeviceAboutToStart (device); }
+    void audioDeviceStopped() override                            { audioSourcePlayer.audioDeviceStopped(); }
+
     AudioFormatManager                     formatManager;
     TimeSliceThread                        thread;
     AudioSourcePlayer                      audioSourcePlayer;
     AudioTransportSource                   audioTransportSource;
     ScopedPointer<AudioFormatReaderSource> currentAudioFileSource;
+    std::function<void (const float*, int)> tap;
+    int                                    tappedChannel { -1 };
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (AudioFilePlayer)
 };
 
@@ -0,0 +1,114 @@
+/*
+  ==============================================================================
+
+    ChromaAnalyser.h
+    Created: 16 Nov 2016 3:47:12pm
+    Author:  Sean
+
+  ==============================================================================
+*/
+
+#ifndef CHROMAANALYSER_H_INCLUDED
+#define CHROMAANALYSER_H_INCLUDED
+
+/*
+    A chromagram folded straight out of the power spectrum. Every FFT bin in the analysed range is mapped
+    once, up front, to the two chroma bins either side of its pitch class, with weights that split its energy
+    between them. The table is a flat list of (FFT bin, chroma bin, weight) entries, so each frame is one
+    pass over it. Chroma bin 0 is centred on A (440 Hz, shifted by the tuning offset).
+*/
+class ChromaAnalyser
+{
+public:
+    enum { defaultBinsPerOctave = 12, maxBinsPerOctave = 36 };
+
+    ChromaAnalyser (int numSamplesPerWindow, double sampleRate = 48000.0)
+    {
+        prepare (numSamplesPerWindow, sampleRate);
+    }
+
+    /* Rebuilds the mapping. Allocates, so only call this while the analysis thread is stopped. */
+    void prepare (int numSamplesPerWindow, double newSampleRate)
+    {
+        windowSize = numSamplesPerWindow;
+        sampleRate = newSampleRate;
+        chroma.setSize (binsPerOctave);
+        entries.clear();
+
+        const int    numMagnitudes = numSamplesPerWindow / 2;
+        const double binWidth      = (sampleRate / 2.0) / (double) numMagnitudes;
+        const double referenceFrequency = 440.0 * pow (2.0, tuningOffsetCents / 1200.0);
+        const int    firstBin      = jmax (1, (int) ceil (minFrequency() / binWidth));
+        const int    lastBin       = jmin (numMagnitudes - 1, (int) floor (maxFrequency() / binWidth));
+
+        for (int bin = firstBin; bin <= lastBin; ++bin)
+        {
+            /* position in chroma bins above the reference, wrapped into [0, binsPerOctave) */
+            const double position = (double) binsPerOctave * log2 ((double) bin * binWidth / referenceFrequency);
+            double wrapped = fmod (position, (double) binsPerOctave);
+            if (wrapped < 0.0)
+                wrapped += (double) binsPerOctave;
+
+            const int    lower      = (int) wrapped % binsPerOctave;
+            const int    upper      = (lower + 1) % binsPerOctave;
+            const double upperShare = wrapped - floor (wrapped);
+
+            entries.push_back ({ bin, lower, (float) (1.0 - upperShare) });
+            entries.push_back ({ bin, upper, (float) upperShare });
+        }
+    }
+
+    /* binsPerOctave is 12 or 36, the tuning offset is in cents from A440. The analysis thread must be stopped. */
+    void setResolutionAndTuning (int newBinsPerOctave, double newTuningOffsetCents)
+    {
+        jassert (newBinsPerOctave > 0 && newBinsPerOctave <= maxBinsPerOctave);
+        binsPerOctave     = newBinsPerOctave;
+        tuningOffsetCents = newTuningOffsetCents;
+        prepare (windowSize, sampleRate);
+    }
+
+    /* Returns getNumBins() values normalised so the strongest is 1 (or all 0 for silence), valid until the next call. */
+    const float* calculateChroma (const float* powerSpectrum, int numMagnitudes)
+    {
+        jassert (numMagnitudes == windowSize / 2);
+        ignoreUnused (numMagnitudes);
+
+        float* c = chroma.getData();
+        chroma.clear();
+
+        for (auto& entry : entries)
+            c[entry.chromaBin] += entry.weight * powerSpectrum[entry.fftBin];
+
+        const float maxEnergy = FloatVectorOperations::findMaximum (c, binsPerOctave);
+        FloatVectorOperations::multiply (c, maxEnergy > silenceThreshold() ? 1.0f / maxEnergy : 0.0f, binsPerOctave);
+        return c;
+    }
+
+    int    getNumBins()           const { return binsPerOctave; }
+    double getTuningOffsetCents() const { return tuningOffsetCents; }
+    int    getNumEntries()        const { return (int) entries.size(); }
+
+private:
+    struct Entry
+    {
+        int   fftBin;
+        int   chromaBin;
+        float weight;
+    };
+
+    /* below about A1 the FFT bins are wider than a semitone, above about C8 there is little tonal content */
+    static double minFrequency()     { return 55.0; }
+    static double maxFrequency()     { return 4200.0; }
+    static float  silenceThreshold() { return 1.0e-8f; }
+
+    int                binsPerOctave     { defaultBinsPerOctave };
+    double             tuningOffsetCents { 0.0 };
+    int                windowSize        { 0 };
+    double             sampleRate        { 48000.0 };
+    std::vector<Entry> entries;
+    AlignedFloatBuffer chroma;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (ChromaAnalyser)
+};
+
+#endif  // CHROMAANALYSER_H_INCLUDED
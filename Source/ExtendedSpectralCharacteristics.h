@@ -0,0 +1,208 @@
+/*
+  ==============================================================================
+
+    ExtendedSpectralCharacteristics.h
+    Created: 9 Nov 2016 4:21:08pm
+    Author:  Sean
+
+  ==============================================================================
+*/
+
+#ifndef EXTENDEDSPECTRALCHARACTERISTICS_H_INCLUDED
+#define EXTENDEDSPECTRALCHARACTERISTICS_H_INCLUDED
+
+/* Timbre descriptors beyond the basic spectral set. Every value is normalised to [0, 1]. */
+struct ExtendedSpectralCharacteristics
+{
+    enum { numContrastBands = 7 };
+
+    ExtendedSpectralCharacteristics()
+    {
+        for (int band = 0; band < numContrastBands; ++band)
+            contrastBands[band] = 0.0f;
+    }
+
+    float rolloff85 { 0.0f };  // frequency below which 85% of the energy lies, over nyquist
+    float rolloff95 { 0.0f };  // frequency below which 95% of the energy lies, over nyquist
+    float crest     { 0.0f };  // log of the peak to mean ratio, over its largest possible value
+    float skewness  { 0.0f };  // squashed from (-inf, inf), 0.5 is symmetrical about the centroid
+    float kurtosis  { 0.0f };  // 1 - 1 / kurtosis, so larger values are more peaked
+    float decrease  { 0.0f };  // mapped from [-1, 1]
+    float contrast  { 0.0f };  // the mean of contrastBands
+    float entropy   { 0.0f };  // Shannon entropy of the spectrum, over that of a flat spectrum
+    float contrastBands[numContrastBands];  // peak to valley ratio per octave band, in decades of power over 6
+};
+
+//==============================================================================
+//==============================================================================
+
+/*
+    Calculates the extended descriptors from the partial sums the SpectralCharacteristicsAnalyser has already
+    accumulated for the frame (which must have been asked for them). The higher moments, crest, decrease and
+    entropy only need those sums. Rolloff needs one prefix-sum scan, and contrast a partial sort of each
+    octave band.
+*/
+class ExtendedSpectralCharacteristicsAnalyser
+{
+public:
+    typedef SpectralCharacteristicsAnalyser::PartialSums PartialSums;
+
+    ExtendedSpectralCharacteristicsAnalyser (int numSamplesPerWindow, double sampleRate = 48000.0)
+    {
+        prepare (numSamplesPerWindow, sampleRate);
+    }
+
+    /* Allocates, so only call this while the analysis thread is stopped. */
+    void prepare (int numSamplesPerWindow, double sampleRate)
+    {
+        const int numMagnitudes = numSamplesPerWindow / 2;
+        cumulativeSpectrum.setSize (numMagnitudes);
+        bandScratch.setSize (numMagnitudes);
+
+        /* harmonic number H(n - 1), for the decrease */
+        harmonicNumber = 0.0;
+        for (int k = 1; k < numMagnitudes; ++k)
+            harmonicNumber += 1.0 / (double) k;
+
+        /* octave bands from 200 Hz, the first band takes everything below 200 Hz and the last everything up to nyquist */
+        const double binWidth = (sampleRate / 2.0) / (double) jmax (1, numMagnitudes);
+        contrastBandEdges[0] = 0;
+        for (int band = 1; band < numContrastBands; ++band)
+        {
+            const double edgeFrequency = lowestContrastBandEdge() * pow (2.0, (double) (band - 1));
+            contrastBandEdges[band] = jlimit (0, numMagnitudes, (int) ceil (edgeFrequency / binWidth));
+        }
+        contrastBandEdges[numContrastBands] = numMagnitudes;
+    }
+
+    /* powerSpectrum and sums must be the same frame that was passed to SpectralCharacteristicsAnalyser. */
+    ExtendedSpectralCharacteristics calculateExtendedSpectralCharacteristics (const float* powerSpectrum, int numMagnitudes, const PartialSums& sums)
+    {
+        ExtendedSpectralCharacteristics result;
+        const double magnitudeSum = PartialSums::total (sums.sum);
+
+        double epsSum = 0.05;
+        if (!(magnitudeSum > epsSum) || numMagnitudes < 2)
+            return result;
+
+        const double n = (double) numMagnitudes;
+
+        /* higher moments about the centroid, recovered from the moments about bin 0 */
+        const double m1 = PartialSums::total (sums.weightedSum)    / magnitudeSum;
+        const double m2 = PartialSums::total (sums.squaredSum)     / magnitudeSum;
+        const double m3 = PartialSums::total (sums.cubedSum)       / magnitudeSum;
+        const double m4 = PartialSums::total (sums.fourthPowerSum) / magnitudeSum;
+        const double variance = m2 - m1 * m1;
+
+        if (variance > 0.0)
+        {
+            const double thirdCentralMoment  = m3 - 3.0 * m1 * m2 + 2.0 * m1 * m1 * m1;
+            const double fourthCentralMoment = m4 - 4.0 * m1 * m3 + 6.0 * m1 * m1 * m2 - 3.0 * m1 * m1 * m1 * m1;
+            const double skewness = thirdCentralMoment / (variance * sqrt (variance));
+            const double kurtosis = fourthCentralMoment / (variance * variance);
+            result.skewness = (float) (0.5 + 0.5 * skewness / (1.0 + std::abs (skewness)));
+            result.kurtosis = kurtosis > 1.0 ? (float) (1.0 - 1.0 / kurtosis) : 0.0f;
+        }
+
+        /* crest lies in [1, n] */
+        const double crest = PartialSums::largest (sums.maximum) / (magnitudeSum / n);
+        result.crest = (float) jlimit (0.0, 1.0, log (jmax (1.0, crest)) / log (n));
+
+        /* decrease: the mean slope from bin 0 to each other bin, weighted towards the low bins */
+        const double firstBin = (double) powerSpectrum[0];
+        if (magnitudeSum - firstBin > 0.0)
+        {
+            const double decrease = (PartialSums::total (sums.inverseWeightedSum) - firstBin * harmonicNumber) / (magnitudeSum - firstBin);
+            result.decrease = (float) ((jlimit (-1.0, 1.0, decrease) + 1.0) * 0.5);
+        }
+
+        /* entropy of the spectrum as a distribution, over the bins the flatness threshold kept */
+        const double flatnessSum = PartialSums::total (sums.flatnessSum);
+        if (flatnessSum > 0.0)
+        {
+            const double entropy = log (flatnessSum) - PartialSums::total (sums.entropySum) / flatnessSum;
+            result.entropy = (float) jlimit (0.0, 1.0, entropy / log (n));
+        }
+
+        calculateRolloff (powerSpectrum, numMagnitudes, result);
+        calculateContrast (powerSpectrum, numMagnitudes, result);
+        return result;
+    }
+
+private:
+    enum { numContrastBands = ExtendedSpectralCharacteristics::numContrastBands };
+
+    static double lowestContrastBandEdge()       { return 200.0; }
+    static double contrastQuantile()             { return 0.2; }   // the share of a band's bins averaged for its peak and its valley
+    static double maxContrastDecades()           { return 6.0; }   // a 60 dB power ratio reads as full contrast
+
+    void calculateRolloff (const float* powerSpectrum, int numMagnitudes, ExtendedSpectralCharacteristics& result)
+    {
+        float* cumulative = cumulativeSpectrum.getData();
+        double runningSum = 0.0;
+
+        for (int bin = 0; bin < numMagnitudes; ++bin)
+        {
+            runningSum     += (double) powerSpectrum[bin];
+            cumulative[bin] = (float) runningSum;
+        }
+
+        result.rolloff85 = getRolloff (cumulative, numMagnitudes, 0.85f);
+        result.rolloff95 = getRolloff (cumulative, numMagnitudes, 0.95f);
+    }
+
+    static float getRolloff (const float* cumulative, int numMagnitudes, float proportion)
+    {
+        const float target = cumulative[numMagnitudes - 1] * proportion;
+        const int rolloffBin = (int) (std::lower_bound (cumulative, cumulative + numMagnitudes, target) - cumulative);
+        return (float) rolloffBin / (float) numMagnitudes;
+    }
+
+    void calculateContrast (const float* powerSpectrum, int numMagnitudes, ExtendedSpectralCharacteristics& result)
+    {
+        const float powerFloor = 1.0e-10f;
+        float* scratch    = bandScratch.getData();
+        double contrastSum = 0.0;
+
+        for (int band = 0; band < numContrastBands; ++band)
+        {
+            const int startBin = contrastBandEdges[band];
+            const int numBins  = jmin (contrastBandEdges[band + 1], numMagnitudes) - startBin;
+
+            if (numBins <= 0)
+                continue;
+
+            FloatVectorOperations::copy (scratch, powerSpectrum + startBin, numBins);
+            const int numExtremeBins = jmax (1, roundToInt (contrastQuantile() * numBins));
+
+            std::nth_element (scratch, scratch + numExtremeBins - 1, scratch + numBins);
+            const double valley = getMean (scratch, numExtremeBins);
+
+            std::nth_element (scratch, scratch + numBins - numExtremeBins, scratch + numBins);
+            const double peak = getMean (scratch + numBins - numExtremeBins, numExtremeBins);
+
+            const double contrast = log10 ((peak + powerFloor) / (valley + powerFloor)) / maxContrastDecades();
+            result.contrastBands[band] = (float) jlimit (0.0, 1.0, contrast);
+            contrastSum += result.contrastBands[band];
+        }
+
+        result.contrast = (float) (contrastSum / (double) numContrastBands);
+    }
+
+    static double getMean (const float* data, int numValues)
+    {
+        double sum = 0.0;
+        for (int i = 0; i < numValues; ++i)
+            sum += (double) data[i];
+        return sum / (double) numValues;
+    }
+
+    AlignedFloatBuffer cumulativeSpectrum;
+    AlignedFloatBuffer bandScratch;
+    double             harmonicNumber { 0.0 };
+    int                contrastBandEdges[numContrastBands + 1];
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (ExtendedSpectralCharacteristicsAnalyser)
+};
+
+#endif  // EXTENDEDSPECTRALCHARACTERISTICS_H_INCLUDED
@@ -0,0 +1,876 @@
+/*
+  ==============================================================================
+
+    FFTBackend.h
+    Created: 2 Nov 2016 6:12:40pm
+    Author:  Sean
+
+  ==============================================================================
+*/
+
+#ifndef FFTBACKEND_H_INCLUDED
+#define FFTBACKEND_H_INCLUDED
+
+/* Define this as 1 (and link against fftw3f) to make FFTW available as a backend. */
+#ifndef FEATURE_EXTRACTOR_USE_FFTW
+ #define FEATURE_EXTRACTOR_USE_FFTW 0
+#endif
+
+#if FEATURE_EXTRACTOR_USE_FFTW
+ #include <fftw3.h>
+#endif
+
+//==============================================================================
+/*
+    Keeps one plan per transform size for a backend, so every analyser using a size shares the same
+    tables. Plans are immutable once built and live until the app quits. They are only created while
+    analysis threads are stopped, but the lock keeps the cache safe regardless.
+*/
+template <typename PlanType>
+struct FFTPlanCache
+{
+    static const PlanType& getPlan (int size)
+    {
+        static CriticalSection      lock;
+        static OwnedArray<PlanType> plans;
+
+        const ScopedLock sl (lock);
+
+        for (int i = 0; i < plans.size(); ++i)
+            if (plans.getUnchecked (i)->size == size)
+                return *plans.getUnchecked (i);
+
+        return *plans.add (new PlanType (size));
+    }
+};
+
+//==============================================================================
+/*
+    A real-only FFT of one size. Every backend uses the layout of juce::FFT's real-only transforms, so the
+    feature code doesn't depend on which backend is in use:
+
+    performRealForward() takes size samples at the start of a buffer of size * 2 floats, and replaces
+    them with all size complex bins, interleaved (re, im).
+
+    performRealInverse() reads the interleaved bins 0 to size / 2 of such a buffer (the rest are implied
+    by symmetry) and replaces the buffer with size real samples scaled by 1 / size, followed by size zeros.
+
+    Instances keep their own scratch space, so a backend must only be used by one thread at a time.
+*/
+class FFTBackend
+{
+public:
+    enum eType
+    {
+        enJuce = 0,
+        enBundled,
+        enFFTW,
+        numTypes
+    };
+
+    FFTBackend (int fftSize) : size (fftSize) {}
+    virtual ~FFTBackend() {}
+
+    virtual void performRealForward (float* data) = 0;
+    virtual void performRealInverse (float* data) = 0;
+
+    int getSize() const noexcept { return size; }
+
+    static String getName (eType t)
+    {
+        switch (t)
+        {
+            case enJuce:    return "juce";
+            case enBundled: return "bundled";
+            case enFFTW:    return "fftw";
+            default:        jassertfalse; return "UNKNOWN";
+        }
+    }
+
+    /* Returns numTypes if the name doesn't match a backend. */
+    static eType getTypeForName (const String& name)
+    {
+        for (int t = 0; t < numTypes; ++t)
+            if (name.equalsIgnoreCase (getName ((eType) t)))
+                return (eType) t;
+
+        return numTypes;
+    }
+
+    static bool isAvailable (eType t)
+    {
+        if (t == enFFTW)
+            return FEATURE_EXTRACTOR_USE_FFTW != 0;
+
+        return t >= enJuce && t < numTypes;
+    }
+
+    /* 
+        True for sizes the bundled backend can transform: even sizes whose half has no prime factors other than 
+        2, 3 and 5. Window lengths in milliseconds rarely land on a power of two, but almost always land near one of these.
+    */
+    static bool isEfficientSize (int size)
+    {
+        if (size < 2 || size % 2 != 0)
+            return false;
+
+        int remaining = size / 2;
+
+        for (int factor : { 2, 3, 5 })
+            while (remaining % factor == 0)
+                remaining /= factor;
+
+        return remaining == 1;
+    }
+
+    /* The smallest efficient size that holds at least minSize samples and is a multiple of sizeMultiple. */
+    static int getEfficientSize (int minSize, int sizeMultiple = 2)
+    {
+        jassert (sizeMultiple > 0);
+        int size = jmax (sizeMultiple, ((minSize + sizeMultiple - 1) / sizeMultiple) * sizeMultiple);
+
+        while (! isEfficientSize (size))
+            size += sizeMultiple;
+
+        return size;
+    }
+
+    static bool supportsSize (eType t, int size)
+    {
+        if (t == enJuce)
+            return isPowerOfTwo (size);
+
+        if (t == enBundled)
+            return isEfficientSize (size);
+
+        return size > 0;
+    }
+
+    /* 
+        Creates a backend of the given type, or of the default type if that one isn't available. If the chosen 
+        backend can't transform the size, the bundled one is used.
+    */
+    static FFTBackend* create (eType t, int size);
+
+    /* The backend that analysers create. Set this at startup, before any analysers exist. */
+    static void  setDefaultType (eType t) { jassert (isAvailable (t)); getDefaultTypeStore().set ((int) t); }
+    static eType getDefaultType()         { return (eType) getDefaultTypeStore().get(); }
+
+    /* Times a forward and inverse transform of the given size with each available backend and returns the fastest. */
+    static eType findFastestType (int size, int numIterations = 200);
+
+private:
+    static Atomic<int>& getDefaultTypeStore()
+    {
+        static Atomic<int> defaultType ((int) enBundled);
+        return defaultType;
+    }
+
+    const int size;
+
+    JUCE_DECLARE_NON_COPYABLE (FFTBackend)
+};
+
+//==============================================================================
+/* The transforms from juce::FFT. Power of two sizes only. */
+class JuceFFTBackend : public FFTBackend
+{
+public:
+    struct Plan
+    {
+        Plan (int fftSize)
+        :   size    (fftSize),
+            forward (getOrder (fftSize), false),
+            inverse (getOrder (fftSize), true)
+        {}
+
+        static int getOrder (int fftSize) { return int (log (fftSize) / log (2) + 1e-6); }
+
+        const int size;
+        const FFT forward;
+        const FFT inverse;
+    };
+
+    JuceFFTBackend (int fftSize)
+    :   FFTBackend (fftSize),
+        plan       (FFTPlanCache<Plan>::getPlan (fftSize))
+    {
+        jassert (isPowerOfTwo (fftSize));
+    }
+
+    void performRealForward (float* data) override
+    {
+        plan.forward.performRealOnlyForwardTransform (data);
+    }
+
+    void performRealInverse (float* data) override
+    {
+        plan.inverse.performRealOnlyInverseTransform (data);
+        FloatVectorOperations::clear (data + getSize(), getSize());
+    }
+
+private:
+    const Plan& plan;
+};
+
+//==============================================================================
+/*
+    A real FFT computed as a complex FFT of half the size: even samples go in the real parts and odd samples
+    in the imaginary parts, and a final pass splits the two spectra apart. The complex transform is a mixed
+    radix (4, 2, 3 and 5) Stockham FFT, which writes each stage's output in natural order into a second
+    buffer, so no reordering pass is needed. Data is kept in separate real and imaginary arrays and each
+    stage's twiddles are stored contiguously, so the compiler can vectorise the butterflies. Supports any
+    size that FFTBackend::isEfficientSize() accepts.
+*/
+class BundledFFTBackend : public FFTBackend
+{
+public:
+    struct Plan
+    {
+        Plan (int fftSize)
+        :   size     (fftSize),
+            halfSize (fftSize / 2)
+        {
+            jassert (isEfficientSize (size));
+
+            int remaining = halfSize;
+
+            while (remaining % 4 == 0) { radices.add (4); remaining /= 4; }
+            while (remaining % 2 == 0) { radices.add (2); remaining /= 2; }
+            while (remaining % 3 == 0) { radices.add (3); remaining /= 3; }
+            while (remaining % 5 == 0) { radices.add (5); remaining /= 5; }
+
+            /* A stage of radix r over length n stores (n / r) * (r - 1) twiddles: exp (-2 pi i p k / n) for p < n / r, 0 < k < r. */
+            int numTwiddles = 0;
+            int length      = halfSize;
+
+            for (auto radix : radices)
+            {
+                stageTwiddleOffsets.add (numTwiddles);
+                numTwiddles += (length / radix) * (radix - 1);
+                length /= radix;
+            }
+
+            stageTwiddlesRe.malloc ((size_t) jmax (1, numTwiddles));
+            stageTwiddlesIm.malloc ((size_t) jmax (1, numTwiddles));
+            length = halfSize;
+
+            for (int stage = 0; stage < radices.size(); ++stage)
+            {
+                const int radix = radices.getUnchecked (stage);
+                float* const twiddleRe = stageTwiddlesRe + stageTwiddleOffsets.getUnchecked (stage);
+                float* const twiddleIm = stageTwiddlesIm + stageTwiddleOffsets.getUnchecked (stage);
+
+                for (int p = 0; p < length / radix; ++p)
+                {
+                    for (int k = 1; k < radix; ++k)
+                    {
+                        const double phase = -2.0 * double_Pi * p * k / length;
+                        twiddleRe[p * (radix - 1) + k - 1] = (float) std::cos (phase);
+                        twiddleIm[p * (radix - 1) + k - 1] = (float) std::sin (phase);
+                    }
+                }
+
+                length /= radix;
+            }
+
+            /* exp (-2 pi i k / size), used to split the even and odd spectra. */
+            splitTwiddlesRe.malloc ((size_t) halfSize);
+            splitTwiddlesIm.malloc ((size_t) halfSize);
+
+            for (int k = 0; k < halfSize; ++k)
+            {
+                const double phase = -2.0 * double_Pi * k / size;
+                splitTwiddlesRe[k] = (float) std::cos (phase);
+                splitTwiddlesIm[k] = (float) std::sin (phase);
+            }
+        }
+
+        const int        size;
+        const int        halfSize;
+        Array<int>       radices;
+        Array<int>       stageTwiddleOffsets;
+        HeapBlock<float> stageTwiddlesRe;
+        HeapBlock<float> stageTwiddlesIm;
+        HeapBlock<float> splitTwiddlesRe;
+        HeapBlock<float> splitTwiddlesIm;
+    };
+
+    BundledFFTBackend (int fftSize)
+    :   FFTBackend (fftSize),
+        plan       (FFTPlanCache<Plan>::getPlan (fftSize))
+    {
+        re.malloc     ((size_t) plan.halfSize);
+        im.malloc     ((size_t) plan.halfSize);
+        workRe.malloc ((size_t) plan.halfSize);
+        workIm.malloc ((size_t) plan.halfSize);
+    }
+
+    void performRealForward (float* data) override
+    {
+        const int n = plan.size;
+        const int m = plan.halfSize;
+
+        /* Pack even samples into the real parts and odd ones into the imaginary parts. */
+        for (int i = 0; i < m; ++i)
+        {
+            re[i] = data[2 * i];
+            im[i] = data[2 * i + 1];
+        }
+
+        const float* zr;
+        const float* zi;
+        performComplexTransform (plan, re, im, workRe, workIm, 1, zr, zi);
+
+        data[0]     = zr[0] + zi[0];
+        data[1]     = 0.0f;
+        data[n]     = zr[0] - zi[0];
+        data[n + 1] = 0.0f;
+
+        for (int k = 1; k < m; ++k)
+        {
+            /* The even spectrum is (Z[k] + conj (Z[m - k])) / 2 and the odd one is (Z[k] - conj (Z[m - k])) / 2i. */
+            const float evenRe = 0.5f * (zr[k] + zr[m - k]);
+            const float evenIm = 0.5f * (zi[k] - zi[m - k]);
+            const float oddRe  = 0.5f * (zi[k] + zi[m - k]);
+            const float oddIm  = 0.5f * (zr[m - k] - zr[k]);
+
+            const float wr = plan.splitTwiddlesRe[k];
+            const float wi = plan.splitTwiddlesIm[k];
+            const float binRe = evenRe + wr * oddRe - wi * oddIm;
+            const float binIm = evenIm + wr * oddIm + wi * oddRe;
+
+            data[2 * k]           = binRe;
+            data[2 * k + 1]       = binIm;
+            data[2 * (n - k)]     = binRe;
+            data[2 * (n - k) + 1] = -binIm;
+        }
+    }
+
+    void performRealInverse (float* data) override
+    {
+        const int n = plan.size;
+        const int m = plan.halfSize;
+
+        /*
+            Rebuild the half size spectrum Z[k] = E[k] + i O[k] from bins 0 to m, conjugated so the 
+            forward transform performs an inverse one.
+        */
+        for (int k = 0; k < m; ++k)
+        {
+            const float aRe = data[2 * k];
+            const float aIm = data[2 * k + 1];
+            const float bRe = data[2 * (m - k)];
+            const float bIm = -data[2 * (m - k) + 1];
+
+            const float evenRe = 0.5f * (aRe + bRe);
+            const float evenIm = 0.5f * (aIm + bIm);
+            const float diffRe = 0.5f * (aRe - bRe);
+            const float diffIm = 0.5f * (aIm - bIm);
+
+            const float wr = plan.splitTwiddlesRe[k];
+            const float wi = -plan.splitTwiddlesIm[k];
+            const float oddRe = diffRe * wr - diffIm * wi;
+            const float oddIm = diffRe * wi + diffIm * wr;
+
+            re[k] =   evenRe - oddIm;
+            im[k] = -(evenIm + oddRe);
+        }
+
+        const float* zr;
+        const float* zi;
+        performComplexTransform (plan, re, im, workRe, workIm, 1, zr, zi);
+
+        const float scale = 1.0f / (float) m;
+
+        for (int i = 0; i < m; ++i)
+        {
+            data[2 * i]     =  zr[i] * scale;
+            data[2 * i + 1] = -zi[i] * scale;
+        }
+
+        FloatVectorOperations::clear (data + n, n);
+    }
+
+    /*
+        Transforms the half size complex array re / im, ping-ponging with workRe / workIm, and points outRe / outIm 
+        at whichever pair holds the result. numLanes independent arrays can be transformed together by interleaving
+        them element by element (element e of lane l at [e * numLanes + l]): every pass's inner loop runs over 
+        contiguous elements, so the lanes just make it wider.
+    */
+    static void performComplexTransform (const Plan& plan, float* re, float* im, float* workRe, float* workIm, int numLanes,
+                                         const float*& outRe, const float*& outIm) noexcept
+    {
+        float* xr = re;
+        float* xi = im;
+        float* yr = workRe;
+        float* yi = workIm;
+        int length = plan.halfSize;
+        int stride = numLanes;
+
+        for (int stage = 0; stage < plan.radices.size(); ++stage)
+        {
+            const int radix = plan.radices.getUnchecked (stage);
+            const int m     = length / radix;
+            const float* const twiddleRe = plan.stageTwiddlesRe + plan.stageTwiddleOffsets.getUnchecked (stage);
+            const float* const twiddleIm = plan.stageTwiddlesIm + plan.stageTwiddleOffsets.getUnchecked (stage);
+
+            switch (radix)
+            {
+                case 4:  performRadix4Pass (xr, xi, yr, yi, m, stride, twiddleRe, twiddleIm); break;
+                case 2:  performRadix2Pass (xr, xi, yr, yi, m, stride, twiddleRe, twiddleIm); break;
+                case 3:  performRadix3Pass (xr, xi, yr, yi, m, stride, twiddleRe, twiddleIm); break;
+                case 5:  performRadix5Pass (xr, xi, yr, yi, m, stride, twiddleRe, twiddleIm); break;
+                default: jassertfalse; break;
+            }
+
+            std::swap (xr, yr);
+            std::swap (xi, yi);
+            length  = m;
+            stride *= radix;
+        }
+
+        outRe = xr;
+        outIm = xi;
+    }
+
+private:
+    /*
+        Each pass reads input j of butterfly (p, q) from x[q + stride * (p + j * m)] and writes output k, 
+        rotated by the stage twiddle for (p, k), to y[q + stride * (radix * p + k)]. The inner q loops are 
+        contiguous and share one set of twiddles.
+    */
+    static void performRadix2Pass (const float* __restrict xr, const float* __restrict xi, float* __restrict yr, float* __restrict yi, int m, int stride, const float* twr, const float* twi) noexcept
+    {
+        for (int p = 0; p < m; ++p)
+        {
+            const float w1r = twr[p], w1i = twi[p];
+            const float* const a0r = xr + stride * p;       const float* const a0i = xi + stride * p;
+            const float* const a1r = xr + stride * (p + m); const float* const a1i = xi + stride * (p + m);
+            float* const y0r = yr + stride * (2 * p);     float* const y0i = yi + stride * (2 * p);
+            float* const y1r = yr + stride * (2 * p + 1); float* const y1i = yi + stride * (2 * p + 1);
+
+            for (int q = 0; q < stride; ++q)
+            {
+                const float dr = a0r[q] - a1r[q];
+                const float di = a0i[q] - a1i[q];
+                y0r[q] = a0r[q] + a1r[q];
+                y0i[q] = a0i[q] + a1i[q];
+                y1r[q] = dr * w1r - di * w1i;
+                y1i[q] = dr * w1i + di * w1r;
+            }
+        }
+    }
+
+    static void performRadix4Pass (const float* __restrict xr, const float* __restrict xi, float* __restrict yr, float* __restrict yi, int m, int stride, const float* twr, const float* twi) noexcept
+    {
+        for (int p = 0; p < m; ++p)
+        {
+            const float w1r = twr[p * 3],     w1i = twi[p * 3];
+            const float w2r = twr[p * 3 + 1], w2i = twi[p * 3 + 1];
+            const float w3r = twr[p * 3 + 2], w3i = twi[p * 3 + 2];
+            const float* const a0r = xr + stride * p;           const float* const a0i = xi + stride * p;
+            const float* const a1r = xr + stride * (p + m);     const float* const a1i = xi + stride * (p + m);
+            const float* const a2r = xr + stride * (p + 2 * m); const float* const a2i = xi + stride * (p + 2 * m);
+            const float* const a3r = xr + stride * (p + 3 * m); const float* const a3i = xi + stride * (p + 3 * m);
+            float* const y0r = yr + stride * (4 * p);     float* const y0i = yi + stride * (4 * p);
+            float* const y1r = yr + stride * (4 * p + 1); float* const y1i = yi + stride * (4 * p + 1);
+            float* const y2r = yr + stride * (4 * p + 2); float* const y2i = yi + stride * (4 * p + 2);
+            float* const y3r = yr + stride * (4 * p + 3); float* const y3i = yi + stride * (4 * p + 3);
+
+            /* Outputs 0 / 2 and 1 / 3 are written by separate loops, so few enough outputs share a loop for it to vectorise. */
+            for (int q = 0; q < stride; ++q)
+            {
+                const float s02r = a0r[q] + a2r[q], s02i = a0i[q] + a2i[q];
+                const float s13r = a1r[q] + a3r[q], s13i = a1i[q] + a3i[q];
+                const float b2r  = s02r - s13r,     b2i  = s02i - s13i;
+
+                y0r[q] = s02r + s13r;
+                y0i[q] = s02i + s13i;
+                y2r[q] = b2r * w2r - b2i * w2i;
+                y2i[q] = b2r * w2i + b2i * w2r;
+            }
+
+            for (int q = 0; q < stride; ++q)
+            {
+                const float d02r = a0r[q] - a2r[q], d02i = a0i[q] - a2i[q];
+                const float d13r = a1r[q] - a3r[q], d13i = a1i[q] - a3i[q];
+
+                /* Outputs 1 and 3 are d02 -/+ i * d13. */
+                const float b1r = d02r + d13i, b1i = d02i - d13r;
+                const float b3r = d02r - d13i, b3i = d02i + d13r;
+
+                y1r[q] = b1r * w1r - b1i * w1i;
+                y1i[q] = b1r * w1i + b1i * w1r;
+                y3r[q] = b3r * w3r - b3i * w3i;
+                y3i[q] = b3r * w3i + b3i * w3r;
+            }
+        }
+    }
+
+    static void performRadix3Pass (const float* __restrict xr, const float* __restrict xi, float* __restrict yr, float* __restrict yi, int m, int stride, const float* twr, const float* twi) noexcept
+    {
+        const float sin60 = 0.866025403784438647f;
+
+        for (int p = 0; p < m; ++p)
+        {
+            const float w1r = twr[p * 2],     w1i = twi[p * 2];
+            const float w2r = twr[p * 2 + 1], w2i = twi[p * 2 + 1];
+            const float* const a0r = xr + stride * p;           const float* const a0i = xi + stride * p;
+            const float* const a1r = xr + stride * (p + m);     const float* const a1i = xi + stride * (p + m);
+            const float* const a2r = xr + stride * (p + 2 * m); const float* const a2i = xi + stride * (p + 2 * m);
+            float* const y0r = yr + stride * (3 * p);     float* const y0i = yi + stride * (3 * p);
+            float* const y1r = yr + stride * (3 * p + 1); float* const y1i = yi + stride * (3 * p + 1);
+            float* const y2r = yr + stride * (3 * p + 2); float* const y2i = yi + stride * (3 * p + 2);
+
+            for (int q = 0; q < stride; ++q)
+            {
+                const float sr = a1r[q] + a2r[q], si = a1i[q] + a2i[q];
+                const float mr = a0r[q] - 0.5f * sr, mi = a0i[q] - 0.5f * si;
+
+                /* -i * sin (60) * (a1 - a2) */
+                const float rr = sin60 * (a1i[q] - a2i[q]);
+                const float ri = sin60 * (a2r[q] - a1r[q]);
+
+                const float b1r = mr + rr, b1i = mi + ri;
+                const float b2r = mr - rr, b2i = mi - ri;
+
+                y0r[q] = a0r[q] + sr;
+                y0i[q] = a0i[q] + si;
+                y1r[q] = b1r * w1r - b1i * w1i;
+                y1i[q] = b1r * w1i + b1i * w1r;
+                y2r[q] = b2r * w2r - b2i * w2i;
+                y2i[q] = b2r * w2i + b2i * w2r;
+            }
+        }
+    }
+
+    static void performRadix5Pass (const float* __restrict xr, const float* __restrict xi, float* __restrict yr, float* __restrict yi, int m, int stride, const float* twr, const float* twi) noexcept
+    {
+        const float cos72  =  0.309016994374947424f;
+        const float cos144 = -0.809016994374947424f;
+        const float sin72  =  0.951056516295153572f;
+        const float sin144 =  0.587785252292473129f;
+
+        for (int p = 0; p < m; ++p)
+        {
+            const float w1r = twr[p * 4],     w1i = twi[p * 4];
+            const float w2r = twr[p * 4 + 1], w2i = twi[p * 4 + 1];
+            const float w3r = twr[p * 4 + 2], w3i = twi[p * 4 + 2];
+            const float w4r = twr[p * 4 + 3], w4i = twi[p * 4 + 3];
+            const float* const a0r = xr + stride * p;           const float* const a0i = xi + stride * p;
+            const float* const a1r = xr + stride * (p + m);     const float* const a1i = xi + stride * (p + m);
+            const float* const a2r = xr + stride * (p + 2 * m); const float* const a2i = xi + stride * (p + 2 * m);
+            const float* const a3r = xr + stride * (p + 3 * m); const float* const a3i = xi + stride * (p + 3 * m);
+            const float* const a4r = xr + stride * (p + 4 * m); const float* const a4i = xi + stride * (p + 4 * m);
+            float* const y0r = yr + stride * (5 * p);     float* const y0i = yi + stride * (5 * p);
+            float* const y1r = yr + stride * (5 * p + 1); float* const y1i = yi + stride * (5 * p + 1);
+            float* const y2r = yr + stride * (5 * p + 2); float* const y2i = yi + stride * (5 * p + 2);
+            float* const y3r = yr + stride * (5 * p + 3); float* const y3i = yi + stride * (5 * p + 3);
+            float* const y4r = yr + stride * (5 * p + 4); float* const y4i = yi + stride * (5 * p + 4);
+
+            /* Outputs 0, 1 and 4 and outputs 2 and 3 are written by separate loops, so the loops can vectorise. */
+            for (int q = 0; q < stride; ++q)
+            {
+                const float s14r = a1r[q] + a4r[q], s14i = a1i[q] + a4i[q];
+                const float d14r = a1r[q] - a4r[q], d14i = a1i[q] - a4i[q];
+                const float s23r = a2r[q] + a3r[q], s23i = a2i[q] + a3i[q];
+                const float d23r = a2r[q] - a3r[q], d23i = a2i[q] - a3i[q];
+
+                /* Outputs 1 / 4 are m1 -/+ i * n1. */
+                const float m1r = a0r[q] + cos72 * s14r + cos144 * s23r;
+                const float m1i = a0i[q] + cos72 * s14i + cos144 * s23i;
+                const float n1r = sin72 * d14r + sin144 * d23r, n1i = sin72 * d14i + sin144 * d23i;
+
+                const float b1r = m1r + n1i, b1i = m1i - n1r;
+                const float b4r = m1r - n1i, b4i = m1i + n1r;
+
+                y0r[q] = a0r[q] + s14r + s23r;
+                y0i[q] = a0i[q] + s14i + s23i;
+                y1r[q] = b1r * w1r - b1i * w1i;
+                y1i[q] = b1r * w1i + b1i * w1r;
+                y4r[q] = b4r * w4r - b4i * w4i;
+                y4i[q] = b4r * w4i + b4i * w4r;
+            }
+
+            for (int q = 0; q < stride; ++q)
+            {
+                const float s14r = a1r[q] + a4r[q], s14i = a1i[q] + a4i[q];
+                const float d14r = a1r[q] - a4r[q], d14i = a1i[q] - a4i[q];
+                const float s23r = a2r[q] + a3r[q], s23i = a2i[q] + a3i[q];
+                const float d23r = a2r[q] - a3r[q], d23i = a2i[q] - a3i[q];
+
+                /* Outputs 2 / 3 are m2 -/+ i * n2. */
+                const float m2r = a0r[q] + cos144 * s14r + cos72 * s23r;
+                const float m2i = a0i[q] + cos144 * s14i + cos72 * s23i;
+                const float n2r = sin144 * d14r - sin72 * d23r, n2i = sin144 * d14i - sin72 * d23i;
+
+                const float b2r = m2r + n2i, b2i = m2i - n2r;
+                const float b3r = m2r - n2i, b3i = m2i + n2r;
+
+                y2r[q] = b2r * w2r - b2i * w2i;
+                y2i[q] = b2r * w2i + b2i * w2r;
+                y3r[q] = b3r * w3r - b3i * w3i;
+                y3i[q] = b3r * w3i + b3i * w3r;
+            }
+        }
+    }
+
+    const Plan&      plan;
+    HeapBlock<float> re;
+    HeapBlock<float> im;
+    HeapBlock<float> workRe;
+    HeapBlock<float> workIm;
+};
+
+//==============================================================================
+/*
+    Transforms several real signals of the same size at once with the bundled FFT. The signals are interleaved 
+    sample by sample (structure of arrays) before the transform, so each SIMD lane of the butterflies handles 
+    one signal, which is much faster than transforming many signals one after another. Each signal's spectrum 
+    is written in the FFTBackend layout.
+*/
+class BatchedBundledFFT
+{
+public:
+    BatchedBundledFFT (int fftSize, int maxNumSignalsToUse)
+    :   plan          (FFTPlanCache<BundledFFTBackend::Plan>::getPlan (fftSize)),
+        maxNumSignals (maxNumSignalsToUse)
+    {
+        const size_t numFloats = (size_t) plan.halfSize * (size_t) maxNumSignals;
+        re.malloc     (numFloats);
+        im.malloc     (numFloats);
+        workRe.malloc (numFloats);
+        workIm.malloc (numFloats);
+    }
+
+    int getSize()          const noexcept { return plan.size; }
+    int getMaxNumSignals() const noexcept { return maxNumSignals; }
+
+    /* 
+        timeData[s] holds getSize() samples of signal s, and spectra[s] must have room for getSize() * 2 floats. 
+        A signal's spectrum can be written over its own time data.
+    */
+    void performRealForward (const float* const* timeData, float* const* spectra, int numSignals) noexcept
+    {
+        jassert (numSignals > 0 && numSignals <= maxNumSignals);
+        const int n = plan.size;
+        const int m = plan.halfSize;
+
+        for (int i = 0; i < m; ++i)
+        {
+            float* const laneRe = re + i * numSignals;
+            float* const laneIm = im + i * numSignals;
+
+            for (int signal = 0; signal < numSignals; ++signal)
+            {
+                laneRe[signal] = timeData[signal][2 * i];
+                laneIm[signal] = timeData[signal][2 * i + 1];
+            }
+        }
+
+        const float* zr;
+        const float* zi;
+        BundledFFTBackend::performComplexTransform (plan, re, im, workRe, workIm, numSignals, zr, zi);
+
+        for (int signal = 0; signal < numSignals; ++signal)
+        {
+            float* const data = spectra[signal];
+            data[0]     = zr[signal] + zi[signal];
+            data[1]     = 0.0f;
+            data[n]     = zr[signal] - zi[signal];
+            data[n + 1] = 0.0f;
+        }
+
+        for (int k = 1; k < m; ++k)
+        {
+            const float* const ar = zr + k * numSignals;
+            const float* const ai = zi + k * numSignals;
+            const float* const br = zr + (m - k) * numSignals;
+            const float* const bi = zi + (m - k) * numSignals;
+            const float wr = plan.splitTwiddlesRe[k];
+            const float wi = plan.splitTwiddlesIm[k];
+
+            /* The same split as BundledFFTBackend::performRealForward(), across the signals. */
+            for (int signal = 0; signal < numSignals; ++signal)
+            {
+                const float evenRe = 0.5f * (ar[signal] + br[signal]);
+                const float evenIm = 0.5f * (ai[signal] - bi[signal]);
+                const float oddRe  = 0.5f * (ai[signal] + bi[signal]);
+                const float oddIm  = 0.5f * (br[signal] - ar[signal]);
+                const float binRe  = evenRe + wr * oddRe - wi * oddIm;
+                const float binIm  = evenIm + wr * oddIm + wi * oddRe;
+
+                float* const data = spectra[signal];
+                data[2 * k]           = binRe;
+                data[2 * k + 1]       = binIm;
+                data[2 * (n - k)]     = binRe;
+                data[2 * (n - k) + 1] = -binIm;
+            }
+        }
+    }
+
+private:
+    const BundledFFTBackend::Plan& plan;
+    const int        maxNumSignals;
+    HeapBlock<float> re;
+    HeapBlock<float> im;
+    HeapBlock<float> workRe;
+    HeapBlock<float> workIm;
+
+    JUCE_DECLARE_NON_COPYABLE (BatchedBundledFFT)
+};
+
+//==============================================================================
+#if FEATURE_EXTRACTOR_USE_FFTW
+/* FFTW's real-to-complex and complex-to-real transforms, planned with FFTW_MEASURE. Any size. */
+class FFTWBackend : public FFTBackend
+{
+public:
+    struct Plan
+    {
+        Plan (int fftSize)
+        :   size (fftSize)
+        {
+            /* Planning overwrites the arrays, so plan on scratch arrays (fftwf_malloc keeps the alignment the same). */
+            float*         realData    = fftwf_alloc_real    ((size_t) size);
+            fftwf_complex* complexData = fftwf_alloc_complex ((size_t) (size / 2 + 1));
+            forward = fftwf_plan_dft_r2c_1d (size, realData, complexData, FFTW_MEASURE);
+            inverse = fftwf_plan_dft_c2r_1d (size, complexData, realData, FFTW_MEASURE);
+            fftwf_free (realData);
+            fftwf_free (complexData);
+        }
+
+        ~Plan()
+        {
+            fftwf_destroy_plan (forward);
+            fftwf_destroy_plan (inverse);
+        }
+
+        const int  size;
+        fftwf_plan forward;
+        fftwf_plan inverse;
+    };
+
+    FFTWBackend (int fftSize)
+    :   FFTBackend  (fftSize),
+        plan        (FFTPlanCache<Plan>::getPlan (fftSize)),
+        realData    (fftwf_alloc_real    ((size_t) fftSize)),
+        complexData (fftwf_alloc_complex ((size_t) (fftSize / 2 + 1)))
+    {}
+
+    ~FFTWBackend()
+    {
+        fftwf_free (realData);
+        fftwf_free (complexData);
+    }
+
+    void performRealForward (float* data) override
+    {
+        const int n = getSize();
+        FloatVectorOperations::copy (realData, data, n);
+
+        /* The new-array execute functions are safe to call on a shared plan from several threads. */
+        fftwf_execute_dft_r2c (plan.forward, realData, complexData);
+
+        for (int k = 0; k <= n / 2; ++k)
+        {
+            data[2 * k]     = complexData[k][0];
+            data[2 * k + 1] = complexData[k][1];
+        }
+
+        for (int k = n / 2 + 1; k < n; ++k)
+        {
+            data[2 * k]     =  complexData[n - k][0];
+            data[2 * k + 1] = -complexData[n - k][1];
+        }
+    }
+
+    void performRealInverse (float* data) override
+    {
+        const int n = getSize();
+
+        for (int k = 0; k <= n / 2; ++k)
+        {
+            complexData[k][0] = data[2 * k];
+            complexData[k][1] = data[2 * k + 1];
+        }
+
+        fftwf_execute_dft_c2r (plan.inverse, complexData, realData);
+
+        FloatVectorOperations::copyWithMultiply (data, realData, 1.0f / (float) n, n);
+        FloatVectorOperations::clear (data + n, n);
+    }
+
+private:
+    const Plan&    plan;
+    float*         realData;
+    fftwf_complex* complexData;
+};
+#endif
+
+//==============================================================================
+inline FFTBackend* FFTBackend::create (eType t, int size)
+{
+    if (! isAvailable (t))
+        t = getDefaultType();
+
+    if (! supportsSize (t, size))
+        t = enBundled;
+
+    switch (t)
+    {
+       #if FEATURE_EXTRACTOR_USE_FFTW
+        case enFFTW:    return new FFTWBackend (size);
+       #endif
+        case enJuce:    return new JuceFFTBackend (size);
+        case enBundled:
+        default:        return new BundledFFTBackend (size);
+    }
+}
+
+inline FFTBackend::eType FFTBackend::findFastestType (int size, int numIterations)
+{
+    HeapBlock<float> testSignal ((size_t) size);
+    HeapBlock<float> data ((size_t) size * 2);
+
+    for (int i = 0; i < size; ++i)
+        testSignal[i] = (float) (std::sin (0.05 * i) + 0.5 * std::sin (0.31 * i));
+
+    eType  fastestType = enBundled;
+    double fastestTime = std::numeric_limits<double>::max();
+
+    for (int t = 0; t < numTypes; ++t)
+    {
+        if (! isAvailable ((eType) t) || ! supportsSize ((eType) t, size))
+            continue;
+
+        ScopedPointer<FFTBackend> backend (create ((eType) t, size));
+
+        /* The first run is not timed, so cold caches don't count. */
+        FloatVectorOperations::copy (data, testSignal, size);
+        backend->performRealForward (data);
+        backend->performRealInverse (data);
+
+        const int64 startTicks = Time::getHighResolutionTicks();
+
+        for (int iteration = 0; iteration < numIterations; ++iteration)
+        {
+            FloatVectorOperations::copy (data, testSignal, size);
+            backend->performRealForward (data);
+            backend->performRealInverse (data);
+        }
+
+        const double seconds = Time::highResolutionTicksToSeconds (Time::getHighResolutionTicks() - startTicks);
+
+        if (seconds < fastestTime)
+        {
+            fastestTime = seconds;
+            fastestType = (eType) t;
+        }
+    }
+
+    return fastestType;
+}
+
+#endif  // FFTBACKEND_H_INCLUDED
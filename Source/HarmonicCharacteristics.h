@@ -37,66 +37,41 @@ struct HarmonicEnergyCharacteristics
 };
 
 
+/* 
+    The harmonic energy ratio, odd to even harmonic ratio and inharmonicity of a frame, given its pitch. All three
+    are measured from the frame's SpectralPeaks, at their interpolated frequencies and heights.
+*/
 class HarmonicCharacteristicsAnalyser
 {
 public:
     HarmonicCharacteristicsAnalyser () 
     {}
 
-    HarmonicCharacteristics calculateHarmonicCharacteristics (AudioSampleBuffer& fftResults, double f0Estimation, double nyquist, int channel)
+    /* powerSpectrum holds numMagnitudes bins, from 0 Hz up to (but not including) nyquist, and peaks are its peaks. */
+    HarmonicCharacteristics calculateHarmonicCharacteristics (const float* powerSpectrum, int numMagnitudes, const SpectralPeaks& peaks, double f0Estimation, double nyquist)
     {
-        std::vector<int> peakBins;
-        peakBins.clear();
-        
-        jassert (fftResults.getNumSamples() % 2 == 0);
-        const int numFFTElements = (int) fftResults.getNumSamples() / 2;
-        const int numMagnitudes  = (int) numFFTElements / 2;
-
-        //calculate mean bin magnitude and maximum bin magnitude
-        double meanMagnitude = 0.0;
         double magnitudeSum = 0.0;
-        double maxMagnitude = 0.0;
-        std::vector<double> binMagnitudes ((size_t)numMagnitudes);
 
         for (int i = 0; i < numMagnitudes; i++)
-        {
-            double binValue     = (double) fftResults.getSample (channel, i * 2);
-            double binMagnitude = binValue * binValue;
-            binMagnitudes[i]    = binMagnitude;
-            magnitudeSum       += binMagnitude;
-            if (binMagnitude > maxMagnitude)
-                maxMagnitude = binMagnitude;
-        }
-        
-        AudioSampleBuffer normedMagnitudes (1, numMagnitudes);
-        double sumNormedMagnitude = 0.0;
-        for (int bin = 0; bin < numMagnitudes; bin++)
-        {
-            double normedMagnitude = binMagnitudes[bin] / maxMagnitude;
-            normedMagnitudes.setSample (0, bin, (float) normedMagnitude);
-            sumNormedMagnitude += normedMagnitude;
-        }
+            magnitudeSum += (double) powerSpectrum[i];
 
         if (fftMagnitudesToDrawNeedsUpdating.get() == 1)
         {
+            const float maxMagnitude = FloatVectorOperations::findMaximum (powerSpectrum, numMagnitudes);
             fftMagnitudesToDraw.setSize (1, numMagnitudes);
-            fftMagnitudesToDraw = AudioSampleBuffer (normedMagnitudes);
+            FloatVectorOperations::copyWithMultiply (fftMagnitudesToDraw.getWritePointer (0), powerSpectrum, 
+                                                     maxMagnitude > 0.0f ? 1.0f / maxMagnitude : 0.0f, numMagnitudes);
             fftMagnitudesToDrawNeedsUpdating.set (0);
         }
-        meanMagnitude = magnitudeSum / (double) numMagnitudes;
 
-        if (magnitudeSum < 0.005)
+        if (magnitudeSum < 0.005 || f0Estimation <= 0.0)
             return {0.0, 0.0, 0.0};
-
-        fillPeakBins (binMagnitudes, channel, peakBins, meanMagnitude);
         
         double frequencyRangePerBin = nyquist / (double) numMagnitudes;
-        HarmonicEnergyCharacteristics h = calculateHarmonicEnergyCharacteristics (/*peakBins*/normedMagnitudes, f0Estimation, frequencyRangePerBin, sumNormedMagnitude, 15.0, 3.0);
+        HarmonicEnergyCharacteristics h = calculateHarmonicEnergyCharacteristics (peaks, f0Estimation, frequencyRangePerBin, magnitudeSum, 15.0, 3.0);
         double harmonicEnergyRatio = h.harmonicEnergyRatio;
         double oddEvenHarmonicRatio = h.oddEvenHarmonicRatio;
-        double inharmonicity = 0.0;
-        if (f0Estimation > 0.0)
-            inharmonicity = calculateInharmonicity (binMagnitudes, f0Estimation, frequencyRangePerBin, peakBins, magnitudeSum);
+        double inharmonicity = calculateInharmonicity (peaks, f0Estimation, frequencyRangePerBin, magnitudeSum);
 
         float logHER    = log10 (harmonicEnergyRatio * 9.0 + 1.0);
         float logInharm = log10 (inharmonicity       * 9.0 + 1.0);
@@ -112,42 +87,10 @@ private:
     AudioSampleBuffer fftMagnitudesToDraw;
     Atomic<int>       fftMagnitudesToDrawNeedsUpdating;
 
-    static void fillPeakBins (std::vector<double>& binMagnitudes, int channel, std::vector<int>& peakBins, double meanMagnitude)
-    {
-        const int numMagnitudes  = (int) binMagnitudes.size();
-        for (int bin = 0; bin < numMagnitudes; ++bin)
-        {
-            bool peak = binIsPeak (bin, binMagnitudes, channel, meanMagnitude);
-            
-            if (peak)
-                peakBins.push_back (bin);
-        }
-    }
-
-    static bool binIsPeak (int bin, std::vector<double>& binMagnitudes, int channel, double meanMagnitude)
-    {
-        const int numMagnitudes  = (int) binMagnitudes.size();
-        double binMagnitude = binMagnitudes[bin];
-        
-        if (binMagnitude <= meanMagnitude)
-            return false;
-
-        //offsets to ensure no out of bounds checks
-        int leftBinOffset  = bin < 2 ? 2 - bin : 0;
-        int rightBinOffset = bin >= numMagnitudes - 2 ? 2 - ((numMagnitudes - 1) - bin) : 0; 
-        for (int neighbour = bin - (2 - leftBinOffset); neighbour < bin + (2 - rightBinOffset); neighbour++)
-        {
-            double neighbourMagnitude = binMagnitudes[neighbour];
-            if (neighbour != bin && neighbourMagnitude > binMagnitude)
-                return false;
-        }
-        return true;
-    }
-
-    static HarmonicEnergyCharacteristics  calculateHarmonicEnergyCharacteristics (AudioSampleBuffer& normalisedBinMagnitudes, 
+    static HarmonicEnergyCharacteristics  calculateHarmonicEnergyCharacteristics (const SpectralPeaks& peaks, 
                                                                                   double f0Estimate,
                                                                                   double frequencyRangePerBin, 
-                                                                                  double totalNormedMagnitude,
+                                                                                  double magnitudeSum,
                                                                                   double numLower,
                                                                                   double numHarmonics)
     {
@@ -158,32 +101,24 @@ private:
         for (double lower = 1.0; lower < numLower + 1.0; ++lower)
         {
             double lowerHarmFreq = f0Estimate / pow(2.0, lower);
-            int lowerHarmBin = getBinForFrequency (lowerHarmFreq, frequencyRangePerBin);
             
-            if (lowerHarmBin == getBinForFrequency (f0Estimate, frequencyRangePerBin))
+            if (getBinForFrequency (lowerHarmFreq, frequencyRangePerBin) == getBinForFrequency (f0Estimate, frequencyRangePerBin))
                 continue;
 
-            double binMagnitude = getMaxBinInNeighbourhood (lowerHarmBin, 2, normalisedBinMagnitudes);//normalisedBinMagnitudes.getSample (0, harmonicBin);
-            harmonicScore += binMagnitude;
+            harmonicScore += getPeakEnergyNear (peaks, lowerHarmFreq / frequencyRangePerBin);
         }
         for (double harmonic = 1.0; harmonic < numHarmonics + 1.0; harmonic++)
         {
-            double harmonicFrequency = f0Estimate * harmonic;
-            int harmonicBin = getBinForFrequency (harmonicFrequency, frequencyRangePerBin);
-
-            if (harmonicBin >= normalisedBinMagnitudes.getNumSamples())
-                break;
-
-            double binMagnitude = getMaxBinInNeighbourhood (harmonicBin, 2, normalisedBinMagnitudes);//normalisedBinMagnitudes.getSample (0, harmonicBin);
+            double peakEnergy = getPeakEnergyNear (peaks, f0Estimate * harmonic / frequencyRangePerBin);
             
             if (int(harmonic) % 2 == 0)
-                evenHarmonicEnergy += binMagnitude;
+                evenHarmonicEnergy += peakEnergy;
             else
-                oddHarmonicEnergy += binMagnitude;
+                oddHarmonicEnergy += peakEnergy;
 
-            harmonicScore += binMagnitude;
+            harmonicScore += peakEnergy;
         }
-        double her = harmonicScore / totalNormedMagnitude;
+        double her = harmonicScore / magnitudeSum;
         if (her > 1.0) her = 1.0;
         if (her < 0.0) her = 0.0;
 
@@ -197,35 +132,26 @@ private:
         return { (float) her, (float) oer };
     }
 
-    static double getMaxBinInNeighbourhood (int centreBin, int neighbourhoodRange, AudioSampleBuffer& binMagnitudes)
+    /* The height of the highest peak within two bins of a (fractional) bin position, or 0 if there is none. */
+    static double getPeakEnergyNear (const SpectralPeaks& peaks, double position)
     {
-        const int numBins = binMagnitudes.getNumSamples();
-        int startIndex = centreBin - neighbourhoodRange >= 0 ? centreBin - neighbourhoodRange : 0;
-        int endIndex   = centreBin + neighbourhoodRange < numBins ? centreBin + neighbourhoodRange : numBins;
-        double maxMagnitude = binMagnitudes.getSample (0, centreBin);
-        for (int b = startIndex; b < endIndex; b++)
-            if (binMagnitudes.getSample (0, b) > maxMagnitude)
-                maxMagnitude = binMagnitudes.getSample (0, b);
-        return maxMagnitude;
+        const SpectralPeaks::Peak* peak = peaks.findHighestPeakNear (position, 2.0);
+        return peak != nullptr ? (double) peak->value : 0.0;
     }
 
-    static double calculateInharmonicity (std::vector<double>& binMagnitudes, double f0Estimate, 
-                                          double frequencyRangePerBin, std::vector<int>& peakBins, 
-                                          double magnitudeSum)
+    static double calculateInharmonicity (const SpectralPeaks& peaks, double f0Estimate, 
+                                          double frequencyRangePerBin, double magnitudeSum)
     {
         double inharmonicity = 0.0;
         int f0Bin = getBinForFrequency (f0Estimate, frequencyRangePerBin);
-        for (auto bin : peakBins)
+        for (auto& peak : peaks)
         {
-            if (f0Bin == bin) //f0 exists in this bin, so don't add any inharmonicity score
+            if (f0Bin == peak.bin) //f0 exists in this bin, so don't add any inharmonicity score
                 continue;
 
-            double binStartFrequency = bin * frequencyRangePerBin;
-
-            if (binStartFrequency == 0.0)//avoid peak in bin 1 leading to division by 0
-                binStartFrequency = frequencyRangePerBin * 0.5;
-
-            double binEndFrequency   = (double) (bin + 1) * frequencyRangePerBin;
+            /* a bin's width, centred on the peak's interpolated frequency */
+            double binStartFrequency = ((double) peak.position - 0.5) * frequencyRangePerBin;
+            double binEndFrequency   = ((double) peak.position + 0.5) * frequencyRangePerBin;
             double binStartF0Ratio   = getFrequencyRatio (binStartFrequency, f0Estimate);
             double binEndF0Ratio     = getFrequencyRatio (binEndFrequency, f0Estimate);
 
@@ -234,18 +160,18 @@ private:
 
             double f0Ratio = binStartF0Ratio < binEndF0Ratio ? binStartF0Ratio : binEndF0Ratio;
             double f0Proportion = f0Ratio - floor (f0Ratio);
-            double binEnergyRatio = binMagnitudes[bin] / magnitudeSum;
+            double binEnergyRatio = (double) peak.value / magnitudeSum;
             jassert (binEnergyRatio < 1.0);
             inharmonicity += f0Proportion * binEnergyRatio;
-            jassert (inharmonicity < 1.0);
         }
         jassert (inharmonicity >= 0.0);
-        return inharmonicity;
+        return jmin (inharmonicity, 1.0);
     } 
 
+    /* Bin k is centred on k * frequencyRangePerBin, so a frequency belongs to the nearest bin centre. */
     static int getBinForFrequency (double freq, double frequencyRangePerBin)
     {
-        return (int)(floor(freq / frequencyRangePerBin));
+        return roundToInt (freq / frequencyRangePerBin);
     }
 
     static double getFrequencyRatio (double frequency1, double frequency2)
@@ -0,0 +1,208 @@
+/*
+  ==============================================================================
+
+    MFCCAnalyser.h
+    Created: 14 Nov 2016 11:02:45am
+    Author:  Sean
+
+  ==============================================================================
+*/
+
+#ifndef MFCCANALYSER_H_INCLUDED
+#define MFCCANALYSER_H_INCLUDED
+
+/*
+    Triangular mel-spaced filters over a power spectrum, stored sparsely: each band keeps the first bin it
+    covers and the weights of the bins it overlaps, all packed into one contiguous array. Built once per
+    FFT size, sample rate and band count.
+*/
+class MelFilterbank
+{
+public:
+    MelFilterbank() {}
+
+    /* Allocates, so only call this while the analysis thread is stopped. */
+    void setup (int numMagnitudes, double sampleRate, int newNumBands)
+    {
+        numBands = newNumBands;
+        bandStartBins.resize ((size_t) numBands);
+        bandWeightOffsets.resize ((size_t) numBands + 1);
+        weights.clear();
+
+        const double binWidth = (sampleRate / 2.0) / (double) numMagnitudes;
+        const double minMel   = frequencyToMel (0.0);
+        const double maxMel   = frequencyToMel (sampleRate / 2.0);
+
+        /* numBands + 2 equally spaced points on the mel scale give each band's lower edge, centre and upper edge */
+        std::vector<double> edgeFrequencies ((size_t) numBands + 2);
+        for (size_t i = 0; i < edgeFrequencies.size(); ++i)
+            edgeFrequencies[i] = melToFrequency (minMel + (maxMel - minMel) * (double) i / (double) (numBands + 1));
+
+        for (int band = 0; band < numBands; ++band)
+        {
+            const double lower  = edgeFrequencies[(size_t) band];
+            const double centre = edgeFrequencies[(size_t) band + 1];
+            const double upper  = edgeFrequencies[(size_t) band + 2];
+
+            const int startBin = jlimit (0, numMagnitudes - 1, (int) ceil  (lower / binWidth));
+            const int endBin   = jlimit (startBin, numMagnitudes - 1, (int) floor (upper / binWidth));
+
+            bandStartBins[(size_t) band]     = startBin;
+            bandWeightOffsets[(size_t) band] = (int) weights.size();
+
+            for (int bin = startBin; bin <= endBin; ++bin)
+            {
+                const double f = (double) bin * binWidth;
+                const double w = f <= centre ? (f - lower) / (centre - lower) : (upper - f) / (upper - centre);
+                weights.push_back ((float) jmax (0.0, w));
+            }
+        }
+
+        bandWeightOffsets[(size_t) numBands] = (int) weights.size();
+    }
+
+    /* Writes the energy in each band to bandEnergies, which holds getNumBands() floats. */
+    void apply (const float* powerSpectrum, float* bandEnergies) const noexcept
+    {
+        for (int band = 0; band < numBands; ++band)
+        {
+            const float* bandWeights = weights.data() + bandWeightOffsets[(size_t) band];
+            const float* bins        = powerSpectrum + bandStartBins[(size_t) band];
+            const int    numWeights  = bandWeightOffsets[(size_t) band + 1] - bandWeightOffsets[(size_t) band];
+
+            float energy = 0.0f;
+            for (int i = 0; i < numWeights; ++i)
+                energy += bandWeights[i] * bins[i];
+
+            bandEnergies[band] = energy;
+        }
+    }
+
+    int getNumBands()    const noexcept { return numBands; }
+    int getNumWeights()  const noexcept { return (int) weights.size(); }
+
+    /* HTK's mel scale. */
+    static double frequencyToMel (double frequency) { return 2595.0 * log10 (1.0 + frequency / 700.0); }
+    static double melToFrequency (double mel)       { return 700.0 * (pow (10.0, mel / 2595.0) - 1.0); }
+
+private:
+    int                numBands { 0 };
+    std::vector<int>   bandStartBins;
+    std::vector<int>   bandWeightOffsets;  // band b's weights are weights[bandWeightOffsets[b] .. bandWeightOffsets[b + 1])
+    std::vector<float> weights;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (MelFilterbank)
+};
+
+//==============================================================================
+//==============================================================================
+
+/*
+    Mel-frequency cepstral coefficients of a power spectrum: mel filterbank energies, their logs, then an
+    orthonormal DCT-II as a precomputed matrix multiply. Coefficient 0 is the overall log energy.
+*/
+class MFCCAnalyser
+{
+public:
+    enum { defaultNumCoefficients = 13, defaultNumBands = 40 };
+
+    MFCCAnalyser (int numSamplesPerWindow, double sampleRate = 48000.0,
+                  int numCoefficientsToUse = defaultNumCoefficients, int numBandsToUse = defaultNumBands)
+    :   numCoefficients (numCoefficientsToUse),
+        numBands        (numBandsToUse)
+    {
+        prepare (numSamplesPerWindow, sampleRate);
+    }
+
+    /* Allocates, so only call this while the analysis thread is stopped. */
+    void prepare (int numSamplesPerWindow, double newSampleRate)
+    {
+        windowSize = numSamplesPerWindow;
+        sampleRate = newSampleRate;
+        jassert (numCoefficients > 0 && numCoefficients <= numBands);
+
+        filterbank.setup (numSamplesPerWindow / 2, sampleRate, numBands);
+        logBandEnergies.setSize (numBands);
+        coefficients.setSize (numCoefficients);
+        dctMatrix.setSize (numCoefficients * numBands);
+
+        /* row k: sqrt (2 / N) * cos (pi * k * (n + 0.5) / N), with row 0 scaled by 1 / sqrt (2) to make the transform orthonormal */
+        float* row = dctMatrix.getData();
+        for (int k = 0; k < numCoefficients; ++k, row += numBands)
+        {
+            const double scale = sqrt ((k == 0 ? 1.0 : 2.0) / (double) numBands);
+
+            for (int n = 0; n < numBands; ++n)
+                row[n] = (float) (scale * cos (double_Pi * (double) k * ((double) n + 0.5) / (double) numBands));
+        }
+    }
+
+    /* Allocates, so only call this while the analysis thread is stopped. */
+    void setNumCoefficientsAndBands (int newNumCoefficients, int newNumBands)
+    {
+        numCoefficients = newNumCoefficients;
+        numBands        = newNumBands;
+        prepare (windowSize, sampleRate);
+    }
+
+    /* Returns getNumCoefficients() coefficients, valid until the next call. */
+    const float* calculateMFCCs (const float* powerSpectrum, int numMagnitudes)
+    {
+        jassert (numMagnitudes == windowSize / 2);
+        ignoreUnused (numMagnitudes);
+
+        float* logEnergies = logBandEnergies.getData();
+        filterbank.apply (powerSpectrum, logEnergies);
+
+        for (int band = 0; band < numBands; ++band)
+            logEnergies[band] = std::log (logEnergies[band] + energyFloor());
+
+        const float* row = dctMatrix.getData();
+        float* c         = coefficients.getData();
+        for (int k = 0; k < numCoefficients; ++k, row += numBands)
+        {
+            float sum = 0.0f;
+            for (int n = 0; n < numBands; ++n)
+                sum += row[n] * logEnergies[n];
+
+            c[k] = sum;
+        }
+
+        return c;
+    }
+
+    /* 
+        The coefficients of a silent frame, every band at the energy floor: coefficient 0 is the floor's log 
+        energy and the rest are 0. Returns getNumCoefficients() coefficients, valid until the next call.
+    */
+    const float* getSilentMFCCs()
+    {
+        /* the DCT of a constant: only row 0 (every entry 1 / sqrt (N)) doesn't sum to 0 */
+        float* c = coefficients.getData();
+        FloatVectorOperations::clear (c, numCoefficients);
+        c[0] = (float) (sqrt ((double) numBands) * std::log ((double) energyFloor()));
+        return c;
+    }
+
+    int getNumCoefficients() const { return numCoefficients; }
+    int getNumBands()        const { return numBands; }
+
+    const MelFilterbank& getFilterbank() const { return filterbank; }
+
+private:
+    /* keeps log() finite for silent bands, about -230 dB */
+    static float energyFloor() { return 1.0e-10f; }
+
+    int                numCoefficients;
+    int                numBands;
+    int                windowSize { 0 };
+    double             sampleRate { 48000.0 };
+    MelFilterbank      filterbank;
+    AlignedFloatBuffer logBandEnergies;
+    AlignedFloatBuffer dctMatrix;     // numCoefficients rows of numBands
+    AlignedFloatBuffer coefficients;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (MFCCAnalyser)
+};
+
+#endif  // MFCCANALYSER_H_INCLUDED
@@ -9,6 +9,7 @@
 */
 
 #include "../JuceLibraryCode/JuceHeader.h"
+#include "FFTBackend.h"
 
 Component* createMainContentComponent();
 
@@ -24,10 +25,12 @@ public:
     bool moreThanOneInstanceAllowed() override       { return true; }
 
     //==============================================================================
-    void initialise (const String& /*commandLine*/) override
+    void initialise (const String& commandLine) override
     {
         // This method is where you should put your application's initialisation code..
 
+        FFTBackend::setDefaultType (getFFTBackendType (commandLine));
+        DBG ("FFT backend: " << FFTBackend::getName (FFTBackend::getDefaultType()));
         mainWindow = new MainWindow (getApplicationName());
     }
 
@@ -38,6 +41,29 @@ public:
         mainWindow = nullptr; // (deletes our window)
     }
 
+    /* 
+        --fft=juce, --fft=bundled or --fft=fftw picks the FFT backend. Without it (or with --fft=auto), 
+        each available backend is timed at the default window size (40 ms at 48kHz) and the fastest is used. 
+    */
+    static FFTBackend::eType getFFTBackendType (const String& commandLine)
+    {
+        StringArray args;
+        args.addTokens (commandLine, true);
+
+        for (auto& arg : args)
+        {
+            if (arg.startsWith ("--fft="))
+            {
+                const FFTBackend::eType requested = FFTBackend::getTypeForName (arg.fromFirstOccurrenceOf ("=", false, false));
+
+                if (FFTBackend::isAvailable (requested))
+                    return requested;
+            }
+        }
+
+        return FFTBackend::findFastestType (1920);
+    }
+
     //==============================================================================
     void systemRequestedQuit() override
     {
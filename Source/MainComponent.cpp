@@ -22,14 +22,22 @@ class MainContentComponent   : public  AudioAppComponent,
 public:
     //==============================================================================
     MainContentComponent() 
-    
+    :   capture (maxInputChannels)
     {
+        //with many channels, --batch-analysis transforms every track's windows together on one thread
+        if (JUCEApplicationBase::getCommandLineParameters().contains ("--batch-analysis"))
+        {
+            batchedAnalyser = new BatchedRealTimeAnalyser (maxInputChannels * 2);
+            batchedAnalyser->startThread (4);
+        }
+
         setLookAndFeel (lookAndFeel);
         setSize (800, 600);
         // specify the number of input and output channels that we want to open
         setAudioChannels  (2, 2);
         
         deviceManager.addChangeListener (this);
+        deviceManager.addAudioCallback (&capture);
         
         setAudioSettingsDeviceManager (deviceManager);
         //deviceManager.addAudioCallback (&view.getAudioDisplayComponent());
@@ -44,6 +52,7 @@ public:
     ~MainContentComponent()
     {
         deviceManager.removeChangeListener (this);
+        deviceManager.removeAudioCallback (&capture);
         shutdownAudio();
     }
 
@@ -109,7 +118,6 @@ public:
     void setAudioSettingsDeviceManager (AudioDeviceManager& deviceManager)
     {
         const int minInputChannels              = 0;
-        const int maxInputChannels              = 15;
         const int minOutputchannels             = 0;
         const int maxOutputchannels             = 0;
         const bool showMidiIn                   = false;
@@ -167,12 +175,12 @@ public:
 
     void addAnalyserTrack (int channelToAnalyse, String channelName)
     {
-        analyserControllers.add (new AnalyserTrackController (deviceManager, channelToAnalyse, channelName, "127.0.0.1:9000", "127.0.0.1:9000", String("/Audio/A") + String(channelToAnalyse)));
+        analyserControllers.add (new AnalyserTrackController (deviceManager, capture, channelToAnalyse, channelName, "127.0.0.1:9000", "127.0.0.1:9000", String("/Audio/A") + String(channelToAnalyse), batchedAnalyser));
     }
 
     void addDisabledAnalyserTrack (String channelName)
     {
-        analyserControllers.add (new AnalyserTrackController (deviceManager, -1, channelName, "127.0.0.1:9000", "127.0.0.1:9000", String::empty));
+        analyserControllers.add (new AnalyserTrackController (deviceManager, capture, -1, channelName, "127.0.0.1:9000", "127.0.0.1:9000", String::empty));
     }
 
     void clearAllTracks()
@@ -220,7 +228,10 @@ public:
     }
 
 private:
+    static const int                                   maxInputChannels = 15;
     SharedResourcePointer<FeatureExtractorLookAndFeel> lookAndFeel;
+    MultiChannelAudioCapture                           capture;
+    ScopedPointer<BatchedRealTimeAnalyser>             batchedAnalyser;
     ScopedPointer<ChannelSelectorPanel>                channelSelector;
     ScopedPointer<CustomAudioDeviceSelectorComponent>  audioDeviceSelector;
     OwnedArray<AnalyserTrackController>                analyserControllers;
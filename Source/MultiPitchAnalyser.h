@@ -0,0 +1,309 @@
+/*
+  ==============================================================================
+
+    MultiPitchAnalyser.h
+    Created: 18 Nov 2016 2:15:37pm
+    Author:  Sean
+
+  ==============================================================================
+*/
+
+#ifndef MULTIPITCHANALYSER_H_INCLUDED
+#define MULTIPITCHANALYSER_H_INCLUDED
+
+/*
+    Estimates several simultaneous fundamentals from a power spectrum by iterative harmonic summation and
+    cancellation (after Klapuri, 2006). A candidate's salience is a weighted sum of the largest magnitude
+    near each of its harmonics. The most salient candidate is taken, its partials are mostly removed from a
+    residual spectrum, and the search repeats on the residual until the next pitch is too weak.
+
+    Candidates are spaced 20 cents apart between the minimum and maximum frequency. The bins each harmonic
+    of each candidate covers, and its weights, are worked out once, up front, and packed into one flat table
+    (as the MelFilterbank does), so a frame's salience is a gather over that table with no per-candidate
+    frequency maths. Each pitch found is refined from the interpolated frequencies of the frame's SpectralPeaks
+    at its partials.
+*/
+class MultiPitchAnalyser
+{
+public:
+    enum { defaultMaxNumPitches = 6, maxMaxNumPitches = 16 };
+
+    MultiPitchAnalyser (int numSamplesPerWindow, double sampleRate = 48000.0)
+    {
+        prepare (numSamplesPerWindow, sampleRate);
+    }
+
+    /* Rebuilds the candidate table. Allocates, so only call this while the analysis thread is stopped. */
+    void prepare (int numSamplesPerWindow, double newSampleRate)
+    {
+        windowSize = numSamplesPerWindow;
+        sampleRate = newSampleRate;
+
+        const int    numMagnitudes = numSamplesPerWindow / 2;
+        const double binWidth      = (sampleRate / 2.0) / (double) numMagnitudes;
+        const double highestPartial = jmin (maxPartialFrequency(), sampleRate / 2.0 - binWidth);
+        const double halfSpacing    = pow (2.0, candidateSpacingCents() / 2400.0);
+
+        numCandidates = jmax (1, (int) floor (1200.0 * log2 (maxFrequency / minFrequency) / candidateSpacingCents()) + 1);
+        candidatePartialOffsets.resize ((size_t) numCandidates + 1);
+        partials.clear();
+
+        for (int candidate = 0; candidate < numCandidates; ++candidate)
+        {
+            const double f0 = getCandidateFrequency ((double) candidate);
+            candidatePartialOffsets[(size_t) candidate] = (int) partials.size();
+
+            for (int harmonic = 1; harmonic <= maxNumHarmonicsPerCandidate && harmonic * f0 <= highestPartial; ++harmonic)
+            {
+                /* every bin within half a candidate spacing of the harmonic, and at least the nearest one */
+                const double h        = (double) harmonic;
+                const int    startBin = jlimit (1, numMagnitudes - 1, roundToInt (h * f0 / halfSpacing / binWidth));
+                const int    endBin   = jlimit (startBin, numMagnitudes - 1, roundToInt (h * f0 * halfSpacing / binWidth));
+
+                partials.push_back ({ startBin, endBin - startBin + 1, (float) ((f0 + weightAlpha()) / (h * f0 + weightBeta())) });
+            }
+        }
+
+        candidatePartialOffsets[(size_t) numCandidates] = (int) partials.size();
+
+        residual.setSize (numMagnitudes);
+        saliences.setSize (numCandidates);
+        frequencies.setSize (maxNumPitches);
+        pitchSaliences.setSize (maxNumPitches);
+        frequencies.clear();
+        pitchSaliences.clear();
+        numPitches = 0;
+    }
+
+    /*
+        Up to newMaxNumPitches pitches are reported, with fundamentals between minFrequency and maxFrequency
+        (in Hz). The analysis thread must be stopped.
+    */
+    void setConfiguration (int newMaxNumPitches, double newMinFrequency, double newMaxFrequency)
+    {
+        jassert (newMaxNumPitches > 0 && newMaxNumPitches <= maxMaxNumPitches);
+        jassert (newMinFrequency > 0.0 && newMinFrequency < newMaxFrequency);
+        maxNumPitches = newMaxNumPitches;
+        minFrequency  = newMinFrequency;
+        maxFrequency  = newMaxFrequency;
+        prepare (windowSize, sampleRate);
+    }
+
+    /*
+        Finds the frame's pitches, strongest first, and returns how many were found. Their frequencies and
+        saliences are then available from getFrequencies() and getSaliences() until the next call. peaks must
+        be the power spectrum's SpectralPeaks.
+    */
+    int estimatePitches (const float* powerSpectrum, int numMagnitudes, const SpectralPeaks& peaks)
+    {
+        jassert (numMagnitudes == windowSize / 2);
+        ignoreUnused (numMagnitudes);
+
+        float* r = residual.getData();
+        float* s = saliences.getData();
+        frequencies.clear();
+        pitchSaliences.clear();
+        numPitches = 0;
+
+        double magnitudeSum = 0.0;
+        for (int bin = 0; bin < numMagnitudes; ++bin)
+        {
+            r[bin] = std::sqrt (powerSpectrum[bin]);
+            magnitudeSum += (double) r[bin];
+        }
+
+        if (magnitudeSum < silenceThreshold())
+            return 0;
+
+        const float inverseMagnitudeSum = (float) (1.0 / magnitudeSum);
+        float strongestSalience = 0.0f;
+
+        while (numPitches < maxNumPitches)
+        {
+            calculateSaliences (r, s);
+
+            /* skip the neighbourhood of each pitch already found, where the residual left by its cancellation lives */
+            for (int pitch = 0; pitch < numPitches; ++pitch)
+            {
+                const int centre = roundToInt (getCandidatePosition (frequencies.getData()[pitch]));
+                for (int c = jmax (0, centre - exclusionRadius()); c <= jmin (numCandidates - 1, centre + exclusionRadius()); ++c)
+                    s[c] = 0.0f;
+            }
+
+            const int best = (int) (std::max_element (s, s + numCandidates) - s);
+            const float salience = s[best] * inverseMagnitudeSum;
+
+            if (salience < minSalience() || salience < strongestSalience * minRelativeSalience())
+                break;
+
+            strongestSalience = jmax (strongestSalience, salience);
+            findPartialPeaks (best, r);
+            frequencies.getData()[numPitches]    = (float) getRefinedFrequency (best, peaks);
+            pitchSaliences.getData()[numPitches] = salience;
+            ++numPitches;
+
+            cancelPartials (r);
+        }
+
+        return numPitches;
+    }
+
+    /* getMaxNumPitches() frequencies in Hz, strongest first, with 0 after the first getNumPitches(). */
+    const float* getFrequencies() const { return frequencies.getData(); }
+
+    /* The share of the frame's magnitude each pitch's weighted harmonics account for, in the same order. */
+    const float* getSaliences()   const { return pitchSaliences.getData(); }
+
+    int    getNumPitches()    const { return numPitches; }
+    int    getMaxNumPitches() const { return maxNumPitches; }
+    double getMinFrequency()  const { return minFrequency; }
+    double getMaxFrequency()  const { return maxFrequency; }
+    int    getNumCandidates() const { return numCandidates; }
+    int    getNumPartials()   const { return (int) partials.size(); }
+
+    /* below about C2 a medium window can't separate neighbouring harmonics */
+    static double defaultMinFrequency() { return 65.0; }
+    static double defaultMaxFrequency() { return 2100.0; }
+
+private:
+    enum { maxNumHarmonicsPerCandidate = 20 };
+
+    struct Partial
+    {
+        int   startBin;
+        int   numBins;
+        float weight;
+    };
+
+    static double candidateSpacingCents() { return 20.0; }
+    static double maxPartialFrequency()   { return 6000.0; }
+
+    /* the harmonic weighting from Klapuri (2006), for windows of about 40 ms */
+    static double weightAlpha()           { return 27.0; }
+    static double weightBeta()            { return 320.0; }
+    static float  cancellationAmount()    { return 0.89f; }
+
+    static int    exclusionRadius()       { return 2; }
+    static float  minSalience()           { return 0.02f; }
+    static float  minRelativeSalience()   { return 0.2f; }
+    static double silenceThreshold()      { return 1.0e-4; }
+    static double maxRefinementRatio()    { return 0.03; }   // about half a semitone
+
+    void calculateSaliences (const float* r, float* s) const noexcept
+    {
+        const Partial* partial = partials.data();
+
+        for (int candidate = 0; candidate < numCandidates; ++candidate)
+        {
+            const Partial* const end = partials.data() + candidatePartialOffsets[(size_t) candidate + 1];
+            float salience = 0.0f;
+
+            for (; partial < end; ++partial)
+            {
+                const float* bins = r + partial->startBin;
+                float largest = bins[0];
+                for (int i = 1; i < partial->numBins; ++i)
+                    largest = jmax (largest, bins[i]);
+
+                salience += partial->weight * largest;
+            }
+
+            s[candidate] = salience;
+        }
+    }
+
+    /* Finds the peak bin, and its magnitude, within each of the candidate's partials. */
+    void findPartialPeaks (int candidate, const float* r) noexcept
+    {
+        const Partial* first = partials.data() + candidatePartialOffsets[(size_t) candidate];
+        numPeaks = candidatePartialOffsets[(size_t) candidate + 1] - candidatePartialOffsets[(size_t) candidate];
+
+        for (int m = 0; m < numPeaks; ++m)
+        {
+            const float* bins = r + first[m].startBin;
+            const int    peak = (int) (std::max_element (bins, bins + first[m].numBins) - bins);
+            peakBins[m] = first[m].startBin + peak;
+            peaks[m]    = bins[peak];
+        }
+    }
+
+    /*
+        The candidate's frequency refined from its partials: the frame's peak at each partial's peak bin gives
+        an interpolated frequency, which is divided by the harmonic number. Those near the candidate are averaged, 
+        weighted by magnitude and harmonic number (the higher the harmonic, the finer its estimate of the fundamental).
+    */
+    double getRefinedFrequency (int candidate, const SpectralPeaks& spectralPeaks) const noexcept
+    {
+        const double f0 = getCandidateFrequency ((double) candidate);
+        double weightedSum = 0.0;
+        double weightSum   = 0.0;
+
+        for (int m = 0; m < numPeaks; ++m)
+        {
+            const SpectralPeaks::Peak* peak = spectralPeaks.findHighestPeakNear ((double) peakBins[m], 1.0);
+            if (peak == nullptr || peak->bin != peakBins[m] || peaks[m] <= 0.0f)
+                continue;
+
+            const double estimate = (double) peak->frequency / (double) (m + 1);
+
+            if (std::abs (estimate / f0 - 1.0) < maxRefinementRatio())
+            {
+                const double weight = (double) peaks[m] * (double) (m + 1);
+                weightedSum += weight * estimate;
+                weightSum   += weight;
+            }
+        }
+
+        return weightSum > 0.0 ? weightedSum / weightSum : f0;
+    }
+
+    /*
+        Scales down the main lobe (the peak bin and its neighbours) of each partial findPartialPeaks() found. A 
+        partial is only removed down to the smoothed level of its neighbours (Klapuri's spectral smoothness), so 
+        one that stands out because another note shares it is left for that note.
+    */
+    void cancelPartials (float* r) const noexcept
+    {
+        const int numMagnitudes = windowSize / 2;
+
+        for (int m = 0; m < numPeaks; ++m)
+        {
+            if (peaks[m] <= 0.0f)
+                continue;
+
+            /* the fundamental has nothing below it to be smoothed against */
+            float smoothed = peaks[m];
+            if (m > 0)
+                smoothed = m + 1 < numPeaks ? (peaks[m - 1] + peaks[m] + peaks[m + 1]) / 3.0f : (peaks[m - 1] + peaks[m]) * 0.5f;
+
+            const float gain = 1.0f - cancellationAmount() * jmin (1.0f, smoothed / peaks[m]);
+
+            for (int bin = jmax (0, peakBins[m] - 1); bin <= jmin (numMagnitudes - 1, peakBins[m] + 1); ++bin)
+                r[bin] *= gain;
+        }
+    }
+
+    double getCandidateFrequency (double candidate) const { return minFrequency * pow (2.0, candidate * candidateSpacingCents() / 1200.0); }
+    double getCandidatePosition (double frequency) const  { return 1200.0 * log2 (frequency / minFrequency) / candidateSpacingCents(); }
+
+    int                  maxNumPitches { defaultMaxNumPitches };
+    double               minFrequency  { defaultMinFrequency() };
+    double               maxFrequency  { defaultMaxFrequency() };
+    int                  windowSize    { 0 };
+    double               sampleRate    { 48000.0 };
+    int                  numCandidates { 0 };
+    int                  numPitches    { 0 };
+    int                  numPeaks      { 0 };
+    int                  peakBins[maxNumHarmonicsPerCandidate];
+    float                peaks[maxNumHarmonicsPerCandidate];
+    std::vector<Partial> partials;
+    std::vector<int>     candidatePartialOffsets;  // candidate c's partials are partials[candidatePartialOffsets[c] .. candidatePartialOffsets[c + 1])
+    AlignedFloatBuffer   residual;
+    AlignedFloatBuffer   saliences;
+    AlignedFloatBuffer   frequencies;
+    AlignedFloatBuffer   pitchSaliences;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (MultiPitchAnalyser)
+};
+
+#endif  // MULTIPITCHANALYSER_H_INCLUDED
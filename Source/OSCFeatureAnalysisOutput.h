@@ -84,8 +84,122 @@ public:
     void timerCallback ()
     {
         sendSpectralFeaturesViaOSC (true);
+
+        if (++timerCallbacksSinceStatusSent >= timerCallbacksPerStatusMessage)
+        {
+            sendCaptureStatusViaOSC();
+            timerCallbacksSinceStatusSent = 0;
+        }
+    }
+
+    /* 
+        Sends the capture health counters of this track to <bundle address>/Status as int32s:
+        samples dropped, overruns, underruns, max fill level (% of ring size), reader wait time (ms), and the
+        % of frames the silence gate skipped.
+    */
+    void sendCaptureStatusViaOSC()
+    {
+        if (captureStatsQueryCallback == nullptr)
+            return;
+
+        const CaptureStats stats = captureStatsQueryCallback();
+        sender.send (bundleAddress + "/Status", 
+                     (int32) jmin (stats.samplesDropped, (int64) std::numeric_limits<int32>::max()), 
+                     (int32) jmin (stats.numOverruns,    (int64) std::numeric_limits<int32>::max()), 
+                     (int32) jmin (stats.numUnderruns,   (int64) std::numeric_limits<int32>::max()), 
+                     (int32) roundToInt (stats.getMaxFillProportion() * 100.0f),
+                     (int32) jmin (stats.readerWaitSeconds * 1000.0, (double) std::numeric_limits<int32>::max()),
+                     (int32) roundToInt (stats.getGatedProportion() * 100.0f));
+    }
+
+    /*
+        Sends the sample positions the current feature values were measured at to <bundle address>/Time,
+        so receivers can align features from different tracks and measure the output latency:
+        spectral frame, harmonic frame, capture position now. OSC has no 64 bit int argument in JUCE, so
+        each position is sent as two int32s (high word, then low word).
+    */
+    void sendFrameTimesViaOSC()
+    {
+        const int64 spectralFramePosition = realTimeAudioFeatures.getSamplePosition (AudioFeatures::eAudioFeature::enCentroid);
+        const int64 harmonicFramePosition = realTimeAudioFeatures.getSamplePosition (AudioFeatures::eAudioFeature::enHarmonicEnergyRatio);
+        const int64 capturePosition       = capturePositionQueryCallback != nullptr ? capturePositionQueryCallback() : -1;
+
+        sender.send (bundleAddress + "/Time",
+                     getHighWord (spectralFramePosition), getLowWord (spectralFramePosition),
+                     getHighWord (harmonicFramePosition), getLowWord (harmonicFramePosition),
+                     getHighWord (capturePosition),       getLowWord (capturePosition));
     }
 
+    /*
+        Sends the extended spectral descriptors to <bundle address>/Timbre (rolloff 85%, rolloff 95%, crest, 
+        skewness, kurtosis, decrease, contrast, entropy) and the contrast of each octave band, lowest first, 
+        to <bundle address>/Contrast. Kept out of the main bundle so existing receivers see the same layout.
+    */
+    void sendExtendedFeaturesViaOSC()
+    {
+        sender.send (bundleAddress + "/Timbre",
+                     getAudioFeature (AudioFeatures::eAudioFeature::enRolloff85),
+                     getAudioFeature (AudioFeatures::eAudioFeature::enRolloff95),
+                     getAudioFeature (AudioFeatures::eAudioFeature::enCrest),
+                     getAudioFeature (AudioFeatures::eAudioFeature::enSkewness),
+                     getAudioFeature (AudioFeatures::eAudioFeature::enKurtosis),
+                     getAudioFeature (AudioFeatures::eAudioFeature::enDecrease),
+                     getAudioFeature (AudioFeatures::eAudioFeature::enContrast),
+                     getAudioFeature (AudioFeatures::eAudioFeature::enEntropy));
+
+        sendVectorFeatureViaOSC (AudioFeatures::eVectorFeature::enContrastBands);
+    }
+
+    /*
+        Sends the tracked pitch to <bundle address>/Pitch: pitch (normalised as in the main bundle), voicing 
+        confidence, and the sample position of the frame they were decided for as two int32s. That frame lags 
+        the harmonic frame in /Time by the track's pitch tracking lag.
+    */
+    void sendPitchViaOSC()
+    {
+        const int64 pitchFramePosition = realTimeAudioFeatures.getSamplePosition (AudioFeatures::eAudioFeature::enF0);
+
+        sender.send (bundleAddress + "/Pitch",
+                     getAudioFeature (AudioFeatures::eAudioFeature::enF0),
+                     getAudioFeature (AudioFeatures::eAudioFeature::enPitchConfidence),
+                     getHighWord (pitchFramePosition), getLowWord (pitchFramePosition));
+    }
+
+    /* Sends the MFCCs, coefficient 0 first, as floats to <bundle address>/MFCC. */
+    void sendMFCCsViaOSC()
+    {
+        sendVectorFeatureViaOSC (AudioFeatures::eVectorFeature::enMFCCs);
+    }
+
+    /* Sends the chromagram, starting from A, as floats to <bundle address>/Chroma. */
+    void sendChromaViaOSC()
+    {
+        sendVectorFeatureViaOSC (AudioFeatures::eVectorFeature::enChroma);
+    }
+
+    /* Sends each simultaneous pitch, strongest first, as a (pitch, salience) pair of floats to <bundle address>/Pitches. */
+    void sendMultiPitchViaOSC()
+    {
+        sendVectorFeatureViaOSC (AudioFeatures::eVectorFeature::enPitches);
+    }
+
+    /* Sends every value of a vector feature as a float in one message to <bundle address>/<feature name>. */
+    void sendVectorFeatureViaOSC (AudioFeatures::eVectorFeature featureType)
+    {
+        OSCMessage message (bundleAddress + "/" + AudioFeatures::getVectorFeatureName (featureType));
+
+        for (int i = 0; i < realTimeAudioFeatures.getVectorFeatureSize (featureType); ++i)
+            message.addFloat32 (realTimeAudioFeatures.getVectorFeatureValue (featureType, i));
+
+        sender.send (message);
+    }
+
+    static int32 getHighWord (int64 position) noexcept { return (int32) (position >> 32); }
+    static int32 getLowWord  (int64 position) noexcept { return (int32) (uint32) (position & 0xffffffff); }
+
+    void setCaptureStatsQueryCallback    (std::function<CaptureStats()> f) { captureStatsQueryCallback = f; }
+    void setCapturePositionQueryCallback (std::function<int64()> f)        { capturePositionQueryCallback = f; }
+
     void sendSpectralFeaturesViaOSC (bool updateHarmonicFeatures)
     {
         float rmsLevel = getAudioFeature (AudioFeatures::eAudioFeature::enRMS);
@@ -105,6 +219,12 @@ public:
             //DBG("F0 estimation: "<<f0<<" |her: "<<her<<" |inharm: "<<inharm);
             //sender.send (bundleAddress, onset, rmsLevel, centroid, flatness, spread, slope, f0, her, inharm);
             sender.send (bundleAddress, onset, rmsLevel, f0, centroid, slope, spread, flatness, ler, flux, her, oer, inharm);
+            sendFrameTimesViaOSC();
+            sendPitchViaOSC();
+            sendExtendedFeaturesViaOSC();
+            sendMFCCsViaOSC();
+            sendChromaViaOSC();
+            sendMultiPitchViaOSC();
         }
         else
         {
@@ -138,6 +258,10 @@ public:
     float getAudioFeature      (AudioFeatures::eAudioFeature featureType) const { return realTimeAudioFeatures.getValue (featureType); }
 
     AudioFeatures& realTimeAudioFeatures;
+    std::function<CaptureStats()> captureStatsQueryCallback;
+    std::function<int64()>        capturePositionQueryCallback;
+    int                       timerCallbacksSinceStatusSent { 0 };
+    const int                 timerCallbacksPerStatusMessage { 60 };
     OSCSender                 sender;
     std::vector<ValueHistory> featureHistories;
     String                    address;
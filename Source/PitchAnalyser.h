@@ -14,210 +14,715 @@
 //============================================================================================================================================================
 //============================================================================================================================================================
 
+/*
+    Every intermediate array a YIN pitch estimate needs, in aligned memory. Sized once per window size so 
+    estimating doesn't allocate. The autocorrelation array holds numFFTElements (2 * window size) floats, 
+    the layout the FFT backends transform in place; the cumulative difference holds one value per lag.
+*/
+class YINWorkspace
+{
+public:
+    YINWorkspace (int windowSize = 0) { setWindowSize (windowSize); }
+
+    /* Allocates, so only call this while nothing is estimating pitch. */
+    void setWindowSize (int windowSize)
+    {
+        numFFTElements = windowSize * 2;
+        autoCorrelation.setSize (numFFTElements);
+        cumulativeDifference.setSize (windowSize);
+    }
+
+    int getNumFFTElements() const { return numFFTElements; }
+
+    AlignedFloatBuffer autoCorrelation;
+    AlignedFloatBuffer cumulativeDifference;
+
+private:
+    int numFFTElements { 0 };
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (YINWorkspace)
+};
+
+//============================================================================================================================================================
+//============================================================================================================================================================
+
+/*
+    The dips in one frame's cumulative difference that YIN could pick, as candidate fundamentals, each with the
+    probability that it is the pitch. The probabilities sum to at most 1, the remainder being the chance the frame is unvoiced.
+*/
+struct PitchCandidates
+{
+    enum { maxNumCandidates = 32 };
+
+    void clear() noexcept { numCandidates = 0; }
+
+    void add (float frequency, float probability) noexcept
+    {
+        jassert (numCandidates < maxNumCandidates);
+        frequencies[numCandidates]   = frequency;
+        probabilities[numCandidates] = probability;
+        ++numCandidates;
+    }
+
+    float getVoicedProbability() const noexcept
+    {
+        float sum = 0.0f;
+        for (int i = 0; i < numCandidates; ++i)
+            sum += probabilities[i];
+        return jmin (1.0f, sum);
+    }
+
+    float frequencies[maxNumCandidates];
+    float probabilities[maxNumCandidates];
+    int   numCandidates { 0 };
+};
+
+//============================================================================================================================================================
+//============================================================================================================================================================
+
+/*
+    YIN pitch estimation. The autocorrelation is the inverse real FFT of the window's power spectrum, and the 
+    cumulative mean normalised difference and its threshold search only cover the lags that the configured 
+    pitch range allows (and that fit in half a window). As well as the single YIN estimate, it can list the 
+    dips in the difference as weighted candidates, as pYIN does, for a PitchTracker to choose between.
+*/
 class PitchAnalyser
 {
 public:
+    enum { numThresholds = 100 };
+
     PitchAnalyser (FFTAnalyser& ffT) 
     :   fft (ffT)
-    {}
+    {
+        setWindowSize (fft.getFFTExpectedSamples());
+        fillThresholdDistribution();
+    }
+
+    /* 
+        Resizes the workspace and display buffers, and forgets the analysis window (so call setAnalysisWindow() 
+        again). Only call this while the analysis thread is stopped.
+    */
+    void setWindowSize (int windowSize)
+    {
+        workspace.setWindowSize (windowSize);
+        autoCorrelationBufferToDraw.setSize (1, windowSize);
+        cumulativeDifferenceBufferToDraw.setSize (1, windowSize);
+        windowCorrection.setSize (windowSize / 2 + 1);
+        FloatVectorOperations::fill (windowCorrection.getData(), 1.0f, windowCorrection.getSize());
+        updateLagRange();
+    }
+
+    /*
+        The window the audio was multiplied by before its spectrum was taken. The window's own autocorrelation 
+        is divided back out of the audio's (Boersma's correction); otherwise the window's taper makes the dips 
+        at long lags shallower, and the tracker's candidates favour the octave above. Allocates, so only call 
+        this while the analysis thread is stopped.
+    */
+    void setAnalysisWindow (const WindowTable& window)
+    {
+        const int numFFTElements = workspace.getNumFFTElements();
+        const int windowSize     = numFFTElements / 2;
+        jassert (window.getSize() == windowSize);
+
+        float* data = workspace.autoCorrelation.getData();
+        FloatVectorOperations::copy  (data, window.getData(), windowSize);
+        FloatVectorOperations::clear (data + windowSize, windowSize);
+        fft.getFFTObject().performForward (data, numFFTElements);
+
+        for (int bin = 0; bin < windowSize; ++bin)
+        {
+            data[bin * 2]     = data[bin * 2] * data[bin * 2] + data[bin * 2 + 1] * data[bin * 2 + 1];
+            data[bin * 2 + 1] = 0.0f;
+        }
+
+        fft.getFFTObject().performInverse (data, numFFTElements);
+
+        float* correction = windowCorrection.getData();
+        for (int lag = 0; lag < windowCorrection.getSize(); ++lag)
+            correction[lag] = data[lag] > 0.0f ? data[0] / data[lag] : 0.0f;
+    }
+
+    /* 
+        Limits the search to fundamentals between minFrequency and maxFrequency (in Hz). Call this while the 
+        analysis thread is stopped, and again if the FFT's nyquist changes.
+    */
+    void setPitchRange (double minFrequency, double maxFrequency)
+    {
+        jassert (minFrequency > 0.0 && minFrequency < maxFrequency);
+        minPitch = minFrequency;
+        maxPitch = maxFrequency;
+        updateLagRange();
+    }
+
+    double getMinPitch() const { return minPitch; }
+    double getMaxPitch() const { return maxPitch; }
 
     double estimatePitch (AudioSampleBuffer& frequencyData)
     {
-        AudioSampleBuffer conjugateMultiplication = getComplexConjugateMultiplication (frequencyData);
-        
-        AudioSampleBuffer autoCorrelationBuffer   = getAutoCorrelationFromConjugateMultiplication (conjugateMultiplication);
+        return estimatePitch (frequencyData.getReadPointer (0), frequencyData.getNumSamples());
+    }
+
+    /* frequencyData holds numFFTElements floats of interleaved complex bins. Doesn't allocate. */
+    double estimatePitch (const float* frequencyData, int numFFTElements)
+    {
+        jassert (numFFTElements == workspace.getNumFFTElements());
+
+        float* autoCorrelation      = workspace.autoCorrelation.getData();
+        float* cumulativeDifference = workspace.cumulativeDifference.getData();
+
+        getPowerSpectrum (frequencyData, autoCorrelation, numFFTElements / 2);
+        fft.getFFTObject().performInverse (autoCorrelation, numFFTElements);
 
         if (autoCorrelationDisplayBufferNeedsUpdating.get() == 1)
         {
-            AudioSampleBuffer dataToDraw (autoCorrelationBuffer.getNumChannels(), autoCorrelationBuffer.getNumSamples() / 2);
-            dataToDraw.clear();
-
-            for (int ch = 0; ch < dataToDraw.getNumChannels(); ++ch)
-                dataToDraw.copyFrom (ch, 0, autoCorrelationBuffer, ch, 0, autoCorrelationBuffer.getNumSamples() / 2);
-            
-            autoCorrelationBufferToDraw = AudioSampleBuffer (dataToDraw);
+            autoCorrelationBufferToDraw.getWriteBuffer().copyFrom (0, 0, autoCorrelation, numFFTElements / 2);
+            autoCorrelationBufferToDraw.publish();
             autoCorrelationDisplayBufferNeedsUpdating.set (0);
         }
 
-        AudioSampleBuffer cumulativeNormalisedDifferenceBuffer = getCumulativeNormalisedDifferenceFromAutoCorrelationBuffer (autoCorrelationBuffer);
+        getCumulativeNormalisedDifference (autoCorrelation, windowCorrection.getData(), cumulativeDifference, minLag - 1, maxLag + 1);
 
         if (cumulativeDifferenceBufferNeedsUpdating.get() == 1)
         { 
-            AudioSampleBuffer dataToDraw (cumulativeNormalisedDifferenceBuffer.getNumChannels(), cumulativeNormalisedDifferenceBuffer.getNumSamples() / 2);
-            dataToDraw.clear();
-
-            for (int ch = 0; ch < dataToDraw.getNumChannels(); ++ch)
-                dataToDraw.copyFrom (ch, 0, cumulativeNormalisedDifferenceBuffer, ch, 0, cumulativeNormalisedDifferenceBuffer.getNumSamples() / 2);
-            
-            cumulativeDifferenceBufferToDraw = AudioSampleBuffer (dataToDraw);
+            cumulativeDifferenceBufferToDraw.getWriteBuffer().copyFrom (0, 0, cumulativeDifference, numFFTElements / 2);
+            cumulativeDifferenceBufferToDraw.publish();
             cumulativeDifferenceBufferNeedsUpdating.set (0);
         }
 
-        const float lagEstimate = getLagEstimateFromCumulativeDifference (cumulativeNormalisedDifferenceBuffer, 0);
+        const float lagEstimate = getLagEstimateFromCumulativeDifference (cumulativeDifference, numFFTElements);
         const double pitchEstimate = (fft.getNyquist() * 2.0f) / lagEstimate;
         return pitchEstimate;
     }
 
+    /*
+        Lists the dips in the last estimate's cumulative difference that are deeper than every dip before them. 
+        Each is weighted by the prior probability of the thresholds for which plain YIN would have picked it (the 
+        first dip below the threshold), and the deepest gets a small share of the thresholds no dip reaches. Call 
+        after estimatePitch(). Doesn't allocate.
+    */
+    const PitchCandidates& findPitchCandidates()
+    {
+        const float* cndData    = workspace.cumulativeDifference.getData();
+        const double sampleRate = fft.getNyquist() * 2.0;
+
+        candidates.clear();
+        float lowestDip = std::numeric_limits<float>::max();
+
+        for (int lag = minLag; lag <= maxLag && candidates.numCandidates < PitchCandidates::maxNumCandidates; ++lag)
+        {
+            const float value = cndData[lag];
+
+            /* a dip no lower than an earlier one is never the first below any threshold, so it can't be a candidate */
+            if (! (value < lowestDip && value < cndData[lag - 1] && value <= cndData[lag + 1]))
+                continue;
+
+            const float probability = getThresholdProbability (lowestDip) - getThresholdProbability (value);
+            candidates.add ((float) (sampleRate / getInterpolatedValley (lag, cndData).getX()), probability);
+            lowestDip = value;
+        }
+
+        /* the deepest dip is the last one listed */
+        if (candidates.numCandidates > 0)
+            candidates.probabilities[candidates.numCandidates - 1] += absoluteMinimumWeight() * getThresholdProbability (lowestDip);
+
+        return candidates;
+    }
+
     int getFFTExpectedSamples() const 
     {
         return fft.getFFTExpectedSamples();
     }
 
     void enableAutoCorrelationBufferToDrawNeedsUpdating()     { autoCorrelationDisplayBufferNeedsUpdating.set (1); }
-    const AudioSampleBuffer getAutoCorrelationBufferToDraw()  { return AudioSampleBuffer (autoCorrelationBufferToDraw); }
+
+    /* Message thread only: the autocorrelation last requested by enableAutoCorrelationBufferToDrawNeedsUpdating(). */
+    const AudioSampleBuffer& getAutoCorrelationBufferToDraw() { return autoCorrelationBufferToDraw.getLatest(); }
 
     void enableCumulativeDifferenceBufferNeedsUpdating() { cumulativeDifferenceBufferNeedsUpdating.set (1); }
-    const AudioSampleBuffer getCumulativeDifferenceBufferToDraw() { return AudioSampleBuffer (cumulativeDifferenceBufferToDraw); }
+
+    /* Message thread only: the cumulative difference last requested by enableCumulativeDifferenceBufferNeedsUpdating(). */
+    const AudioSampleBuffer& getCumulativeDifferenceBufferToDraw() { return cumulativeDifferenceBufferToDraw.getLatest(); }
 
     Point<float> getNormalisedLagPosition() { return normalisedLagPosition; }
 
+    static double defaultMinPitch() { return 50.0; }
+    static double defaultMaxPitch() { return 2000.0; }
+
 private:
-    AudioSampleBuffer autoCorrelationBufferToDraw;
-    AudioSampleBuffer cumulativeDifferenceBufferToDraw;
-    FFTAnalyser&      fft;       
-    Point<float>      normalisedLagPosition { 0.0f, 0.0f };
+    YINWorkspace         workspace;
+    AlignedFloatBuffer   windowCorrection;  // r_w(0) / r_w(t), the window's autocorrelation inverted, for lags up to half the window
+    SnapshotTripleBuffer autoCorrelationBufferToDraw;
+    SnapshotTripleBuffer cumulativeDifferenceBufferToDraw;
+    FFTAnalyser&         fft;       
+    Point<float>         normalisedLagPosition { 0.0f, 0.0f };
+    double               minPitch { defaultMinPitch() };
+    double               maxPitch { defaultMaxPitch() };
+    int                  minLag   { 2 };
+    int                  maxLag   { 2 };
     
-    Atomic<int>       autoCorrelationDisplayBufferNeedsUpdating;
-    Atomic<int>       cumulativeDifferenceBufferNeedsUpdating;
+    Atomic<int>          autoCorrelationDisplayBufferNeedsUpdating;
+    Atomic<int>          cumulativeDifferenceBufferNeedsUpdating;
+
+    PitchCandidates      candidates;
+    float                thresholdDistribution[numThresholds + 1];  // [i]: the probability that the threshold is at most i / numThresholds
+
+    /* the YIN paper's absolute threshold */
+    static float threshold() { return 0.1f; }
 
-    AudioSampleBuffer getComplexConjugateMultiplication (AudioSampleBuffer& frequencyData)
+    /* pYIN's threshold prior: a beta distribution with mean 0.15 over thresholds 0.01 to 1 */
+    static double thresholdPriorAlpha()   { return 2.0; }
+    static double thresholdPriorBeta()    { return 34.0 / 3.0; }
+    static float  absoluteMinimumWeight() { return 0.01f; }
+
+    void fillThresholdDistribution()
     {
-        const int numChannels = frequencyData.getNumChannels();
-        const int numSamples  = frequencyData.getNumSamples();
-        AudioSampleBuffer conjugateMultiplicationBuffer (frequencyData);
-        conjugateMultiplicationBuffer.clear();
+        double total = 0.0;
+        thresholdDistribution[0] = 0.0f;
 
-        jassert (numSamples % 2 == 0);
-        
-        for (int c = 0; c < numChannels; c++)
+        for (int i = 1; i <= numThresholds; ++i)
         {
-            const float* complexData           = frequencyData.getReadPointer (c);
-            float* conjugateMultiplicationData = conjugateMultiplicationBuffer.getWritePointer (c);
-
-            for (int magnitudeIndex = 0; magnitudeIndex < numSamples; magnitudeIndex += 2)
-            {
-                const int phaseIndex  = magnitudeIndex + 1;
-                const float magnitude = complexData[magnitudeIndex];
-                const float phase     = complexData[phaseIndex];
-                conjugateMultiplicationData[magnitudeIndex] = magnitude * magnitude;
-                conjugateMultiplicationData[phaseIndex]     = 0.0f;
-            }
+            const double t = (double) i / (double) numThresholds;
+            total += pow (t, thresholdPriorAlpha() - 1.0) * pow (1.0 - t, thresholdPriorBeta() - 1.0);
+            thresholdDistribution[i] = (float) total;
         }
 
-        return conjugateMultiplicationBuffer;
+        for (int i = 1; i <= numThresholds; ++i)
+            thresholdDistribution[i] /= (float) total;
+    }
+
+    /* The prior probability that the threshold is at or below value. */
+    float getThresholdProbability (float value) const noexcept
+    {
+        return thresholdDistribution[(int) (jlimit (0.0f, 1.0f, value) * (float) numThresholds)];
     }
 
-    AudioSampleBuffer getAutoCorrelationFromConjugateMultiplication (AudioSampleBuffer& conjugateMultiplicationBuffer)
+    void updateLagRange()
     {
-        const int numChannels = conjugateMultiplicationBuffer.getNumChannels();
-        const int numSamples  = conjugateMultiplicationBuffer.getNumSamples();
+        const int    windowSize = workspace.getNumFFTElements() / 2;
+        const double sampleRate = fft.getNyquist() * 2.0;
 
-        AudioSampleBuffer autoCorrelationBuffer (conjugateMultiplicationBuffer);
+        /* the circular autocorrelation is only meaningful up to half the window, and the interpolation needs a lag either side */
+        maxLag = jlimit (3, jmax (3, windowSize / 2 - 1), (int) ceil (sampleRate / minPitch));
+        minLag = jlimit (2, maxLag, (int) floor (sampleRate / maxPitch));
 
-        for (int c = 0; c < numChannels; c++)
+        /* lags outside the range are never written, so they read as aperiodic on the display */
+        FloatVectorOperations::fill (workspace.cumulativeDifference.getData(), 1.0f, workspace.cumulativeDifference.getSize());
+    }
+
+    /* 
+        Writes |X[k]|^2 over the numBins interleaved complex bins as a real, even spectrum (zero imaginary parts, 
+        mirrored above nyquist), ready for the real inverse transform to turn into the autocorrelation.
+    */
+    static void getPowerSpectrum (const float* __restrict complexData, float* __restrict powerData, int numBins) noexcept
+    {
+        const int halfNumBins = numBins / 2;
+
+        for (int bin = 0; bin <= halfNumBins; ++bin)
         {
-            float* inOutData = autoCorrelationBuffer.getWritePointer (c);
-            fft.getFFTObject().performInverse (inOutData, numSamples);
+            const float re = complexData[bin * 2];
+            const float im = complexData[bin * 2 + 1];
+            powerData[bin * 2]     = re * re + im * im;
+            powerData[bin * 2 + 1] = 0.0f;
+        }
 
-            for (int sample = 0; sample < numSamples; sample++)
-                inOutData[sample] = inOutData[sample] * inOutData[sample] * sample;
+        for (int bin = halfNumBins + 1; bin < numBins; ++bin)
+        {
+            powerData[bin * 2]     = powerData[(numBins - bin) * 2];
+            powerData[bin * 2 + 1] = 0.0f;
         }
+    }
+
+    /* 
+        The difference d(t) = 2 (r(0) - r(t)), with r corrected for the window, normalised by its running mean, 
+        for lags firstLag to lastLag. The running sum still has to start at lag 1, but below firstLag that's all 
+        it does.
+    */
+    static void getCumulativeNormalisedDifference (const float* autoCorrelationData, const float* windowCorrectionData, 
+                                                   float* cumulativeDiffData, int firstLag, int lastLag) noexcept
+    {
+        const float energy = autoCorrelationData[0];
+        float sum = 0.0f;
 
-        return autoCorrelationBuffer;
+        for (int lag = 1; lag < firstLag; ++lag)
+            sum += 2.0f * (energy - autoCorrelationData[lag] * windowCorrectionData[lag]);
+
+        for (int lag = firstLag; lag <= lastLag; ++lag)
+        {
+            const float difference = 2.0f * (energy - autoCorrelationData[lag] * windowCorrectionData[lag]);
+            sum += difference;
+            cumulativeDiffData[lag] = sum > 0.0f ? difference * (float) lag / sum : 1.0f;
+        }
     }
-    
-    AudioSampleBuffer getCumulativeNormalisedDifferenceFromAutoCorrelationBuffer (AudioSampleBuffer& autoCorrelationBuffer)
+
+    /* Returns the first dip below the threshold within [minLag, maxLag], or the deepest one if none gets that low. */
+    float getLagEstimateFromCumulativeDifference (const float* cndData, int numCNDSamples)
     {
-        const int numChannels = autoCorrelationBuffer.getNumChannels();
-        const int numSamples  = autoCorrelationBuffer.getNumSamples();
-        AudioSampleBuffer cumulativeNormalisedDifferenceBuffer (autoCorrelationBuffer);
-        cumulativeNormalisedDifferenceBuffer.clear();
+        int   lagEstimate = minLag;
+        float globalMin   = cndData[minLag];
 
-        for (int channel = 0; channel < numChannels; channel++)
+        for (int lag = minLag; lag <= maxLag; ++lag)
         {
-            float sum = 0.0f;
-            const float* autoCorrelationData = autoCorrelationBuffer.getReadPointer (channel);
-            float* cumulativeDiffData = cumulativeNormalisedDifferenceBuffer.getWritePointer (channel);
-            cumulativeDiffData[0] = 1.0f;
-            for (int sample = 1; sample < numSamples; sample++)
+            if (cndData[lag] < threshold())
             {
-                const float value = autoCorrelationData[sample];
-                sum += value;
-                if (sum != 0.0f)
-                {
-                    const auto norm = (1.0f / sample) * sum;
-                    cumulativeDiffData[sample] = value / sum;
-                }
-                else
-                {
-                    cumulativeDiffData[sample] = 0.0f;
-                }
+                while (lag + 1 <= maxLag && cndData[lag + 1] < cndData[lag])
+                    ++lag;
+
+                lagEstimate = lag;
+                break;
+            }
+
+            if (cndData[lag] < globalMin)
+            {
+                lagEstimate = lag;
+                globalMin   = cndData[lag];
             }
         }
 
-        return cumulativeNormalisedDifferenceBuffer;
+        const Point<float> valley = getInterpolatedValley (lagEstimate, cndData);
+        normalisedLagPosition = Point<float> (valley.getX() / numCNDSamples, valley.getY());
+        return valley.getX();
+    }
+
+    /* Parabolic interpolation through the lag and its neighbours, which are always within the computed range. */
+    static Point<float> getInterpolatedValley (int lag, const float* cndData)
+    {
+        const float leftSample  = cndData[lag - 1];
+        const float sample      = cndData[lag];
+        const float rightSample = cndData[lag + 1];
+        const float curvature   = leftSample - 2.0f * sample + rightSample;
+
+        if (curvature <= 0.0f)
+            return Point<float> ((float) lag, sample);
+
+        const float offset = jlimit (-0.5f, 0.5f, 0.5f * (leftSample - rightSample) / curvature);
+        return Point<float> ((float) lag + offset, sample - 0.25f * (leftSample - rightSample) * offset);
+    }
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (PitchAnalyser)
+};
+
+//============================================================================================================================================================
+//============================================================================================================================================================
+
+/* One frame's decision from a PitchTracker. */
+struct PitchTrack
+{
+    double frequency       { 0.0 };    // the decoded pitch of the frame at samplePosition, in Hz
+    float  confidence      { 0.0f };   // the probability that frame is voiced
+    bool   isVoiced        { false };  // whether the decoded path is in a voiced state there
+    int64  samplePosition  { -1 };     // the frame the decision is for: the latest one, or decodingLag frames before it
+    double latestFrequency { 0.0 };    // the pitch at the end of the best path, i.e. of the latest frame
+    bool   latestIsVoiced  { false };  // whether the end of the best path is in a voiced state
+};
+
+//============================================================================================================================================================
+//============================================================================================================================================================
+
+/*
+    Tracks pitch across frames pYIN style, with a hidden Markov model over pitch bins (60 per octave, across 
+    the configured range) that are each either voiced or unvoiced. A frame's PitchCandidates give the voiced 
+    bins their observations, and what they leave unexplained is spread over the unvoiced ones. Pitch may move 
+    a few bins per frame, with triangular weights, and voicing rarely switches.
+
+    Decoding is online Viterbi with a bounded lookback. The best path probabilities of the last maxLookback
+    frames are kept in a ring, and the decision for a frame is taken decodingLag frames after it, by tracing 
+    back from the best state now. Each step back works out that state's predecessor from the ring, so no back 
+    pointers are stored for the states that are never traced. A lag of 0 (the default) reports the end of the 
+    best path with no added latency; longer lags let later frames correct octave errors. Every table is sized 
+    by setPitchRange(), so tracking doesn't allocate.
+*/
+class PitchTracker
+{
+public:
+    enum { maxLookback = 8, binsPerOctave = 60, maxTransitionBins = 12 };
+
+    PitchTracker (double minFrequency = PitchAnalyser::defaultMinPitch(), double maxFrequency = PitchAnalyser::defaultMaxPitch())
+    {
+        fillTransitionWeights();
+        setPitchRange (minFrequency, maxFrequency);
     }
 
-    float getLagEstimateFromCumulativeDifference (AudioSampleBuffer& cndBuffer, int channel, float threshold = 0.01f)
+    /* Allocates, so only call this while the analysis thread is stopped. */
+    void setPitchRange (double minFrequency, double maxFrequency)
     {
-        const int numSamples           = cndBuffer.getNumSamples() / 2;
-        const float* cndData           = cndBuffer.getReadPointer (channel);
-        float globalMinIndex           = -1.0f;
-        float globalMin                = 100.0f;
+        jassert (minFrequency > 0.0 && minFrequency < maxFrequency);
+        minPitch     = minFrequency;
+        numPitchBins = (int) floor (log2 (maxFrequency / minFrequency) * (double) binsPerOctave) + 1;
+        numStates    = numPitchBins * 2;
+
+        pathHistory.setSize (maxLookback * numStates);
+        observations.setSize (numStates);
+        bestVoicedSources.setSize (numPitchBins);
+        bestUnvoicedSources.setSize (numPitchBins);
+        reset();
+    }
 
-        Point<float> interpolatedLagWithMinimumValue (-1.0f, 100.0f);
-        for (int sample = 2; sample < numSamples; sample++)
+    /* How many frames a decision waits for, from 0 to maxLookback - 1. The analysis thread must be stopped. */
+    void setDecodingLag (int numFrames)
+    {
+        decodingLag = jlimit (0, (int) maxLookback - 1, numFrames);
+    }
+
+    int getDecodingLag() const { return decodingLag; }
+
+    /* Forgets the path so far. The analysis thread must be stopped. */
+    void reset()
+    {
+        numFramesTracked  = 0;
+        numUnvoicedFrames = 0;
+    }
+
+    PitchTrack processFrame (const PitchCandidates& frameCandidates, int64 samplePosition)
+    {
+        const int   slot              = (int) (numFramesTracked % maxLookback);
+        const float voicedProbability = frameCandidates.getVoicedProbability();
+
+        fillObservations (frameCandidates, voicedProbability * yinTrust());
+        stepViterbi (slot);
+
+        /* the confidence is a forward pass over just voiced / unvoiced, taking the candidates' total as the frame's evidence */
+        const float previousVoiced = numFramesTracked > 0 ? voicedProbabilities[getPreviousSlot (slot)] : 0.5f;
+        const float voicedPrior    = previousVoiced * confidenceStayProbability() + (1.0f - previousVoiced) * (1.0f - confidenceStayProbability());
+        const float voiced         = voicedPrior * voicedProbability;
+        const float unvoiced       = (1.0f - voicedPrior) * (1.0f - voicedProbability);
+
+        voicedProbabilities[slot] = voiced + unvoiced > 0.0f ? voiced / (voiced + unvoiced) : 0.0f;
+        samplePositions[slot]     = samplePosition;
+        candidateHistory[slot]    = frameCandidates;
+
+        /* trace back from the best state now to the frame being decided */
+        const float* path        = getPath (slot);
+        const int    latestState = (int) (std::max_element (path, path + numStates) - path);
+        const int    lag         = (int) jmin ((int64) decodingLag, numFramesTracked);
+
+        int state       = latestState;
+        int decidedSlot = slot;
+        for (int frame = 0; frame < lag; ++frame)
         {
-            if (cndData[sample] < globalMin)
+            decidedSlot = getPreviousSlot (decidedSlot);
+            state       = getPredecessor (state, getPath (decidedSlot));
+        }
+
+        ++numFramesTracked;
+        numUnvoicedFrames = latestState < numPitchBins ? 0 : numUnvoicedFrames + 1;
+
+        PitchTrack track;
+        track.frequency       = getStateFrequency (state, candidateHistory[decidedSlot], numUnvoicedFrames - lag);
+        track.confidence      = voicedProbabilities[decidedSlot];
+        track.isVoiced        = state < numPitchBins;
+        track.samplePosition  = samplePositions[decidedSlot];
+        track.latestFrequency = getStateFrequency (latestState, candidateHistory[slot], numUnvoicedFrames);
+        track.latestIsVoiced  = latestState < numPitchBins;
+        return track;
+    }
+
+    int getNumStates() const { return numStates; }
+
+private:
+    /* pYIN's defaults */
+    static float yinTrust()                  { return 0.5f; }
+    static float voicingStayProbability()    { return 0.99f; }
+
+    static float confidenceStayProbability() { return 0.9f; }      // lets the confidence recover within a few frames
+    static float negligibleProbability()     { return 1.0e-20f; }  // relative to the best path
+
+    float*       getPath (int slot)       noexcept { return pathHistory.getData() + slot * numStates; }
+    static int   getPreviousSlot (int slot) noexcept { return (slot + maxLookback - 1) % maxLookback; }
+
+    /* Voiced states 0 to numPitchBins - 1, then the unvoiced state for each bin. */
+    void fillObservations (const PitchCandidates& frameCandidates, float voicedPortion)
+    {
+        float* observation = observations.getData();
+        FloatVectorOperations::clear (observation, numPitchBins);
+        FloatVectorOperations::fill  (observation + numPitchBins, (1.0f - voicedPortion) / (float) numPitchBins, numPitchBins);
+
+        for (int i = 0; i < frameCandidates.numCandidates; ++i)
+        {
+            const int bin = getBinForFrequency (frameCandidates.frequencies[i]);
+
+            if (bin >= 0)
+                observation[bin] += frameCandidates.probabilities[i] * yinTrust();
+        }
+    }
+
+    /* 
+        Extends every state's best path by one frame into the slot. The transition weights only depend on the bin
+        offset, so the best voiced and the best unvoiced path into each bin are found one offset at a time across 
+        all the bins, in loops the compiler can vectorise. The voicing stay / change probabilities then choose 
+        between the two.
+    */
+    void stepViterbi (int slot)
+    {
+        const float* observation = observations.getData();
+        float*       path        = getPath (slot);
+
+        if (numFramesTracked == 0)
+        {
+            FloatVectorOperations::copy (path, observation, numStates);
+        }
+        else
+        {
+            const float* previousPath = getPath (getPreviousSlot (slot));
+            float*       voiced       = bestVoicedSources.getData();
+            float*       unvoiced     = bestUnvoicedSources.getData();
+
+            findBestSources (previousPath,                voiced);
+            findBestSources (previousPath + numPitchBins, unvoiced);
+
+            const float stay   = voicingStayProbability();
+            const float change = 1.0f - stay;
+
+            for (int bin = 0; bin < numPitchBins; ++bin)
             {
-                globalMinIndex = (float) sample;
-                globalMin = cndData[sample];
+                const float toVoiced   = jmax (voiced[bin]   * stay, unvoiced[bin] * change);
+                const float toUnvoiced = jmax (unvoiced[bin] * stay, voiced[bin]   * change);
+                path[bin]                = toVoiced   * observation[bin];
+                path[bin + numPitchBins] = toUnvoiced * observation[bin + numPitchBins];
             }
-            if (cndData[sample] < threshold)
+        }
+
+        /* 
+            Rescale so the best path is 1, or start again if every path has died. Paths that fall too far behind 
+            are dropped before they become denormals, which would make every later frame many times slower.
+        */
+        const float largest = FloatVectorOperations::findMaximum (path, numStates);
+
+        if (largest > 0.0f)
+        {
+            const float scale = 1.0f / largest;
+
+            for (int state = 0; state < numStates; ++state)
             {
-                while (sample + 1 < numSamples && cndData[sample + 1] < cndData[sample])
-                {
-                    sample ++;
-                }
-                interpolatedLagWithMinimumValue = getInterpolatedValleyFromCumulativeDifferenceLagEstimate (sample, cndBuffer, channel);
-                break;
+                const float scaled = path[state] * scale;
+                path[state] = scaled > negligibleProbability() ? scaled : 0.0f;
             }
         }
+        else
+        {
+            FloatVectorOperations::fill (path, 1.0f, numStates);
+        }
+    }
+
+    /* For each bin, the most probable of one voicing's paths (numPitchBins of sourcePaths) that can move to it. */
+    void findBestSources (const float* __restrict sourcePaths, float* __restrict best) const noexcept
+    {
+        FloatVectorOperations::clear (best, numPitchBins);
+
+        for (int offset = -maxTransitionBins; offset <= maxTransitionBins; ++offset)
+        {
+            const float weight   = transitionWeights[offset + maxTransitionBins];
+            const int   firstBin = jmax (0, -offset);
+            const int   lastBin  = jmin (numPitchBins, numPitchBins - offset);
+
+            for (int bin = firstBin; bin < lastBin; ++bin)
+            {
+                const float candidate = sourcePaths[bin + offset] * weight;
+                const float previous  = best[bin];
+                best[bin] = candidate > previous ? candidate : previous;
+            }
+        }
+    }
+
+    /* The state in previousPath that the best path into state came from, as stepViterbi() chose it. */
+    int getPredecessor (int state, const float* previousPath) const noexcept
+    {
+        const bool  isVoiced = state < numPitchBins;
+        const int   bin      = isVoiced ? state : state - numPitchBins;
+        const float stay     = voicingStayProbability();
+        const float fromVoicedTransition   = isVoiced ? stay : 1.0f - stay;
+        const float fromUnvoicedTransition = isVoiced ? 1.0f - stay : stay;
+
+        int   predecessor = state;
+        float best        = 0.0f;
+
+        for (int source = jmax (0, bin - (int) maxTransitionBins); source <= jmin (numPitchBins - 1, bin + (int) maxTransitionBins); ++source)
+        {
+            const float weight       = transitionWeights[source - bin + maxTransitionBins];
+            const float fromVoiced   = previousPath[source] * weight * fromVoicedTransition;
+            const float fromUnvoiced = previousPath[source + numPitchBins] * weight * fromUnvoicedTransition;
+
+            if (fromVoiced > best)   { best = fromVoiced;   predecessor = source; }
+            if (fromUnvoiced > best) { best = fromUnvoiced; predecessor = source + numPitchBins; }
+        }
 
-        normalisedLagPosition = Point<float> (interpolatedLagWithMinimumValue.getX() / cndBuffer.getNumSamples(), interpolatedLagWithMinimumValue.getY());
-        return interpolatedLagWithMinimumValue.getX() == -1.0f ? globalMinIndex
-                                                               : interpolatedLagWithMinimumValue.getX();
+        return predecessor;
     }
 
-    Point<float> getInterpolatedValleyFromCumulativeDifferenceLagEstimate (int lagEstimate, AudioSampleBuffer& cndBuffer, int channel)
+    void fillTransitionWeights()
     {
-        const int numSamples = cndBuffer.getNumSamples() / 2;
-        //I write out the priority using brackets for readability.
-        int leftNeighbour  = (lagEstimate < 1) ? 0 : lagEstimate; 
-        int rightNeighbour = lagEstimate + ((lagEstimate < numSamples + 1) ? 1 : 0);
+        float total = 0.0f;
 
-        const float* cndData = cndBuffer.getReadPointer (channel);
-        
-        if (leftNeighbour == lagEstimate)/* ||' */
-            return cndData[lagEstimate] <= cndData[rightNeighbour] ? Point<float> ((float) lagEstimate, cndData[lagEstimate]) 
-                                                                   : Point<float> ((float) rightNeighbour, cndData[rightNeighbour]);
-        
-        if (rightNeighbour == lagEstimate)/* '|| */
-            return cndData[lagEstimate] <= cndData[leftNeighbour] ? Point<float> ((float) lagEstimate, cndData[lagEstimate])
-                                                                  : Point<float> ((float) leftNeighbour, cndData[leftNeighbour]);
+        for (int offset = -maxTransitionBins; offset <= maxTransitionBins; ++offset)
+        {
+            transitionWeights[offset + maxTransitionBins] = (float) (maxTransitionBins + 1 - std::abs (offset));
+            total += transitionWeights[offset + maxTransitionBins];
+        }
 
-        float leftSample = cndData[leftNeighbour];
-        float sample = cndData[lagEstimate];
-        float rightSample = cndData[rightNeighbour];
+        for (auto& weight : transitionWeights)
+            weight /= total;
+    }
 
-        const float interpolatedLagDifference = (rightSample - leftSample) / (2.0f * (2.0f * sample - leftSample - rightSample));
-        const float interpolatedSample = cndData[lagEstimate] - 0.25f * (cndData[leftNeighbour] - cndData[rightNeighbour]) * interpolatedLagDifference;
+    int getBinForFrequency (double frequency) const noexcept
+    {
+        if (! (frequency > 0.0))
+            return -1;
 
-        return Point<float> (interpolatedLagDifference, interpolatedSample);
+        const int bin = roundToInt (log2 (frequency / minPitch) * (double) binsPerOctave);
+        return bin >= 0 && bin < numPitchBins ? bin : -1;
     }
-    
-};
 
+    /* 
+        The most likely candidate in the state's bin, for sub-bin accuracy, or else the bin's centre. An unvoiced 
+        state's bin only remembers where the pitch last was, so it takes the most likely candidate the pitch could 
+        have moved to since, or the bin's centre. After maxLookback unvoiced frames in a row that memory is no
+        longer trusted and it takes the frame's most likely candidate instead, as plain YIN would.
+    */
+    double getStateFrequency (int state, const PitchCandidates& frameCandidates, int numUnvoicedFrames) const noexcept
+    {
+        const int bin         = state % numPitchBins;
+        const int reach       = state < numPitchBins ? 0 : (int) maxTransitionBins;
+        double    frequency   = minPitch * pow (2.0, (double) bin / (double) binsPerOctave);
+        float     probability = 0.0f;
+        double    likeliestFrequency   = frequency;
+        float     likeliestProbability = 0.0f;
+
+        for (int i = 0; i < frameCandidates.numCandidates; ++i)
+        {
+            const int candidateBin = getBinForFrequency (frameCandidates.frequencies[i]);
+
+            if (candidateBin >= 0 && std::abs (candidateBin - bin) <= reach && frameCandidates.probabilities[i] > probability)
+            {
+                frequency   = frameCandidates.frequencies[i];
+                probability = frameCandidates.probabilities[i];
+            }
+
+            if (frameCandidates.probabilities[i] > likeliestProbability)
+            {
+                likeliestFrequency   = frameCandidates.frequencies[i];
+                likeliestProbability = frameCandidates.probabilities[i];
+            }
+        }
 
+        const bool memoryHasFaded = reach > 0 && probability <= 0.0f && numUnvoicedFrames >= maxLookback;
+        return memoryHasFaded && likeliestProbability > 0.0f ? likeliestFrequency : frequency;
+    }
+
+    double             minPitch         { PitchAnalyser::defaultMinPitch() };
+    int                numPitchBins     { 0 };
+    int                numStates        { 0 };
+    int                decodingLag      { 0 };
+    int64              numFramesTracked { 0 };
+    int                numUnvoicedFrames { 0 };  // how long the best path has been unvoiced, up to the latest frame
+    AlignedFloatBuffer pathHistory;      // maxLookback slots of numStates best path probabilities, a ring indexed by frame
+    AlignedFloatBuffer observations;
+    AlignedFloatBuffer bestVoicedSources;
+    AlignedFloatBuffer bestUnvoicedSources;
+    float              transitionWeights[maxTransitionBins * 2 + 1];
+    float              voicedProbabilities[maxLookback];
+    int64              samplePositions[maxLookback];
+    PitchCandidates    candidateHistory[maxLookback];
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (PitchTracker)
+};
 
 #endif  // PITCHANALYSER_H_INCLUDED
@@ -28,9 +28,28 @@ public:
         enHarmonicEnergyRatio,
         enOddEvenHarmonicRatio,
         enInharmonicity,
+        enRolloff85,
+        enRolloff95,
+        enCrest,
+        enSkewness,
+        enKurtosis,
+        enDecrease,
+        enContrast,
+        enEntropy,
+        enPitchConfidence,
         numFeatures
     };
 
+    /* Features with one value per band or coefficient, e.g. spectral contrast per octave. */
+    enum eVectorFeature
+    {
+        enContrastBands = 0,
+        enMFCCs,
+        enChroma,
+        enPitches,
+        numVectorFeatures
+    };
+
     static String getFeatureName (eAudioFeature featureType)
     {
         switch (featureType)
@@ -59,9 +78,72 @@ public:
                 return String ("O.E.R");
             case enInharmonicity:
                 return String ("Inharm.");
+            case enRolloff85:
+                return String ("Roll. 85");
+            case enRolloff95:
+                return String ("Roll. 95");
+            case enCrest:
+                return String ("Crest");
+            case enSkewness:
+                return String ("Skew.");
+            case enKurtosis:
+                return String ("Kurt.");
+            case enDecrease:
+                return String ("Decrease");
+            case enContrast:
+                return String ("Contrast");
+            case enEntropy:
+                return String ("Entropy");
+            case enPitchConfidence:
+                return String ("Voicing");
+        }
+    }
+
+    static String getVectorFeatureName (eVectorFeature featureType)
+    {
+        switch (featureType)
+        {
+            case enContrastBands:
+                return String ("Contrast");
+            case enMFCCs:
+                return String ("MFCC");
+            case enChroma:
+                return String ("Chroma");
+            case enPitches:
+                return String ("Pitches");
+            default:
+                jassertfalse;
+                return String ("UNKNOWN");
+        }
+    }
+
+    static int getDefaultVectorFeatureSize (eVectorFeature featureType)
+    {
+        switch (featureType)
+        {
+            case enContrastBands:
+                return (int) ExtendedSpectralCharacteristics::numContrastBands;
+            case enMFCCs:
+                return (int) MFCCAnalyser::defaultNumCoefficients;
+            case enChroma:
+                return (int) ChromaAnalyser::defaultBinsPerOctave;
+            case enPitches:
+                return 2 * (int) MultiPitchAnalyser::defaultMaxNumPitches;
+            default:
+                jassertfalse;
+                return 0;
         }
     }
 
+    /* 
+        How many frames a vector feature is smoothed over. MFCCs are left unsmoothed for classifiers, and the
+        pitches because the same slot can hold a different note from one frame to the next.
+    */
+    static int getVectorFeatureHistoryLength (eVectorFeature featureType)
+    {
+        return featureType == enMFCCs || featureType == enPitches ? 1 : 10;
+    }
+
     static float getMaxValueForFeature (eAudioFeature f) 
     {
         return 1.0f;
@@ -70,15 +152,34 @@ public:
     AudioFeatures() 
     {
         for (int feature = 0; feature < eAudioFeature::numFeatures; feature++)
+        {
             smoothedFeatures.push_back (ValueHistory (feature == AudioFeatures::eAudioFeature::enOnset || feature == eAudioFeature::enFlux ? 1 : 10));
+            samplePositions[feature].set (-1);
+        }
+
+        smoothedVectorFeatures.resize ((size_t) eVectorFeature::numVectorFeatures);
+
+        for (int feature = 0; feature < eVectorFeature::numVectorFeatures; feature++)
+            setVectorFeatureSize ((eVectorFeature) feature, getDefaultVectorFeatureSize ((eVectorFeature) feature));
     }
 
-    void updateFeature (eAudioFeature featureType, float newValue)
+    /* 
+        samplePosition is the capture sample position at the centre of the analysis window the value
+        was calculated from (see RealTimeAudioDataOverlapper::getWindowCentrePosition()).
+    */
+    void updateFeature (eAudioFeature featureType, float newValue, int64 samplePosition)
     {
         jassert (featureType < eAudioFeature::numFeatures && featureType >= enOnset);
         jassert ((int) featureType <= (int) smoothedFeatures.size());
 
         smoothedFeatures[(int) featureType].insertNewValueAndupdateHistory (newValue);
+        samplePositions[(int) featureType].set (samplePosition);
+    }
+
+    /* The time stamp of the latest value of a feature, or -1 if it hasn't been calculated yet. */
+    int64 getSamplePosition (eAudioFeature featureType) const
+    {
+        return samplePositions[(int) featureType].get();
     }
 
     float getValue (eAudioFeature featureType) const
@@ -87,13 +188,153 @@ public:
         return feature.getTotal() / feature.recordedHistory;
     }
 
+    /* Allocates and clears the feature's history, so only call this while nothing is analysing or reading it. */
+    void setVectorFeatureSize (eVectorFeature featureType, int numValues)
+    {
+        smoothedVectorFeatures[(int) featureType].assign ((size_t) numValues, ValueHistory (getVectorFeatureHistoryLength (featureType)));
+    }
+
+    int getVectorFeatureSize (eVectorFeature featureType) const
+    {
+        return (int) smoothedVectorFeatures[(int) featureType].size();
+    }
+
+    /* newValues holds getVectorFeatureSize (featureType) values. */
+    void updateVectorFeature (eVectorFeature featureType, const float* newValues)
+    {
+        std::vector<ValueHistory>& feature = smoothedVectorFeatures[(int) featureType];
+
+        for (size_t i = 0; i < feature.size(); ++i)
+            feature[i].insertNewValueAndupdateHistory (newValues[i]);
+    }
+
+    /* Inserts the same value into every element, e.g. zeros for a silent frame. */
+    void fillVectorFeature (eVectorFeature featureType, float value)
+    {
+        for (auto& element : smoothedVectorFeatures[(int) featureType])
+            element.insertNewValueAndupdateHistory (value);
+    }
+
+    float getVectorFeatureValue (eVectorFeature featureType, int index) const
+    {
+        const ValueHistory& value = smoothedVectorFeatures[(int) featureType][(size_t) index];
+        return value.recordedHistory > 0 ? value.getTotal() / value.recordedHistory : 0.0f;
+    }
+
 private:
     std::vector<ValueHistory> smoothedFeatures; 
+    std::vector<std::vector<ValueHistory>> smoothedVectorFeatures;
+    Atomic<int64>             samplePositions[numFeatures];
 };
 
 //============================================================================================================================================================
 //============================================================================================================================================================
 
+/*
+    A group of features calculated from the same analysis frame, e.g. the spectral features and onsets. 
+    A stage doesn't read any audio itself: every hop its analyser hands it the frame it has just computed.
+*/
+class AnalysisStage
+{
+public:
+    virtual ~AnalysisStage() {}
+
+    /* Called on the analysis thread with each new frame. */
+    virtual void processFrame (const AnalysisFrame& frame, AudioFeatures& features) = 0;
+
+    /* 
+        Called instead of processFrame() while the analyser's silence gate is closed. The frame only has its 
+        audio, sample position and nyquist: the stage publishes its values for silence at the frame's position 
+        and resets anything it carries from frame to frame, so it restarts cleanly when the gate opens.
+    */
+    virtual void processSilentFrame (const AnalysisFrame& frame, AudioFeatures& features) = 0;
+
+    /* Called while the analysis thread is stopped, whenever the window size or sample rate of the stage's analyser changes. */
+    virtual void prepare (int /*windowSize*/, double /*sampleRate*/) {}
+
+    /* Stages that read the frame's spectral peaks return true, and the analyser finds them once for all of its stages. */
+    virtual bool usesSpectralPeaks() const { return false; }
+};
+
+//============================================================================================================================================================
+//============================================================================================================================================================
+
+/*
+    Decides hop by hop whether a channel is active, from the level the capture recorded for each hop. The gate 
+    opens as soon as a hop reaches the open threshold, and closes once every hop has been under the (lower) 
+    close threshold for the hold time. The hold is never shorter than the window, so a closed gate means the 
+    whole window is quiet.
+*/
+class SilenceGate
+{
+public:
+    /* Thresholds are RMS levels in dBFS, after the collector's gain. */
+    void setThresholds (float openThresholdDb, float closeThresholdDb)
+    {
+        jassert (closeThresholdDb <= openThresholdDb);
+        openMeanSquare  = getMeanSquare (openThresholdDb);
+        closeMeanSquare = getMeanSquare (jmin (closeThresholdDb, openThresholdDb));
+    }
+
+    void setHoldSamples (int64 numSamples) { holdSamples = numSamples; }
+
+    /* Reopens the gate, so the next frames are analysed until the level has been quiet for the hold time again. */
+    void reset()
+    {
+        open            = true;
+        numQuietSamples = 0;
+    }
+
+    void setEnabled (bool shouldBeEnabled) { enabled = shouldBeEnabled; reset(); }
+    bool isEnabled() const                 { return enabled; }
+
+    /* 
+        Returns true if the frame ending with this hop should be skipped. A negative meanSquare means the hop's 
+        level isn't known, which leaves the gate as it was.
+    */
+    bool processHop (float meanSquare, int hopSize)
+    {
+        if (! enabled)
+            return false;
+
+        if (meanSquare >= openMeanSquare || (open && meanSquare >= closeMeanSquare))
+        {
+            open            = true;
+            numQuietSamples = 0;
+        }
+        else if (open && meanSquare >= 0.0f)
+        {
+            numQuietSamples += hopSize;
+            open = numQuietSamples < holdSamples;
+        }
+
+        return ! open;
+    }
+
+    static float  getDefaultOpenThresholdDb()  { return -60.0f; }
+    static float  getDefaultCloseThresholdDb() { return -66.0f; }
+    static double getDefaultHoldSeconds()      { return 0.25; }
+
+private:
+    static float getMeanSquare (float db) { const float rms = Decibels::decibelsToGain (db); return rms * rms; }
+
+    bool  enabled         { true };
+    bool  open            { true };
+    float openMeanSquare  { getMeanSquare (getDefaultOpenThresholdDb()) };
+    float closeMeanSquare { getMeanSquare (getDefaultCloseThresholdDb()) };
+    int64 holdSamples     { 0 };
+    int64 numQuietSamples { 0 };
+};
+
+//============================================================================================================================================================
+//============================================================================================================================================================
+
+/*
+    Reads one resolution of a channel from its collector, computes an AnalysisFrame for each hop and passes
+    it to every stage that has been added to it. Stages that share a resolution should share an analyser, 
+    so the window is only transformed once. While the channel is quiet a SilenceGate skips the windowing, 
+    transform and stages, and the stages just publish their silent values.
+*/
 class RealTimeAnalyser : public Thread
 {
 public:
@@ -102,141 +343,591 @@ public:
         audioDataCollector (adc),
         overlapper         (1, windowSize, audioDataCollector),
         fft                (windowSize, sampleRate),
-        features           (featuresRef)
-    {}
+        features           (featuresRef),
+        frame              (windowSize)
+    {
+        frame.nyquist = sampleRate / 2.0;
+        windower.setWindowSize (windowSize);
+        frame.powerSpectrumScale = windower.getTable()->getPowerCorrection();
+        updateSilenceGateHold();
+    }
 
-    virtual void run() override
-    {}
+    void run() override
+    {
+        while (!threadShouldExit())
+        {
+            if (! isNextBufferReadyOrWait() || ! readNextWindow())
+                continue;
+
+            if (frameIsGated)
+                processSilentFrame();
+            else
+                processFrame (fft.computeSpectrum (frame.windowedAudio.getReadPointer (0), getWindowSize()));
+        }
+    }
 
+    /* The analysis thread must be stopped. The stage is not owned. */
+    void addStage (AnalysisStage* stage)
+    {
+        jassert (! isThreadRunning());
+        stages.addIfNotAlreadyThere (stage);
+        stage->prepare (getWindowSize(), frame.nyquist * 2.0);
+        stagesUseSpectralPeaks = stagesUseSpectralPeaks || stage->usesSpectralPeaks();
+    }
+
+    void clearStages()
+    {
+        jassert (! isThreadRunning());
+        stages.clear();
+        stagesUseSpectralPeaks = false;
+    }
+
+    bool hasStages() const { return stages.size() > 0; }
+
+    /* The analysis thread must be stopped. */
     void sampleRateChanged (double newSampleRate)                           
     { 
+        jassert (! isThreadRunning());
         fft.setNyquistValue (newSampleRate / 2.0); 
+        frame.nyquist = newSampleRate / 2.0;
+        updateSilenceGateHold();
+
+        for (auto stage : stages)
+            stage->prepare (getWindowSize(), newSampleRate);
+    }
+
+    /* 
+        Changes the resolution this analyser subscribes to. The analysis thread must be stopped, 
+        the new window is read from the same capture ring as before.
+    */
+    void setWindowSize (int newWindowSize)
+    {
+        jassert (! isThreadRunning());
+        overlapper.setWindowSize (newWindowSize);
+        fft.setWindowSize (newWindowSize);
+        frame.setWindowSize (newWindowSize);
+        windower.setWindowSize (newWindowSize);
+        frame.powerSpectrumScale = windower.getTable()->getPowerCorrection();
+        updateSilenceGateHold();
+        silenceGate.reset();
+
+        for (auto stage : stages)
+            stage->prepare (newWindowSize, frame.nyquist * 2.0);
+    }
+
+    int getWindowSize() const { return overlapper.getWindowSize(); }
+
+    /* The analysis thread must be stopped. */
+    void setWindowShape (WindowTable::eShape newShape)
+    {
+        jassert (! isThreadRunning());
+        windower.setShape (newShape);
+        frame.powerSpectrumScale = windower.getTable()->getPowerCorrection();
+    }
+
+    WindowTable::eShape getWindowShape() const { return windower.getShape(); }
+
+    /* 
+        Frames are skipped once the level has stayed under the close threshold (dBFS RMS) for holdSeconds, 
+        or the window length if that's longer, and analysed again as soon as a hop reaches the open threshold. 
+        The analysis thread must be stopped.
+    */
+    void setSilenceGate (bool shouldBeEnabled, float openThresholdDb, float closeThresholdDb, double holdSeconds)
+    {
+        jassert (! isThreadRunning());
+        silenceGate.setEnabled (shouldBeEnabled);
+        silenceGate.setThresholds (openThresholdDb, closeThresholdDb);
+        silenceGateHoldSeconds = holdSeconds;
+        updateSilenceGateHold();
+    }
+
+    const SilenceGate& getSilenceGate() const { return silenceGate; }
+
+    /* 
+        Returns true if a hop of new samples is ready. Otherwise sleeps until the audio thread has
+        published a full hop of new samples and returns false, recording the time spent waiting.
+    */
+    bool isNextBufferReadyOrWait()
+    {
+        if (overlapper.isNextBufferReady())
+            return true;
+
+        const int64 waitStartTicks = Time::getHighResolutionTicks();
+        wait (-1);
+        audioDataCollector.addReaderWaitTicks (Time::getHighResolutionTicks() - waitStartTicks);
+        return false;
     }
 
     RealTimeAudioDataOverlapper&    getOverlapper()       { return overlapper; }
     FFTAnalyser&                    getFFTAnalyser()      { return fft; }
 
     AudioFeatures&                  getFeatures()         { return features; }
+
+    //==============================================================================
+    /* 
+        The steps of run(), for a BatchedRealTimeAnalyser that transforms many analysers' windows together 
+        instead of running their threads. 
+    */
+
+    /* 
+        If a hop of new samples is ready, reads the next frame's audio and returns true. Unless the frame is 
+        gated (see isFrameGated()) the audio is also windowed, ready to be transformed.
+    */
+    bool readNextWindowIfReady()
+    {
+        return overlapper.isNextBufferReady() && readNextWindow();
+    }
+
+    /* True if the silence gate skipped the frame just read, which should be passed to processSilentFrame() instead of being transformed. */
+    bool isFrameGated() const { return frameIsGated; }
+
+    /* Publishes the stages' silent values for the frame just read. */
+    void processSilentFrame()
+    {
+        for (auto stage : stages)
+            stage->processSilentFrame (frame, features);
+    }
+
+    /* The windowed audio of the frame being computed, getWindowSize() samples. */
+    const float* getWindowedAudio() const { return frame.windowedAudio.getReadPointer (0); }
+
+    /* Where the frame's spectrum should be written, getWindowSize() * 2 floats. */
+    float* getSpectrumWorkspace() { return fft.getSpectrum(); }
+
+    /* Finishes the frame from the spectrum written to getSpectrumWorkspace() and passes it to every stage. */
+    void processBatchedFrame()
+    {
+        fft.updateFFTBufferToDraw();
+        processFrame (fft.getSpectrum());
+    }
+
 private:
+    /* Returns false, and leaves the frame as it was, if the collector was cleared before the hop could be read. */
+    bool readNextWindow()
+    {
+        if (! overlapper.readNextHop())
+            return false;
+
+        const AudioSampleBuffer& audioWindow = overlapper.getWindow();
+        const int numSamples = audioWindow.getNumSamples();
+
+        frame.audio          = &audioWindow;
+        frame.samplePosition = overlapper.getWindowCentrePosition();
+
+        /* The gate only looks at the level the capture recorded for the new hop, not at the audio */
+        const int hopSize = overlapper.getHopSize();
+        frameIsGated = silenceGate.processHop (audioDataCollector.getMeanSquare (overlapper.getWindowEndPosition() - hopSize, hopSize), hopSize);
+        audioDataCollector.addFrame (frameIsGated);
+
+        if (frameIsGated)
+        {
+            frame.rms    = 0.0f;
+            frame.logRMS = 0.0f;
+            return true;
+        }
+
+        frame.rms            = audioWindow.getRMSLevel (0, 0, numSamples);
+        frame.logRMS         = log10 (frame.rms * 9.0f + 1.0f);
+
+        /* Apply windowing function (to a copy, as the overlapper keeps its window for the next hop) */
+        frame.windowedAudio.copyFrom (0, 0, audioWindow, 0, 0, numSamples);
+        windower.applyWindow (frame.windowedAudio);
+        return true;
+    }
+
+    void processFrame (const float* spectrum)
+    {
+        frame.spectrum = spectrum;
+        frame.updatePowerSpectrum();
+
+        if (stagesUseSpectralPeaks)
+            frame.updatePeaks();
+
+        for (auto stage : stages)
+            stage->processFrame (frame, features);
+    }
+
+    void updateSilenceGateHold()
+    {
+        silenceGate.setHoldSamples (jmax ((int64) getWindowSize(), (int64) (silenceGateHoldSeconds * frame.nyquist * 2.0)));
+    }
+
     AudioDataCollector&             audioDataCollector;
     RealTimeAudioDataOverlapper     overlapper;
     FFTAnalyser                     fft;
     AudioFeatures&                  features;
+    RealTimeWindower                windower;
+    AnalysisFrame                   frame;
+    Array<AnalysisStage*>           stages;
+    bool                            stagesUseSpectralPeaks { false };
+    SilenceGate                     silenceGate;
+    double                          silenceGateHoldSeconds { SilenceGate::getDefaultHoldSeconds() };
+    bool                            frameIsGated { false };
 
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (RealTimeAnalyser)
 };
 
-
 //============================================================================================================================================================
 //============================================================================================================================================================
 
-class RealTimeHarmonicAnalyser : public RealTimeAnalyser
+/*
+    Runs many RealTimeAnalysers on one thread, for rigs with many channels. Each time the capture wakes it 
+    (once per device block) it reads every analyser that has a hop ready, transforms all of the windows of 
+    the same size together with a BatchedBundledFFT (one SIMD lane per channel), and then passes each frame 
+    to its analyser's stages. Gated frames are published as silence and left out of the batches. Analysers 
+    added here must not also run their own threads.
+
+    Only the transform is batched. The feature stages still run one track at a time, because the fused 
+    descriptor pass already fills its SIMD lanes with neighbouring bins of one spectrum. A lane per track 
+    would first need the spectra transposed, and gains nothing over that.
+*/
+class BatchedRealTimeAnalyser : public Thread
 {
 public:
-    RealTimeHarmonicAnalyser (AudioDataCollector& adc, AudioFeatures& featuresRef, int windowSize, double sampleRate = 48000.0)
-    :   RealTimeAnalyser   (adc, featuresRef, windowSize, sampleRate),
-        pitchEstimator     (getFFTAnalyser())
-    {}
+    BatchedRealTimeAnalyser (int maxNumAnalysersToUse)
+    :   Thread          ("Batched audio analysis thread"),
+        maxNumAnalysers (maxNumAnalysersToUse)
+    {
+        analysers.ensureStorageAllocated      (maxNumAnalysers);
+        readyAnalysers.ensureStorageAllocated (maxNumAnalysers);
+        batch.ensureStorageAllocated          (maxNumAnalysers);
+        batchTimeData.ensureStorageAllocated  (maxNumAnalysers);
+        batchSpectra.ensureStorageAllocated   (maxNumAnalysers);
+    }
+
+    ~BatchedRealTimeAnalyser()
+    {
+        stopThread (500);
+    }
 
     void run() override
     {
-        while (!threadShouldExit())
+        while (! threadShouldExit())
         {
-            FFTAnalyser& fftAnalyser = getFFTAnalyser();
-            const int numSamplesInHarmAnalysisWindow = fftAnalyser.getFFTExpectedSamples();
-            AudioSampleBuffer audioWindow = getOverlapper().getNextBuffer();
-            float rms = audioWindow.getRMSLevel (0, 0, audioWindow.getNumSamples());
-            float logRMS = log10 (rms * 9.0f + 1.0f);
-            getFeatures().updateFeature (AudioFeatures::eAudioFeature::enRMS, logRMS);
-            /* Low-pass filter the audio */
-            AudioSampleBuffer filteredAudio (audioWindow);
-            filteredAudio.clear();
-            filter.filterAudio (audioWindow, filteredAudio);
-
-            /* Apply windowing function */
-            windower.scaleBufferWithBartlettWindowing (filteredAudio);
-
-            /* Compute FFT */
-            AudioSampleBuffer filteredFrequencyBuffer = fftAnalyser.getFrequencyData (filteredAudio);
-            AudioSampleBuffer frequencyBuffer = fftAnalyser.getFrequencyData (audioWindow);
-            
-            /* Estimate Pitch */
-            double f0Estimate = pitchEstimator.estimatePitch (filteredFrequencyBuffer);
-            const double f0NormalisationFactor = 5000.0;
-            getFeatures().updateFeature (AudioFeatures::eAudioFeature::enF0, (float) (f0Estimate / f0NormalisationFactor));
-
-            /* Calculate harmonic features based on pitch estimation */
-            HarmonicCharacteristics harmonicFeatures = harmonicAnalyser.calculateHarmonicCharacteristics (frequencyBuffer, f0Estimate, getFFTAnalyser().getNyquist(), 0);
-            getFeatures().updateFeature (AudioFeatures::eAudioFeature::enHarmonicEnergyRatio, harmonicFeatures.harmonicEnergyRatio);
-            getFeatures().updateFeature (AudioFeatures::eAudioFeature::enOddEvenHarmonicRatio, harmonicFeatures.harmonicEnergyRatio);
-            getFeatures().updateFeature (AudioFeatures::eAudioFeature::enInharmonicity,       harmonicFeatures.inharmonicity);
-
-            /* Wait for notification that new audio data has come in from audio thread */
-            wait (-1);
+            if (! analyseReadyFrames())
+                wait (-1);
+        }
+    }
+
+    /* 
+        Safe to call while the thread is running, from the message thread. The analyser's own thread must be 
+        stopped, and its window size can't change until it has been removed again. If no analyser has used 
+        its window size before, the transform for it is built here, so the analysis thread never allocates.
+    */
+    void addAnalyser (RealTimeAnalyser* analyser)
+    {
+        jassert (! analyser->isThreadRunning());
+        const int windowSize = analyser->getWindowSize();
+
+        /* only the message thread adds transforms, so it can look for one without the lock */
+        ScopedPointer<BatchedBundledFFT> newBatchedFFT;
+
+        if (findBatchedFFT (windowSize) == nullptr)
+            newBatchedFFT = new BatchedBundledFFT (windowSize, maxNumAnalysers);
+
+        const ScopedLock sl (lock);
+
+        if (newBatchedFFT != nullptr)
+            batchedFFTs.add (newBatchedFFT.release());
+
+        jassert (analysers.contains (analyser) || analysers.size() < maxNumAnalysers);
+        analysers.addIfNotAlreadyThere (analyser);
+    }
+
+    /* Returns once the analyser is no longer being used, after which it can be reconfigured. */
+    void removeAnalyser (RealTimeAnalyser* analyser)
+    {
+        const ScopedLock sl (lock);
+        analysers.removeFirstMatchingValue (analyser);
+    }
+
+    bool containsAnalyser (RealTimeAnalyser* analyser) const
+    {
+        const ScopedLock sl (lock);
+        return analysers.contains (analyser);
+    }
+
+private:
+    /* Analyses every analyser with a hop ready. Returns false if none were ready. */
+    bool analyseReadyFrames()
+    {
+        const ScopedLock sl (lock);
+        readyAnalysers.clearQuick();
+        bool anyFramesRead = false;
+
+        for (auto analyser : analysers)
+        {
+            if (! analyser->readNextWindowIfReady())
+                continue;
+
+            anyFramesRead = true;
+
+            if (analyser->isFrameGated())
+                analyser->processSilentFrame();
+            else
+                readyAnalysers.add (analyser);
         }
+
+        if (! anyFramesRead)
+            return false;
+
+        //each window size is transformed as one batch. Analysers are set to nullptr once they are in a batch
+        for (int first = 0; first < readyAnalysers.size(); ++first)
+        {
+            if (readyAnalysers.getUnchecked (first) == nullptr)
+                continue;
+
+            const int windowSize = readyAnalysers.getUnchecked (first)->getWindowSize();
+            batch.clearQuick();
+            batchTimeData.clearQuick();
+            batchSpectra.clearQuick();
+
+            for (int i = first; i < readyAnalysers.size(); ++i)
+            {
+                RealTimeAnalyser* analyser = readyAnalysers.getUnchecked (i);
+
+                if (analyser != nullptr && analyser->getWindowSize() == windowSize)
+                {
+                    batch.add         (analyser);
+                    batchTimeData.add (analyser->getWindowedAudio());
+                    batchSpectra.add  (analyser->getSpectrumWorkspace());
+                    readyAnalysers.set (i, nullptr);
+                }
+            }
+
+            BatchedBundledFFT* batchedFFT = findBatchedFFT (windowSize);
+
+            /* addAnalyser() builds a transform for each analyser's window size */
+            if (batchedFFT == nullptr)
+            {
+                jassertfalse;
+                continue;
+            }
+
+            batchedFFT->performRealForward (batchTimeData.getRawDataPointer(), batchSpectra.getRawDataPointer(), batch.size());
+
+            for (auto analyser : batch)
+                analyser->processBatchedFrame();
+        }
+
+        return true;
     }
 
+    /* The transform for a window size, or nullptr if addAnalyser() hasn't built one. Doesn't allocate. */
+    BatchedBundledFFT* findBatchedFFT (int windowSize) const
+    {
+        for (auto batchedFFT : batchedFFTs)
+            if (batchedFFT->getSize() == windowSize)
+                return batchedFFT;
+
+        return nullptr;
+    }
+
+    const int                     maxNumAnalysers;
+    CriticalSection               lock;
+    Array<RealTimeAnalyser*>      analysers;
+    Array<RealTimeAnalyser*>      readyAnalysers;
+    Array<RealTimeAnalyser*>      batch;
+    Array<const float*>           batchTimeData;
+    Array<float*>                 batchSpectra;
+    OwnedArray<BatchedBundledFFT> batchedFFTs;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (BatchedRealTimeAnalyser)
+};
+
+
+//============================================================================================================================================================
+//============================================================================================================================================================
+
+/*
+    Pitch and the harmonic features. Pitch is estimated from a low-pass filtered copy of the window, which is
+    the only thing that needs a transform of its own, and tracked across frames by a PitchTracker; the harmonic 
+    features use the frame's power spectrum and its peaks.
+*/
+class HarmonicAnalysisStage : public AnalysisStage
+{
+public:
+    HarmonicAnalysisStage (int windowSize, double sampleRate = 48000.0)
+    :   filteredFFT        (windowSize, sampleRate),
+        pitchEstimator     (filteredFFT),
+        filteredAudio      (1, windowSize)
+    {
+        windower.setWindowSize (windowSize);
+        pitchEstimator.setAnalysisWindow (*windower.getTable());
+    }
+
+    void prepare (int windowSize, double sampleRate) override
+    {
+        filteredFFT.setWindowSize (windowSize);
+        filteredFFT.setNyquistValue (sampleRate / 2.0);
+        filteredAudio.setSize    (1, windowSize);
+        windower.setWindowSize   (windowSize);
+        pitchEstimator.setWindowSize (windowSize);
+        pitchEstimator.setAnalysisWindow (*windower.getTable());
+        pitchTracker.reset();
+    }
+
+    /* The analysis thread must be stopped. Should match the shape used by the stage's analyser. */
+    void setWindowShape (WindowTable::eShape newShape) 
+    { 
+        windower.setShape (newShape); 
+        pitchEstimator.setAnalysisWindow (*windower.getTable());
+    }
+
+    /* The range of fundamentals (in Hz) the pitch search and tracking cover. The analysis thread must be stopped. */
+    void setPitchRange (double minFrequency, double maxFrequency) 
+    { 
+        pitchEstimator.setPitchRange (minFrequency, maxFrequency); 
+        pitchTracker.setPitchRange (minFrequency, maxFrequency);
+    }
+
+    /* How many frames the pitch tracker waits before deciding a frame's pitch. The analysis thread must be stopped. */
+    void setPitchTrackingLag (int numFrames) { pitchTracker.setDecodingLag (numFrames); }
+
+    void processFrame (const AnalysisFrame& frame, AudioFeatures& features) override
+    {
+        /* Low-pass filter the audio */
+        filter.filterAudio (*frame.audio, filteredAudio);
+
+        /* Apply windowing function */
+        windower.applyWindow (filteredAudio);
+
+        /* Compute FFT */
+        const int numSamples = filteredAudio.getNumSamples();
+        filteredFFT.computeSpectrum (filteredAudio.getReadPointer (0), numSamples);
+        
+        /* Estimate Pitch (from the analyser's spectrum, in the estimator's own workspace), then track it across frames */
+        pitchEstimator.estimatePitch (filteredFFT.getSpectrum(), numSamples * 2);
+        const PitchTrack track = pitchTracker.processFrame (pitchEstimator.findPitchCandidates(), frame.samplePosition);
+        const double f0NormalisationFactor = 5000.0;
+        const double f0 = track.isVoiced ? track.frequency : 0.0;
+        features.updateFeature (AudioFeatures::eAudioFeature::enF0,              (float) (f0 / f0NormalisationFactor), track.samplePosition);
+        features.updateFeature (AudioFeatures::eAudioFeature::enPitchConfidence, track.confidence,                     track.samplePosition);
+
+        /* Calculate harmonic features based on the pitch of this frame. An unvoiced frame has no harmonics to measure. */
+        const HarmonicCharacteristics harmonicFeatures = track.latestIsVoiced 
+                                                       ? harmonicAnalyser.calculateHarmonicCharacteristics (frame.getPowerSpectrum(), frame.getNumBins(), frame.peaks, track.latestFrequency, frame.nyquist)
+                                                       : HarmonicCharacteristics (0.0f, 0.0f, 0.0f);
+        features.updateFeature (AudioFeatures::eAudioFeature::enHarmonicEnergyRatio,  harmonicFeatures.harmonicEnergyRatio, frame.samplePosition);
+        features.updateFeature (AudioFeatures::eAudioFeature::enOddEvenHarmonicRatio, harmonicFeatures.oddEvenHarmonicRatio, frame.samplePosition);
+        features.updateFeature (AudioFeatures::eAudioFeature::enInharmonicity,        harmonicFeatures.inharmonicity,       frame.samplePosition);
+    }
+
+    /* Unpitched, with no harmonics. The tracker restarts, as the frames before the gate closed can't affect the next note. */
+    void processSilentFrame (const AnalysisFrame& frame, AudioFeatures& features) override
+    {
+        pitchTracker.reset();
+        features.updateFeature (AudioFeatures::eAudioFeature::enF0,                   0.0f, frame.samplePosition);
+        features.updateFeature (AudioFeatures::eAudioFeature::enPitchConfidence,      0.0f, frame.samplePosition);
+        features.updateFeature (AudioFeatures::eAudioFeature::enHarmonicEnergyRatio,  0.0f, frame.samplePosition);
+        features.updateFeature (AudioFeatures::eAudioFeature::enOddEvenHarmonicRatio, 0.0f, frame.samplePosition);
+        features.updateFeature (AudioFeatures::eAudioFeature::enInharmonicity,        0.0f, frame.samplePosition);
+    }
+
+    bool usesSpectralPeaks() const override { return true; }
+
     PitchAnalyser&                   getPitchAnalyser()    { return pitchEstimator; }
+    PitchTracker&                    getPitchTracker()     { return pitchTracker; }
     HarmonicCharacteristicsAnalyser& getHarmonicAnalyser() { return harmonicAnalyser; }
+    FFTAnalyser&                     getFFTAnalyser()      { return filteredFFT; }
 private:
     AudioFilter                     filter;
     RealTimeWindower                windower;
+    FFTAnalyser                     filteredFFT;
     HarmonicCharacteristicsAnalyser harmonicAnalyser;
     PitchAnalyser                   pitchEstimator;
+    PitchTracker                    pitchTracker;
+    AudioSampleBuffer               filteredAudio;
 
-    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (RealTimeHarmonicAnalyser)
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (HarmonicAnalysisStage)
 };
 
 //============================================================================================================================================================
 //============================================================================================================================================================
 
-class RealTimeSpectralAnalyser : public RealTimeAnalyser
+/* Amplitude, the spectral features and onset detection. */
+class SpectralAnalysisStage : public AnalysisStage
 {
 public:
-    RealTimeSpectralAnalyser (AudioDataCollector& adc, AudioFeatures& featuresRef, int windowSize, double sampleRate = 48000.0)
-    :   RealTimeAnalyser (adc, featuresRef, windowSize, sampleRate),
-        spectralAnalyser (windowSize)
+    SpectralAnalysisStage (int windowSize)
+    :   spectralAnalyser (windowSize),
+        extendedAnalyser (windowSize)
     {}
 
-    void run() override
+    void prepare (int windowSize, double sampleRate) override
     {
-        while (!threadShouldExit())
-        {
-            const int numSamplesInHarmAnalysisWindow = getFFTAnalyser().getFFTExpectedSamples();
-            AudioSampleBuffer audioWindow = getOverlapper().getNextBuffer();
-            float rms = audioWindow.getRMSLevel (0, 0, audioWindow.getNumSamples());
-            float logRMS = log10 (rms * 9.0f + 1.0f);
-            getFeatures().updateFeature (AudioFeatures::eAudioFeature::enRMS, logRMS);
-
-            /* Apply windowing function */
-            windower.scaleBufferWithBartlettWindowing (audioWindow);
-
-            /* Compute FFT */
-            AudioSampleBuffer frequencyBuffer = getFFTAnalyser().getFrequencyData (audioWindow);
-
-            /* Get spectral features */
-            SpectralCharacteristics spectralFeatures = spectralAnalyser.calculateSpectralCharacteristics (frequencyBuffer, logRMS, 0, getFFTAnalyser().getNyquist());
-            getFeatures().updateFeature (AudioFeatures::eAudioFeature::enCentroid, spectralFeatures.centroid);
-            getFeatures().updateFeature (AudioFeatures::eAudioFeature::enFlatness, spectralFeatures.flatness);
-            getFeatures().updateFeature (AudioFeatures::eAudioFeature::enLER,      spectralFeatures.ler);
-            getFeatures().updateFeature (AudioFeatures::eAudioFeature::enSpread,   spectralFeatures.spread);
-            getFeatures().updateFeature (AudioFeatures::eAudioFeature::enFlux,     spectralFeatures.flux);
-            getFeatures().updateFeature (AudioFeatures::eAudioFeature::enSlope,    spectralAnalyser.calculateNormalisedSpectralSlope (frequencyBuffer, 0));
-
-            getFeatures().updateFeature (AudioFeatures::eAudioFeature::enOnset, detectOnset());
+        spectralAnalyser.setWindowSize (windowSize);
+        extendedAnalyser.prepare (windowSize, sampleRate);
+    }
+
+    /* 
+        The extended descriptors (rolloff, crest, skewness, kurtosis, decrease, contrast and entropy) share 
+        the basic descriptors' pass, but still cost a little more per frame. The analysis thread must be stopped.
+    */
+    void setExtendedDescriptorsEnabled (bool shouldBeEnabled) { extendedDescriptorsEnabled = shouldBeEnabled; }
+    bool areExtendedDescriptorsEnabled() const                { return extendedDescriptorsEnabled; }
+
+    void processFrame (const AnalysisFrame& frame, AudioFeatures& features) override
+    {
+        const int64 framePosition = frame.samplePosition;
+        features.updateFeature (AudioFeatures::eAudioFeature::enRMS, frame.logRMS, framePosition);
+
+        /* Get spectral features */
+        SpectralCharacteristics spectralFeatures = spectralAnalyser.calculateSpectralCharacteristics (frame.getPowerSpectrum(), frame.getNumBins(), frame.logRMS, frame.nyquist, 
+                                                                                                      extendedDescriptorsEnabled);
+        features.updateFeature (AudioFeatures::eAudioFeature::enCentroid, spectralFeatures.centroid, framePosition);
+        features.updateFeature (AudioFeatures::eAudioFeature::enFlatness, spectralFeatures.flatness, framePosition);
+        features.updateFeature (AudioFeatures::eAudioFeature::enLER,      spectralFeatures.ler,      framePosition);
+        features.updateFeature (AudioFeatures::eAudioFeature::enSpread,   spectralFeatures.spread,   framePosition);
+        features.updateFeature (AudioFeatures::eAudioFeature::enFlux,     spectralFeatures.flux,     framePosition);
+        features.updateFeature (AudioFeatures::eAudioFeature::enSlope,    spectralFeatures.slope,    framePosition);
+
+        if (extendedDescriptorsEnabled)
+            updateExtendedFeatures (frame, features);
+
+        features.updateFeature (AudioFeatures::eAudioFeature::enOnset, detectOnset (features), framePosition);
             
-            if (getFeatures().getValue (AudioFeatures::eAudioFeature::enOnset) > 0.0f && onsetDetectedCallback != nullptr)
-                onsetDetectedCallback();
+        if (features.getValue (AudioFeatures::eAudioFeature::enOnset) > 0.0f && onsetDetectedCallback != nullptr)
+            onsetDetectedCallback();
+
+        previousFrameWasSilent = false;
+    }
+
+    /* 
+        Every feature is 0, as for a frame of digital silence. The onset detector's histories see the silence, 
+        and so does the flux, so the first frame after the gate opens measures its flux (and onset) against silence.
+    */
+    void processSilentFrame (const AnalysisFrame& frame, AudioFeatures& features) override
+    {
+        const int64 framePosition = frame.samplePosition;
 
-            /* Wait for notification that new audio data has come in from audio thread */
-            wait (-1);
+        if (! previousFrameWasSilent)
+            spectralAnalyser.clearPreviousSpectrum();
+
+        previousFrameWasSilent = true;
+
+        for (auto feature : { AudioFeatures::eAudioFeature::enRMS, AudioFeatures::eAudioFeature::enCentroid, AudioFeatures::eAudioFeature::enFlatness, 
+                              AudioFeatures::eAudioFeature::enLER, AudioFeatures::eAudioFeature::enSpread,   AudioFeatures::eAudioFeature::enFlux, 
+                              AudioFeatures::eAudioFeature::enSlope, AudioFeatures::eAudioFeature::enOnset })
+            features.updateFeature (feature, 0.0f, framePosition);
+
+        if (extendedDescriptorsEnabled)
+        {
+            for (auto feature : { AudioFeatures::eAudioFeature::enRolloff85, AudioFeatures::eAudioFeature::enRolloff95, AudioFeatures::eAudioFeature::enCrest, 
+                                  AudioFeatures::eAudioFeature::enSkewness,  AudioFeatures::eAudioFeature::enKurtosis,  AudioFeatures::eAudioFeature::enDecrease, 
+                                  AudioFeatures::eAudioFeature::enContrast,  AudioFeatures::eAudioFeature::enEntropy })
+                features.updateFeature (feature, 0.0f, framePosition);
+
+            features.fillVectorFeature (AudioFeatures::eVectorFeature::enContrastBands, 0.0f);
         }
+
+        onsetDetector.addSpectralFluxAndAmpValue (0.0f, 0.0f);
     }
 
-    float detectOnset ()
+    float detectOnset (const AudioFeatures& features)
     {
-        float currentSpectralFluxValue = getFeatures().getValue (AudioFeatures::eAudioFeature::enFlux);
-        float currentAmp               = getFeatures().getValue (AudioFeatures::eAudioFeature::enRMS);
+        float currentSpectralFluxValue = features.getValue (AudioFeatures::eAudioFeature::enFlux);
+        float currentAmp               = features.getValue (AudioFeatures::eAudioFeature::enRMS);
         onsetDetector.addSpectralFluxAndAmpValue (currentSpectralFluxValue, currentAmp);
         return onsetDetector.detectOnset() ? 1.0f : 0.0f;
     }
@@ -260,12 +951,173 @@ public:
     OnsetDetector&                   getOnsetDetector()    { return onsetDetector; }
     SpectralCharacteristicsAnalyser& getSpectralAnalyser() { return spectralAnalyser; }
 private:
-    RealTimeWindower                windower;
-    SpectralCharacteristicsAnalyser spectralAnalyser;
+    void updateExtendedFeatures (const AnalysisFrame& frame, AudioFeatures& features)
+    {
+        const int64 framePosition = frame.samplePosition;
+        const ExtendedSpectralCharacteristics extended = extendedAnalyser.calculateExtendedSpectralCharacteristics (frame.getPowerSpectrum(), frame.getNumBins(), 
+                                                                                                                    spectralAnalyser.getPartialSums());
+        features.updateFeature (AudioFeatures::eAudioFeature::enRolloff85, extended.rolloff85, framePosition);
+        features.updateFeature (AudioFeatures::eAudioFeature::enRolloff95, extended.rolloff95, framePosition);
+        features.updateFeature (AudioFeatures::eAudioFeature::enCrest,     extended.crest,     framePosition);
+        features.updateFeature (AudioFeatures::eAudioFeature::enSkewness,  extended.skewness,  framePosition);
+        features.updateFeature (AudioFeatures::eAudioFeature::enKurtosis,  extended.kurtosis,  framePosition);
+        features.updateFeature (AudioFeatures::eAudioFeature::enDecrease,  extended.decrease,  framePosition);
+        features.updateFeature (AudioFeatures::eAudioFeature::enContrast,  extended.contrast,  framePosition);
+        features.updateFeature (AudioFeatures::eAudioFeature::enEntropy,   extended.entropy,   framePosition);
+        features.updateVectorFeature (AudioFeatures::eVectorFeature::enContrastBands, extended.contrastBands);
+    }
+
+    SpectralCharacteristicsAnalyser         spectralAnalyser;
+    ExtendedSpectralCharacteristicsAnalyser extendedAnalyser;
+    bool                                    extendedDescriptorsEnabled { true };
+    bool                                    previousFrameWasSilent { false };
     OnsetDetector                   onsetDetector;
     std::function<void()>           onsetDetectedCallback;
 
-    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (RealTimeSpectralAnalyser)
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (SpectralAnalysisStage)
+};
+
+//============================================================================================================================================================
+//============================================================================================================================================================
+
+/* Mel-frequency cepstral coefficients, from the frame's power spectrum. */
+class CepstralAnalysisStage : public AnalysisStage
+{
+public:
+    CepstralAnalysisStage (int windowSize, double sampleRate = 48000.0)
+    :   mfccAnalyser (windowSize, sampleRate)
+    {}
+
+    void prepare (int windowSize, double sampleRate) override
+    {
+        mfccAnalyser.prepare (windowSize, sampleRate);
+    }
+
+    void processFrame (const AnalysisFrame& frame, AudioFeatures& features) override
+    {
+        jassert (features.getVectorFeatureSize (AudioFeatures::eVectorFeature::enMFCCs) == mfccAnalyser.getNumCoefficients());
+        features.updateVectorFeature (AudioFeatures::eVectorFeature::enMFCCs, mfccAnalyser.calculateMFCCs (frame.getPowerSpectrum(), frame.getNumBins()));
+    }
+
+    void processSilentFrame (const AnalysisFrame&, AudioFeatures& features) override
+    {
+        features.updateVectorFeature (AudioFeatures::eVectorFeature::enMFCCs, mfccAnalyser.getSilentMFCCs());
+    }
+
+    /* The analysis thread must be stopped, and the features' MFCC size changed to match. */
+    void setNumCoefficientsAndBands (int numCoefficients, int numBands) { mfccAnalyser.setNumCoefficientsAndBands (numCoefficients, numBands); }
+
+    MFCCAnalyser& getMFCCAnalyser() { return mfccAnalyser; }
+private:
+    MFCCAnalyser mfccAnalyser;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (CepstralAnalysisStage)
+};
+
+//============================================================================================================================================================
+//============================================================================================================================================================
+
+/* 
+    The chromagram, folded from the frame's power spectrum. It runs with the harmonic stage, as the longer
+    pitch windows resolve the low semitones better.
+*/
+class ChromaAnalysisStage : public AnalysisStage
+{
+public:
+    ChromaAnalysisStage (int windowSize, double sampleRate = 48000.0)
+    :   chromaAnalyser (windowSize, sampleRate)
+    {}
+
+    /* Called from the analyser's sampleRateChanged() and setWindowSize(), the only times the mapping is rebuilt. */
+    void prepare (int windowSize, double sampleRate) override
+    {
+        chromaAnalyser.prepare (windowSize, sampleRate);
+    }
+
+    void processFrame (const AnalysisFrame& frame, AudioFeatures& features) override
+    {
+        jassert (features.getVectorFeatureSize (AudioFeatures::eVectorFeature::enChroma) == chromaAnalyser.getNumBins());
+        features.updateVectorFeature (AudioFeatures::eVectorFeature::enChroma, chromaAnalyser.calculateChroma (frame.getPowerSpectrum(), frame.getNumBins()));
+    }
+
+    void processSilentFrame (const AnalysisFrame&, AudioFeatures& features) override
+    {
+        features.fillVectorFeature (AudioFeatures::eVectorFeature::enChroma, 0.0f);
+    }
+
+    /* The analysis thread must be stopped, and the features' chroma size changed to match. */
+    void setResolutionAndTuning (int binsPerOctave, double tuningOffsetCents) { chromaAnalyser.setResolutionAndTuning (binsPerOctave, tuningOffsetCents); }
+
+    ChromaAnalyser& getChromaAnalyser() { return chromaAnalyser; }
+private:
+    ChromaAnalyser chromaAnalyser;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (ChromaAnalysisStage)
+};
+
+//============================================================================================================================================================
+//============================================================================================================================================================
+
+/* 
+    Several simultaneous pitches, for chords, from the frame's power spectrum. Like the chroma it runs with the
+    harmonic stage. Each pitch is published as its frequency (normalised as the F0 is) followed by its salience, 
+    strongest first, with zeros in the unused slots.
+*/
+class MultiPitchAnalysisStage : public AnalysisStage
+{
+public:
+    MultiPitchAnalysisStage (int windowSize, double sampleRate = 48000.0)
+    :   multiPitchAnalyser (windowSize, sampleRate),
+        values             (2 * multiPitchAnalyser.getMaxNumPitches())
+    {}
+
+    void prepare (int windowSize, double sampleRate) override
+    {
+        multiPitchAnalyser.prepare (windowSize, sampleRate);
+    }
+
+    void processFrame (const AnalysisFrame& frame, AudioFeatures& features) override
+    {
+        const int maxNumPitches = multiPitchAnalyser.getMaxNumPitches();
+        jassert (features.getVectorFeatureSize (AudioFeatures::eVectorFeature::enPitches) == 2 * maxNumPitches);
+
+        multiPitchAnalyser.estimatePitches (frame.getPowerSpectrum(), frame.getNumBins(), frame.peaks);
+
+        const double f0NormalisationFactor = 5000.0;
+        const float* frequencies = multiPitchAnalyser.getFrequencies();
+        const float* saliences   = multiPitchAnalyser.getSaliences();
+        float* v = values.getData();
+
+        for (int pitch = 0; pitch < maxNumPitches; ++pitch)
+        {
+            v[2 * pitch]     = (float) (frequencies[pitch] / f0NormalisationFactor);
+            v[2 * pitch + 1] = saliences[pitch];
+        }
+
+        features.updateVectorFeature (AudioFeatures::eVectorFeature::enPitches, v);
+    }
+
+    /* No pitches: every slot is 0, 0. */
+    void processSilentFrame (const AnalysisFrame&, AudioFeatures& features) override
+    {
+        features.fillVectorFeature (AudioFeatures::eVectorFeature::enPitches, 0.0f);
+    }
+
+    bool usesSpectralPeaks() const override { return true; }
+
+    /* The analysis thread must be stopped, and the features' pitches size changed to 2 * maxNumPitches. */
+    void setConfiguration (int maxNumPitches, double minFrequency, double maxFrequency)
+    {
+        multiPitchAnalyser.setConfiguration (maxNumPitches, minFrequency, maxFrequency);
+        values.setSize (2 * maxNumPitches);
+    }
+
+    MultiPitchAnalyser& getMultiPitchAnalyser() { return multiPitchAnalyser; }
+private:
+    MultiPitchAnalyser multiPitchAnalyser;
+    AlignedFloatBuffer values;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (MultiPitchAnalysisStage)
 };
 
 #endif  // REALTIMEANALYSER_H_INCLUDED
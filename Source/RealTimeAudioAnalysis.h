@@ -98,12 +98,112 @@ public:
 //============================================================================================================================================================
 //============================================================================================================================================================
 
+/* 
+    A float array whose start is aligned for SIMD loads. Resizing allocates, so only do it while nothing 
+    is reading or writing the data.
+*/
+class AlignedFloatBuffer
+{
+public:
+    enum { alignmentBytes = 32 };
+
+    AlignedFloatBuffer (int numFloats = 0) { setSize (numFloats); }
+
+    /* Reallocates (and zeroes) the buffer if the size changes. */
+    void setSize (int numFloats)
+    {
+        if (numFloats == size)
+            return;
+
+        storage.calloc ((size_t) numFloats * sizeof (float) + alignmentBytes);
+        const pointer_sized_int address = (pointer_sized_int) storage.getData();
+        data = (float*) ((address + alignmentBytes - 1) & ~(pointer_sized_int) (alignmentBytes - 1));
+        size = numFloats;
+    }
+
+    void clear() noexcept { FloatVectorOperations::clear (data, size); }
+
+    float*       getData()       noexcept { return data; }
+    const float* getData() const noexcept { return data; }
+    int          getSize() const noexcept { return size; }
+
+private:
+    HeapBlock<char> storage;
+    float*          data { nullptr };
+    int             size { -1 };
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (AlignedFloatBuffer)
+};
+
+//============================================================================================================================================================
+//============================================================================================================================================================
+
+/*
+    Hands snapshots of a buffer from an analysis thread to the GUI without locks or allocation. The writer 
+    fills getWriteBuffer() and calls publish(), which swaps it with the shared middle buffer. The reader's 
+    getLatest() swaps the middle buffer for its own only if something new was published, so the writer 
+    never waits and the reader always gets a complete snapshot. setSize() allocates all three buffers, 
+    only call it while neither side is using them.
+*/
+class SnapshotTripleBuffer
+{
+public:
+    SnapshotTripleBuffer (int numChannels = 1, int numSamples = 0)
+    {
+        setSize (numChannels, numSamples);
+    }
+
+    void setSize (int numChannels, int numSamples)
+    {
+        for (auto& b : buffers)
+        {
+            b.setSize (numChannels, numSamples);
+            b.clear();
+        }
+
+        writeIndex = 0;
+        middle.set (1);
+        readIndex  = 2;
+    }
+
+    /* Writer thread only. */
+    AudioSampleBuffer& getWriteBuffer() noexcept { return buffers[writeIndex]; }
+
+    /* Writer thread only: makes the write buffer the latest snapshot. */
+    void publish() noexcept
+    {
+        writeIndex = middle.exchange (writeIndex | newSnapshotFlag) & indexMask;
+    }
+
+    /* Reader thread only: the latest complete snapshot. Stays valid and unchanged until the next call. */
+    const AudioSampleBuffer& getLatest() noexcept
+    {
+        if ((middle.get() & newSnapshotFlag) != 0)
+            readIndex = middle.exchange (readIndex) & indexMask;
+
+        return buffers[readIndex];
+    }
+
+private:
+    enum { indexMask = 3, newSnapshotFlag = 4 };
+
+    AudioSampleBuffer buffers[3];
+    Atomic<int>       middle;
+    int               writeIndex { 0 };
+    int               readIndex  { 2 };
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (SnapshotTripleBuffer)
+};
+
+//============================================================================================================================================================
+//============================================================================================================================================================
+
 class AudioFilter
 {
 public:
     AudioFilter() {}
 
-    void filterAudio (AudioSampleBuffer& bufferIn, AudioSampleBuffer& bufferOut)
+    void filterAudio (const AudioSampleBuffer& bufferIn, AudioSampleBuffer& bufferOut)
     {
         jassert (bufferIn.getNumChannels() == bufferOut.getNumChannels() && bufferIn.getNumSamples() == bufferOut.getNumSamples());
         const int numSamples  = bufferIn.getNumSamples();
@@ -133,23 +233,221 @@ private:
 //============================================================================================================================================================
 //============================================================================================================================================================
 
-class RealTimeWindower 
+/*
+    A precomputed analysis window. Tables are cached by shape and size, so every analyser using the same
+    window shares one table and windowing a frame is a single vector multiply instead of recomputing the
+    shape each hop. Windows are periodic (w[N] would equal w[0]), which is what overlapped FFT frames want.
+*/
+class WindowTable
 {
 public:
-    RealTimeWindower() {}
+    enum eShape
+    {
+        enBartlett = 0,
+        enHann,
+        enHamming,
+        enBlackmanHarris,
+        enKaiser,
+        numShapes
+    };
+
+    static String getName (eShape s)
+    {
+        switch (s)
+        {
+            case enBartlett:       return String ("Bartlett");
+            case enHann:           return String ("Hann");
+            case enHamming:        return String ("Hamming");
+            case enBlackmanHarris: return String ("Blackman-Harris");
+            case enKaiser:         return String ("Kaiser");
+            default:
+                jassertfalse;
+                return String ("UNKNOWN");
+        }
+    }
 
-    static void scaleBufferWithBartlettWindowing (AudioSampleBuffer& source) // in place
+    /* 
+        Returns the shared table for a shape and size, building it the first time it is asked for. This locks
+        and may allocate, so call it when a window size or shape changes, never from the analysis loop.
+    */
+    static const WindowTable& get (eShape shape, int size)
     {
-        int numSamples = source.getNumSamples();
-        
-        /* /\  <- very simple window shape */
-        for (int channel = 0; channel < source.getNumChannels(); ++channel)
+        static CriticalSection lock;
+        static OwnedArray<WindowTable> tables;
+
+        const ScopedLock sl (lock);
+
+        for (auto table : tables)
+            if (table->shape == shape && table->getSize() == size)
+                return *table;
+
+        return *tables.add (new WindowTable (shape, size));
+    }
+
+    /* Multiplies size samples in place. */
+    void apply (float* data) const noexcept
+    {
+        FloatVectorOperations::multiply (data, window.getData(), getSize());
+    }
+
+    void apply (AudioSampleBuffer& buffer) const noexcept
+    {
+        jassert (buffer.getNumSamples() == getSize());
+
+        for (int channel = 0; channel < buffer.getNumChannels(); ++channel)
+            apply (buffer.getWritePointer (channel));
+    }
+
+    eShape       getShape()      const noexcept { return shape; }
+    int          getSize()       const noexcept { return window.getSize(); }
+    const float* getData()       const noexcept { return window.getData(); }
+
+    /* The mean of the window: how much it scales the magnitude of a sinusoid's peak bin. */
+    double       getCoherentGain() const noexcept { return coherentGain; }
+
+    /* The mean of the squared window: how much it scales the power of broadband noise. */
+    double       getEnergyGain()   const noexcept { return energyGain; }
+
+    /* 
+        The feature thresholds were tuned on Bartlett windowed spectra. Scaling a power spectrum by this makes
+        a sinusoid's peak bin read the same through this window as it did through the Bartlett window.
+    */
+    float        getPowerCorrection() const noexcept
+    {
+        const double bartlettCoherentGain = 0.5;
+        const double amplitudeCorrection  = bartlettCoherentGain / coherentGain;
+        return (float) (amplitudeCorrection * amplitudeCorrection);
+    }
+
+private:
+    WindowTable (eShape s, int size)
+    :   shape  (s),
+        window (size)
+    {
+        float* w = window.getData();
+        const double n = (double) size;
+
+        for (int i = 0; i < size; ++i)
+            w[i] = (float) getValue (shape, i, size);
+
+        double sum = 0.0, sumOfSquares = 0.0;
+        for (int i = 0; i < size; ++i)
+        {
+            sum          += w[i];
+            sumOfSquares += w[i] * w[i];
+        }
+
+        coherentGain = size > 0 ? sum / n : 1.0;
+        energyGain   = size > 0 ? sumOfSquares / n : 1.0;
+    }
+
+    static double getValue (eShape shape, int i, int size)
+    {
+        const double phase = 2.0 * double_Pi * (double) i / (double) size;
+
+        switch (shape)
+        {
+            case enBartlett:
+            {
+                /* /\  <- matches the old pair of gain ramps sample for sample */
+                const int half = size / 2;
+                return i < half ? (double) i / (double) half : 1.0 - (double) (i - half) / (double) half;
+            }
+            case enHann:
+                return 0.5 - 0.5 * cos (phase);
+            case enHamming:
+                return 0.54 - 0.46 * cos (phase);
+            case enBlackmanHarris:
+                return 0.35875 - 0.48829 * cos (phase) + 0.14128 * cos (2.0 * phase) - 0.01168 * cos (3.0 * phase);
+            case enKaiser:
+            {
+                const double x = 2.0 * (double) i / (double) size - 1.0;
+                return besselI0 (kaiserBeta() * sqrt (1.0 - x * x)) / besselI0 (kaiserBeta());
+            }
+            default:
+                jassertfalse;
+                return 1.0;
+        }
+    }
+
+    /* Zeroth order modified Bessel function of the first kind, by its power series. */
+    static double besselI0 (double x)
+    {
+        const double quarterXSquared = 0.25 * x * x;
+        double term = 1.0, sum = 1.0;
+
+        for (int k = 1; k < 50 && term > sum * 1.0e-12; ++k)
         {
-            source.applyGainRamp (channel, 0, numSamples / 2, 0.0f, 1.0f);
-            source.applyGainRamp (channel, numSamples / 2, numSamples / 2, 1.0f, 0.0f);
+            term *= quarterXSquared / ((double) k * (double) k);
+            sum  += term;
         }
+
+        return sum;
     }
 
+    /* Sidelobes at about -63 dB (Hamming is -43, Blackman-Harris -92), with the first null about 3 bins out against Blackman-Harris's 4. */
+    static double kaiserBeta() { return 8.6; }
+
+    eShape             shape;
+    AlignedFloatBuffer window;
+    double             coherentGain { 1.0 };
+    double             energyGain   { 1.0 };
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (WindowTable)
+};
+
+//============================================================================================================================================================
+//============================================================================================================================================================
+
+/*
+    Applies the analysis window to each frame. The window's shape and size may only change while the
+    analysis thread is stopped, as they swap the shared table the windower points at.
+*/
+class RealTimeWindower 
+{
+public:
+    RealTimeWindower (WindowTable::eShape initialShape = WindowTable::enHann)
+    :   shape (initialShape)
+    {}
+
+    void setShape (WindowTable::eShape newShape)
+    {
+        shape = newShape;
+        updateTable();
+    }
+
+    void setWindowSize (int newWindowSize)
+    {
+        windowSize = newWindowSize;
+        updateTable();
+    }
+
+    WindowTable::eShape getShape() const { return shape; }
+
+    /* The table in use, or nullptr before setWindowSize() has been called. */
+    const WindowTable* getTable() const { return table; }
+
+    void applyWindow (AudioSampleBuffer& buffer) const // in place
+    {
+        jassert (table != nullptr && buffer.getNumSamples() == table->getSize());
+        table->apply (buffer);
+    }
+
+    static void scaleBufferWithBartlettWindowing (AudioSampleBuffer& source) // in place
+    {
+        WindowTable::get (WindowTable::enBartlett, source.getNumSamples()).apply (source);
+    }
+
+private:
+    void updateTable()
+    {
+        table = windowSize > 0 ? &WindowTable::get (shape, windowSize) : nullptr;
+    }
+
+    WindowTable::eShape shape;
+    int                 windowSize { 0 };
+    const WindowTable*  table      { nullptr };
+
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (RealTimeWindower)
 };
 
@@ -160,30 +458,47 @@ class RealTimeFFT
 {
 public:
     RealTimeFFT (int samplesPerWindow)
-    :   forwardFFT (int (log (samplesPerWindow) / log (2) + 1e-6), false),
-        inverseFFT (int (log (samplesPerWindow) / log (2) + 1e-6), true)
-    {}
+    {
+        setWindowSize (samplesPerWindow);
+    }
+
+    /* Not thread safe: only call this while nothing is performing transforms. */
+    void setWindowSize (int samplesPerWindow)
+    {
+        backend = FFTBackend::create (FFTBackend::getDefaultType(), samplesPerWindow);
+    }
 
     void performForward (float* timeData, const int size)
     {
-        jassert (size == forwardFFT.getSize() * 2);
-        forwardFFT.performRealOnlyForwardTransform (timeData);
+        jassert (size == backend->getSize() * 2);
+        backend->performRealForward (timeData);
+    }
+
+    void performInverse (float* frequencyData, const int size)
+    {
+        jassert (size == backend->getSize() * 2);
+        backend->performRealInverse (frequencyData);
     }
 
-    void performInverse (float* frequencyData, const int size) const
+    /* Like juce::FFT::performFrequencyOnlyForwardTransform: leaves the magnitudes of bins 0 to N / 2 at the start of data and zeros the rest. */
+    void performFrequencyOnlyForward (float* data, const int size)
     {
-        jassert (size == inverseFFT.getSize() * 2);
-        inverseFFT.performRealOnlyInverseTransform (frequencyData);
+        performForward (data, size);
+        const int fftSize = backend->getSize();
+
+        for (int bin = 0; bin <= fftSize / 2; ++bin)
+            data[bin] = std::sqrt (data[bin * 2] * data[bin * 2] + data[bin * 2 + 1] * data[bin * 2 + 1]);
+
+        FloatVectorOperations::clear (data + fftSize / 2 + 1, size - (fftSize / 2 + 1));
     }
 
     int getFFTExpectedSamples() const
     {
-        return forwardFFT.getSize();
+        return backend->getSize();
     }
 
 private:
-    FFT forwardFFT;
-    FFT inverseFFT;
+    ScopedPointer<FFTBackend> backend;
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (RealTimeFFT)
 
 };
@@ -191,52 +506,235 @@ private:
 //============================================================================================================================================================
 //============================================================================================================================================================
 
+/* 
+    The window sizes a track can frame its audio at. All resolutions are read from the same capture ring,
+    each at its own hop rate, so short windows can be used where time resolution matters (onsets) and long
+    ones where frequency resolution matters (pitch of low notes). Windows are defined in milliseconds, 
+    so they cover the same time at every sample rate, and rounded up to the nearest efficient FFT size.
+*/
+struct AnalysisResolution
+{
+    enum eResolution
+    {
+        enShort = 0,
+        enMedium,
+        enLong,
+        numResolutions
+    };
+
+    static double getWindowLengthMs (eResolution r)
+    {
+        switch (r)
+        {
+            case enShort:  return 10.0;
+            case enMedium: return 40.0;
+            case enLong:   return 160.0;
+            default:       jassertfalse; return 40.0;
+        }
+    }
+
+    /* Window sizes are multiples of this, so every overlap the GUI offers (up to 8 hops per window) divides them. */
+    static int getWindowSizeMultiple() { return 8; }
+
+    static int getWindowSize (eResolution r, double sampleRate)
+    {
+        return FFTBackend::getEfficientSize (roundToInt (getWindowLengthMs (r) * sampleRate / 1000.0), getWindowSizeMultiple());
+    }
+
+    static String getName (eResolution r) { return String (roundToInt (getWindowLengthMs (r))) + " ms"; }
+
+    /* The largest window of any resolution. Capture rings need to hold at least one hop of it. */
+    static int getMaxWindowSize (double sampleRate) { return getWindowSize (enLong, sampleRate); }
+};
+
+//============================================================================================================================================================
+//============================================================================================================================================================
+
 class RealTimeAudioDataOverlapper
 {
 public:
     RealTimeAudioDataOverlapper (int numChannels, int windowSize, AudioDataCollector& collector) 
     :   circleBuffer        (collector),
+        windowHistory       (numChannels, windowSize),
         overlappedAudio     (numChannels, windowSize),
+        bufferToDraw        (numChannels, windowSize),
         numSamplesPerWindow (windowSize)
     {
+        windowHistory.clear();
         overlappedAudio.clear();
+        setHopSize (numSamplesPerWindow / 2);
+        applyRequestedHopSize();
     }
 
-    AudioSampleBuffer& getNextBuffer()
+    /* 
+        Sets how many new samples each window advances by. The hop has to divide the window size, 
+        e.g. window / 2, / 4 and / 8 give 50%, 75% and 87.5% overlap. Safe to call from any thread, 
+        the analysis thread picks up the new hop size before its next hop.
+    */
+    void setHopSize (int newHopSize)
     {
-        const int halfWindowSize = numSamplesPerWindow / 2;
-        AudioSampleBuffer newDataBuffer = circleBuffer.getAnalysisBuffer (halfWindowSize);
-        jassert (numSamplesPerWindow % 2 == 0);
-        for (int c = 0; c < overlappedAudio.getNumChannels(); c++)
-        {
-            float* existingData = overlappedAudio.getWritePointer (c);            
-            //shift existing samples to the left
-            for (int sampleToShift = numSamplesPerWindow - 1; sampleToShift >= halfWindowSize; sampleToShift--)
-                existingData[sampleToShift - halfWindowSize] = existingData[sampleToShift];
+        jassert (newHopSize > 0 && numSamplesPerWindow % newHopSize == 0);
+
+        if (newHopSize <= 0 || numSamplesPerWindow % newHopSize != 0)
+            return;
+
+        requestedHopSize.set (newHopSize);
+        circleBuffer.setSamplesRequiredByReader (newHopSize);
+    }
+
+    int getWindowSize() const { return numSamplesPerWindow; }
+
+    /* 
+        Resizes the window, keeping the same proportion of overlap, and restarts it from silence. 
+        Only call this while the analysis thread is stopped. 
+    */
+    void setWindowSize (int newWindowSize)
+    {
+        const int hopsPerWindow = numSamplesPerWindow / requestedHopSize.get();
+        jassert (newWindowSize % hopsPerWindow == 0);
+
+        numSamplesPerWindow = newWindowSize;
+        windowHistory.setSize   (windowHistory.getNumChannels(), numSamplesPerWindow);
+        overlappedAudio.setSize (overlappedAudio.getNumChannels(), numSamplesPerWindow);
+        bufferToDraw.setSize    (overlappedAudio.getNumChannels(), numSamplesPerWindow);
+        windowHistory.clear();
+        overlappedAudio.clear();
+        circleBuffer.clearBuffer();
 
-            //copy new samples into the right
-            overlappedAudio.copyFrom (c, halfWindowSize, newDataBuffer, c, 0, halfWindowSize);
+        writeIndex        = 0;
+        windowEndPosition = -1;
+        hopSize           = 0;
+        setHopSize (jmax (1, numSamplesPerWindow / hopsPerWindow));
+        applyRequestedHopSize();
+    }
+
+    /* True once the collector holds enough new samples to advance the window by one hop. Analysis thread only. */
+    bool isNextBufferReady()
+    {
+        applyRequestedHopSize();
+        return circleBuffer.isAnalysisBufferReady (hopSize);
+    }
+
+    /* 
+        Advances the window by one hop and returns true, after which getWindow() holds the new window. The 
+        window is kept as a circular history, so each hop only writes its new samples (straight from the 
+        collector's ring) over the oldest ones, and the window is unrolled from the history with two block 
+        copies rather than shifting the whole window.
+
+        If the collector was cleared since isNextBufferReady() returned true there is no hop to read. Then
+        nothing changes and false is returned, and the caller should skip the frame.
+    */
+    bool readNextHop()
+    {
+        const AudioDataCollector::AnalysisBufferView newData = circleBuffer.getAnalysisBufferView (hopSize);
+
+        if (newData.getNumSamples() < hopSize)
+        {
+            circleBuffer.finishedReading (newData);
+            return false;
         }
+
+        //the hop divides the window, so the new samples never wrap around the end of the history
+        for (int c = 0; c < windowHistory.getNumChannels(); c++)
+            circleBuffer.copyViewWithGain (newData, windowHistory.getWritePointer (c, writeIndex));
+
+        circleBuffer.finishedReading (newData);
+        windowEndPosition = newData.startPosition + hopSize;
+
+        //refers to the new samples in place, so this doesn't allocate
+        float* newSamples[] = { windowHistory.getWritePointer (0, writeIndex) };
+        AudioSampleBuffer newSamplesBuffer (newSamples, 1, hopSize);
+        circleBuffer.updateBufferToDraw (newSamplesBuffer);
+
+        writeIndex += hopSize;
+
+        if (writeIndex == numSamplesPerWindow)
+            writeIndex = 0;
+
+        unrollWindowHistory();
         
         if (displayBufferNeedsUpdating.get() == 1)
         {
-            bufferToDraw = AudioSampleBuffer (overlappedAudio);
+            AudioSampleBuffer& snapshot = bufferToDraw.getWriteBuffer();
+
+            for (int c = 0; c < overlappedAudio.getNumChannels(); ++c)
+                snapshot.copyFrom (c, 0, overlappedAudio, c, 0, numSamplesPerWindow);
+
+            bufferToDraw.publish();
             displayBufferNeedsUpdating.set (0);
         }
 
-        return overlappedAudio;
+        return true;
+    }
+
+    /* The window as of the last hop readNextHop() read. Analysis thread only. */
+    const AudioSampleBuffer& getWindow() const { return overlappedAudio; }
+
+    /* 
+        The capture sample position at the centre of the window last read by readNextHop(),
+        or -1 before the first window. 
+    */
+    int64 getWindowCentrePosition() const
+    {
+        return windowEndPosition < 0 ? -1 : windowEndPosition - numSamplesPerWindow / 2;
     }
 
+    /* The capture sample position just after the window last read by readNextHop(), or -1 before the first window. */
+    int64 getWindowEndPosition() const { return windowEndPosition; }
+
+    /* The number of new samples in the window last read by readNextHop(). Analysis thread only. */
+    int getHopSize() const { return hopSize; }
+
     void enableBufferToDrawNeedsUpdating()     { displayBufferNeedsUpdating.set (1); }
 
-    const AudioSampleBuffer getBufferToDraw() { return AudioSampleBuffer (bufferToDraw); }
+    /* Message thread only: the window last requested by enableBufferToDrawNeedsUpdating(). */
+    const AudioSampleBuffer& getBufferToDraw() { return bufferToDraw.getLatest(); }
 
 private:
+    /* Copies the history into overlappedAudio in time order. The oldest sample is at writeIndex. */
+    void unrollWindowHistory()
+    {
+        const int numOldestSamples = numSamplesPerWindow - writeIndex;
+
+        for (int c = 0; c < windowHistory.getNumChannels(); c++)
+        {
+            overlappedAudio.copyFrom (c, 0, windowHistory, c, writeIndex, numOldestSamples);
+
+            if (writeIndex > 0)
+                overlappedAudio.copyFrom (c, numOldestSamples, windowHistory, c, 0, writeIndex);
+        }
+    }
+
+    void applyRequestedHopSize()
+    {
+        const int newHopSize = requestedHopSize.get();
+
+        if (newHopSize == hopSize)
+            return;
+
+        /* 
+            writeIndex is a multiple of the old hop size, which might not divide evenly into the new one, 
+            so restart the history from a time-ordered copy of the current window.
+        */
+        unrollWindowHistory();
+
+        for (int c = 0; c < windowHistory.getNumChannels(); c++)
+            windowHistory.copyFrom (c, 0, overlappedAudio, c, 0, numSamplesPerWindow);
+
+        writeIndex = 0;
+        hopSize    = newHopSize;
+    }
+
     AudioDataCollector& circleBuffer;
+    AudioSampleBuffer windowHistory;
     AudioSampleBuffer overlappedAudio;
-    AudioSampleBuffer bufferToDraw;
+    SnapshotTripleBuffer bufferToDraw;
     Atomic<int>       displayBufferNeedsUpdating;
+    Atomic<int>       requestedHopSize;
     int               numSamplesPerWindow;
+    int               hopSize           { 0 };
+    int               writeIndex        { 0 };
+    int64             windowEndPosition { -1 };
 
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (RealTimeAudioDataOverlapper)
 };
@@ -249,47 +747,259 @@ public:
     FFTAnalyser (int numSamplesPerWindow, double sampleRate) 
     :   fft     (numSamplesPerWindow),
         nyquist (sampleRate / 2.0)
-    {}
-
-    /* Be sure to filter / window the audio data as you require before hand */
-    AudioSampleBuffer getFrequencyData (AudioSampleBuffer& timeBuffer) 
     {
-        const int numChannels = timeBuffer.getNumChannels();
-        const int numSamples  = timeBuffer.getNumSamples();
+        setWindowSize (numSamplesPerWindow);
+    }
 
-        AudioSampleBuffer frequencyBuffer (timeBuffer);
+    /* Only call this while nothing is performing transforms, or reading the buffer to draw. */
+    void setWindowSize (int numSamplesPerWindow) 
+    { 
+        fft.setWindowSize (numSamplesPerWindow); 
+        spectrum.setSize (numSamplesPerWindow * 2);
+        fftBufferToDraw.setSize (1, numSamplesPerWindow * 2);
+    }
 
+    /* 
+        Transforms numSamples (the window size) of timeData in place in the analyser's spectrum, which then 
+        holds the interleaved complex bins. Doesn't allocate. Be sure to filter / window the audio data as you 
+        require before hand.
+    */
+    const float* computeSpectrum (const float* timeData, int numSamples) 
+    {
         const int numFFTElements = numSamples * 2;
-        frequencyBuffer.setSize (numChannels, numFFTElements, true, true, false);
-
-        for (int c = 0; c < numChannels; c++)
-        {
-            float* inOutData = frequencyBuffer.getWritePointer (c);
-            fft.performForward (inOutData, numFFTElements);
-        }
+        jassert (spectrum.getSize() == numFFTElements);
+
+        float* inOutData = spectrum.getData();
+        FloatVectorOperations::copy  (inOutData, timeData, numSamples);
+        FloatVectorOperations::clear (inOutData + numSamples, numSamples);
+        fft.performForward (inOutData, numFFTElements);
+        updateFFTBufferToDraw();
+        return inOutData;
+    }
 
+    /* Publishes the spectrum to the GUI if it has asked for it. Call this if the spectrum was written by something other than computeSpectrum(). */
+    void updateFFTBufferToDraw()
+    {
         if (fftDisplayBufferNeedsUpdating.get() == 1)
         {
-            fftBufferToDraw = AudioSampleBuffer (frequencyBuffer);
+            fftBufferToDraw.getWriteBuffer().copyFrom (0, 0, spectrum.getData(), spectrum.getSize());
+            fftBufferToDraw.publish();
             fftDisplayBufferNeedsUpdating.set (0);
         }
-
-        return frequencyBuffer;
     }
 
     void enableFFTBufferToDrawNeedsUpdating()     { fftDisplayBufferNeedsUpdating.set (1); }
     void setNyquistValue (double newValue)        { nyquist = newValue; }
 
-    const AudioSampleBuffer getFFTBufferToDraw() const { return AudioSampleBuffer (fftBufferToDraw); }
+    /* Message thread only: the spectrum last requested by enableFFTBufferToDrawNeedsUpdating(). */
+    const AudioSampleBuffer& getFFTBufferToDraw()      { return fftBufferToDraw.getLatest(); }
+
+    /* The interleaved complex bins from the last computeSpectrum(), getFFTExpectedSamples() * 2 floats. */
+    float*       getSpectrum()                         { return spectrum.getData(); }
+    const float* getSpectrum()                   const { return spectrum.getData(); }
     int getFFTExpectedSamples()                  const { return fft.getFFTExpectedSamples(); }
-    const RealTimeFFT& getFFTObject()            const { return fft; }
+    RealTimeFFT& getFFTObject()                        { return fft; }
     double getNyquist()                          const { return nyquist; }
 
 private:
-    RealTimeFFT       fft; 
-    AudioSampleBuffer fftBufferToDraw;
-    double            nyquist;
-    Atomic<int>       fftDisplayBufferNeedsUpdating;
+    RealTimeFFT          fft; 
+    AlignedFloatBuffer   spectrum;
+    SnapshotTripleBuffer fftBufferToDraw;
+    double               nyquist;
+    Atomic<int>          fftDisplayBufferNeedsUpdating;
+};
+
+//============================================================================================================================================================
+//============================================================================================================================================================
+
+/*
+    The local maxima of a spectrum, in ascending order. A bin is a peak if it is above the frame's mean and
+    higher than the two bins either side, so the threshold adapts to each frame's level. The test is a
+    branch-free pass over every bin that writes a mask, which the compiler vectorises, and only the bins
+    it marks are gathered. Each peak is then interpolated between bins by fitting a parabola to the log
+    of the peak bin and its neighbours (exact for a Gaussian main lobe, and close for the usual windows),
+    which gives its frequency and height to a fraction of a bin.
+*/
+class SpectralPeaks
+{
+public:
+    struct Peak
+    {
+        int   bin;        // the peak bin
+        float position;   // the interpolated position, in bins
+        float frequency;  // position * bin width, in Hz
+        float value;      // the interpolated height, in the units of the spectrum it was found in
+    };
+
+    SpectralPeaks (int numBins = 0) { setSize (numBins); }
+
+    /* Allocates, so only call this while nothing is finding or reading peaks. */
+    void setSize (int numBins)
+    {
+        mask.setSize (numBins);
+        peaks.resize ((size_t) jmax (0, numBins / 3 + 1));
+        numPeaks = 0;
+    }
+
+    /* Finds the peaks of numBins values (power or magnitude) whose bins are binWidth Hz apart. Doesn't allocate. */
+    void findPeaks (const float* spectrum, int numBins, double binWidth) noexcept
+    {
+        jassert (numBins <= mask.getSize());
+        numPeaks = 0;
+
+        if (numBins < 5)
+            return;
+
+        const float* __restrict x = spectrum;
+        float* __restrict       m = mask.getData();
+
+        /* summed in eight lanes, so the compiler can vectorise it without being allowed to reorder float adds */
+        float sums[8] = { 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f };
+        const int numBlocks = numBins / 8;
+        for (int block = 0; block < numBlocks; ++block)
+            for (int lane = 0; lane < 8; ++lane)
+                sums[lane] += x[block * 8 + lane];
+
+        double sum = 0.0;
+        for (int lane = 0; lane < 8; ++lane)
+            sum += (double) sums[lane];
+        for (int bin = numBlocks * 8; bin < numBins; ++bin)
+            sum += (double) x[bin];
+
+        const float threshold = (float) (sum / (double) numBins);
+
+        /* peaks need two bins either side, and the first of a flat top wins */
+        for (int bin = 2; bin < numBins - 2; ++bin)
+        {
+            const float centre = x[bin];
+            const bool  isPeak = (centre > threshold) & (centre > x[bin - 1]) & (centre > x[bin - 2])
+                                                      & (centre >= x[bin + 1]) & (centre >= x[bin + 2]);
+            m[bin] = isPeak ? 1.0f : 0.0f;
+        }
+
+        for (int bin = 2; bin < numBins - 2; ++bin)
+        {
+            if (m[bin] == 0.0f)
+                continue;
+
+            /* the neighbours' logs relative to the peak bin's, which is above both, so the fit needs two logs */
+            const float centre = x[bin];
+            const float left   = std::log (jmax (x[bin - 1], logFloor()) / centre);
+            const float right  = std::log (jmax (x[bin + 1], logFloor()) / centre);
+            const float denominator = left + right;
+            const float offset      = denominator < 0.0f ? jlimit (-0.5f, 0.5f, 0.5f * (left - right) / denominator) : 0.0f;
+
+            Peak& peak     = peaks[(size_t) numPeaks++];
+            peak.bin       = bin;
+            peak.position  = (float) bin + offset;
+            peak.frequency = (float) ((double) peak.position * binWidth);
+            peak.value     = centre * std::exp (-0.25f * (left - right) * offset);
+        }
+    }
+
+    /* The highest peak within radius bins of position, or nullptr if there isn't one. */
+    const Peak* findHighestPeakNear (double position, double radius) const noexcept
+    {
+        const Peak* p = std::lower_bound (begin(), end(), position - radius,
+                                          [] (const Peak& peak, double lowest) { return (double) peak.position < lowest; });
+        const Peak* highest = nullptr;
+
+        for (; p != end() && (double) p->position <= position + radius; ++p)
+            if (highest == nullptr || p->value > highest->value)
+                highest = p;
+
+        return highest;
+    }
+
+    int         size()  const noexcept { return numPeaks; }
+    const Peak* begin() const noexcept { return peaks.data(); }
+    const Peak* end()   const noexcept { return peaks.data() + numPeaks; }
+
+private:
+    /* keeps log() finite for empty bins */
+    static float logFloor() { return 1.0e-30f; }
+
+    AlignedFloatBuffer mask;
+    std::vector<Peak>  peaks;  // room for the most peaks numBins can hold, one in every three bins
+    int                numPeaks { 0 };
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (SpectralPeaks)
+};
+
+//============================================================================================================================================================
+//============================================================================================================================================================
+
+/*
+    Everything calculated from one analysis window: the window itself, its windowed spectrum and power 
+    spectrum (and the power spectrum's peaks, if a stage uses them). An analyser computes a frame once per hop and hands it read-only to every feature stage
+    running at its resolution, so no stage needs to transform the same audio again.
+*/
+struct AnalysisFrame
+{
+    AnalysisFrame (int windowSize)
+    {
+        setWindowSize (windowSize);
+    }
+
+    void setWindowSize (int windowSize)
+    {
+        windowedAudio.setSize (1, windowSize);
+        powerSpectrum.setSize (windowSize / 2);
+        magnitudeSpectrum.setSize (windowSize / 2);
+        peaks.setSize (windowSize / 2);
+        audio          = nullptr;
+        spectrum       = nullptr;
+        samplePosition = -1;
+    }
+
+    /* Fills the power and magnitude spectra from the complex spectrum, corrected for the window's gain. */
+    void updatePowerSpectrum()
+    {
+        computePowerAndMagnitude (spectrum, powerSpectrum.getData(), magnitudeSpectrum.getData(), getNumBins(), powerSpectrumScale);
+    }
+
+    /* 
+        De-interleaves numBins complex bins into contiguous power (|X[k]|^2 * powerScale) and magnitude 
+        (the square root of that) arrays. Written as plain unit-stride loops so the compiler vectorises them.
+    */
+    static void computePowerAndMagnitude (const float* __restrict complexData, float* __restrict powerData, 
+                                          float* __restrict magnitudeData, int numBins, float powerScale) noexcept
+    {
+        for (int bin = 0; bin < numBins; ++bin)
+        {
+            const float re = complexData[bin * 2];
+            const float im = complexData[bin * 2 + 1];
+            powerData[bin] = (re * re + im * im) * powerScale;
+        }
+
+        for (int bin = 0; bin < numBins; ++bin)
+            magnitudeData[bin] = std::sqrt (powerData[bin]);
+    }
+
+    /* Finds the power spectrum's peaks. Only called by analysers with a stage that uses them. */
+    void updatePeaks()
+    {
+        peaks.findPeaks (getPowerSpectrum(), getNumBins(), getBinWidth());
+    }
+
+    int          getNumBins()           const { return powerSpectrum.getSize(); }
+    const float* getPowerSpectrum()     const { return powerSpectrum.getData(); }
+    const float* getMagnitudeSpectrum() const { return magnitudeSpectrum.getData(); }
+    double       getBinWidth()          const { return nyquist / (double) getNumBins(); }
+
+    const AudioSampleBuffer* audio { nullptr };  // the overlapped (unwindowed) window, owned by the overlapper
+    AudioSampleBuffer        windowedAudio;
+    const float*             spectrum { nullptr };  // interleaved complex bins, owned by the analyser's FFTAnalyser
+    AlignedFloatBuffer       powerSpectrum;      // |X[k]|^2 for the bins below nyquist
+    AlignedFloatBuffer       magnitudeSpectrum;  // |X[k]|, the square root of powerSpectrum
+    SpectralPeaks            peaks;              // the power spectrum's peaks, if a stage uses them
+    float                    powerSpectrumScale { 1.0f }; // the window's WindowTable::getPowerCorrection()
+    float                    rms            { 0.0f };
+    float                    logRMS         { 0.0f };
+    double                   nyquist        { 24000.0 };
+    int64                    samplePosition { -1 };
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (AnalysisFrame)
 };
 
 
@@ -13,12 +13,13 @@
 
 struct SpectralCharacteristics
 {
-    SpectralCharacteristics (float sCentroid, float sSpread, float sFlatness, float sLER, float sFlux)
+    SpectralCharacteristics (float sCentroid, float sSpread, float sFlatness, float sLER, float sFlux, float sSlope)
     :   centroid (sCentroid),
         spread   (sSpread),
         flatness (sFlatness),
         ler      (sLER),
-        flux     (sFlux)
+        flux     (sFlux),
+        slope    (sSlope)
     {}
         
     float centroid;
@@ -26,181 +27,246 @@ struct SpectralCharacteristics
     float flatness;
     float ler;
     float flux;
+    float slope;
 };
 
+/*
+    Calculates every spectral descriptor from one pass over the power spectrum. The pass accumulates a few
+    partial sums (the spectrum's moments, its log sum for flatness, rectified flux against the previous 
+    frame) and each descriptor is then a closed-form combination of those sums.
+*/
 class SpectralCharacteristicsAnalyser
 {
 public:
     SpectralCharacteristicsAnalyser (int numSamplesPerWindow) 
     {
-        for (int i = 0; i < numSamplesPerWindow / 2; i++)
-            previousBinMagnitudes.push_back (0.0f);
+        setWindowSize (numSamplesPerWindow);
+    }
+
+    /* Resets the flux history to match a new window size. */
+    void setWindowSize (int numSamplesPerWindow)
+    {
+        previousBinMagnitudes.setSize (numSamplesPerWindow / 2);
+        previousBinMagnitudes.clear();
     }
 
-    struct IntermediateSpectralCharacteristics
+    /* 
+        The sums a descriptor pass accumulates. Each is kept in numLanes interleaved partial sums, which lets 
+        the compiler vectorise the pass without reassociating floating point maths (and keeps the float sums 
+        accurate, as each lane only adds up every numLanes'th bin). The moments about bin 0 are kept in double, 
+        as central moments are recovered from them by subtraction. The extended sums are only accumulated when 
+        asked for, for the ExtendedSpectralCharacteristicsAnalyser.
+    */
+    struct PartialSums
     {
-        IntermediateSpectralCharacteristics (size_t numMagnitudes) : binCentreFrequencies (numMagnitudes),
-                                                                     binMagnitudes        (numMagnitudes)
-        {}
-
-        double weightedMagnitudeSum = 0.0;
-        double varMagnitudeSum      = 0.0;
-        double magnitudeSum         = 0.0;
-        double magnitudeProduct     = 1.0;
-        double flatnessMagnitudeSum = 0.0;
-        double flux                 = 0.0;
-        double lhr                  = 0.0;
-        double numMagnitudesUsedInFlatnessCalculation = 0.0;
-        std::vector<double> binCentreFrequencies;
-        std::vector<double> binMagnitudes;
-
-        float calculateFlatness (double eps, double invNumMagnitudes)
+        enum { numLanes = 8 };
+
+        float  sum                [numLanes];  // sum of p[k]
+        double weightedSum        [numLanes];  // sum of k * p[k]
+        double squaredSum         [numLanes];  // sum of k^2 * p[k]
+        float  powerSquaredSum    [numLanes];  // sum of p[k]^2
+        float  flux               [numLanes];  // sum of max (p[k] - previous[k], 0)
+        float  maximum            [numLanes];
+        float  logSum             [numLanes];  // sum of log (p[k]) over the bins above the flatness threshold
+        float  entropySum         [numLanes];  // sum of p[k] * log (p[k]) over the bins above the flatness threshold
+        float  flatnessSum        [numLanes];  // sum of p[k] over the bins above the flatness threshold
+        float  numFlatnessBins    [numLanes];
+
+        /* extended sums */
+        double cubedSum           [numLanes];  // sum of k^3 * p[k]
+        double fourthPowerSum     [numLanes];  // sum of k^4 * p[k]
+        float  inverseWeightedSum [numLanes];  // sum of p[k] / k, for k > 0
+
+        void reset() noexcept
         {
-            return flatnessMagnitudeSum > eps ? (float) (pow (magnitudeProduct, invNumMagnitudes) / (invNumMagnitudes * flatnessMagnitudeSum)) : 0.0f;
+            for (int lane = 0; lane < numLanes; ++lane)
+            {
+                sum[lane] = powerSquaredSum[lane] = flux[lane] = maximum[lane] = 0.0f;
+                logSum[lane] = entropySum[lane] = flatnessSum[lane] = numFlatnessBins[lane] = inverseWeightedSum[lane] = 0.0f;
+                weightedSum[lane] = squaredSum[lane] = cubedSum[lane] = fourthPowerSum[lane] = 0.0;
+            }
         }
 
-        void fillIntermediateValues (AudioSampleBuffer& fftResults, std::vector<double>& previousBinMags, int channel, int numMagnitudes, double eps, double nyquist)
+        /* Accumulates bins [startBin, endBin), overwriting previous with this frame's spectrum as it goes. */
+        template <bool includeExtendedSums>
+        void accumulate (const float* __restrict p, float* __restrict previous, int startBin, int endBin, float flatnessThreshold) noexcept
         {
-            double frequencyRangePerBin = nyquist / numMagnitudes;
-            int lowerPortion = numMagnitudes / 5;
-            for (size_t magnitude = 0; magnitude < (size_t) numMagnitudes; magnitude++)
+            int bin = startBin;
+
+            for (; bin + numLanes <= endBin; bin += numLanes)
             {
-                int fftIndex = magnitude * 2;
-
-                double binCentreFrequency = double(magnitude) * frequencyRangePerBin + (frequencyRangePerBin / 2.0);
-                binCentreFrequencies[magnitude] = binCentreFrequency;
-                double binValue = (double) fftResults.getSample (channel, (int)fftIndex);
-                double binMagnitude = binValue * binValue;
-
-                /*flux*/
-                double diff = abs (binMagnitude) - abs (previousBinMags[magnitude]);
-                double rectifiedDiff = (diff + abs (diff)) / 2.0;
-                if (diff > 0.0)
-                    flux += rectifiedDiff;
-                ///////
-            
-                binMagnitudes[magnitude] = binMagnitude;
-            
-                magnitudeSum += binMagnitude;
-            
-                if (magnitude == lowerPortion)
-                    lhr = magnitudeSum;
-
-                if (binMagnitude > eps)
-                {
-                    flatnessMagnitudeSum += binMagnitude;
-                    magnitudeProduct     *= binMagnitude;
-                    numMagnitudesUsedInFlatnessCalculation ++;
-                }
-                weightedMagnitudeSum += binCentreFrequency * binMagnitude;
+                for (int lane = 0; lane < numLanes; ++lane)
+                    accumulateBin<includeExtendedSums> (lane, bin + lane, p, previous);
+
+                /* std::log doesn't vectorise, so flatness gets its own (still fused) loop over the block */
+                for (int lane = 0; lane < numLanes; ++lane)
+                    accumulateFlatness (lane, p[bin + lane], flatnessThreshold);
             }
-        }
-    };
 
-    SpectralCharacteristics calculateSpectralCharacteristics (AudioSampleBuffer& fftResults, double rms, int channel, double nyquist)
-    {
-        jassert (fftResults.getNumSamples() % 2 == 0);
-        const int numFFTElements    = (int) fftResults.getNumSamples() / 2;
-        const int numMagnitudes     = (int) numFFTElements / 2;
-        double frequencyRangePerBin = nyquist / numMagnitudes;
-        IntermediateSpectralCharacteristics intermediates (numMagnitudes);
-        jassert (previousBinMagnitudes.size() == intermediates.binMagnitudes.size());
-        double eps = 0.01 * rms;
-        intermediates.fillIntermediateValues (fftResults, previousBinMagnitudes, channel, numMagnitudes, eps, nyquist);
-        
-        float maxFlux = (numMagnitudes * (numMagnitudes + 1)) / 2.0f;
-        intermediates.flux /= maxFlux;
-        return calculateSpectralCharacteristicsFromIntermediates (intermediates, eps, nyquist, numMagnitudes);
-    }
+            for (int lane = 0; bin < endBin; ++bin, ++lane)
+            {
+                accumulateBin<includeExtendedSums> (lane, bin, p, previous);
+                accumulateFlatness (lane, p[bin], flatnessThreshold);
+            }
+        }
 
-    SpectralCharacteristics calculateSpectralCharacteristicsFromIntermediates (IntermediateSpectralCharacteristics intermediates, 
-                                                                               double eps,
-                                                                               double nyquist,
-                                                                               int numMagnitudes)
-    {
-        double epsSum = 0.05;
-        if (!(intermediates.magnitudeSum > epsSum))
-            return {0.0f, 0.0f, 0.0f, 0.0f, 0.0f};
+        template <typename FloatType>
+        static double total (const FloatType* lanes)
+        {
+            double t = 0.0;
+            for (int lane = 0; lane < numLanes; ++lane)
+                t += (double) lanes[lane];
+            return t;
+        }
 
-        intermediates.lhr /= intermediates.magnitudeSum;
+        static double largest (const float* lanes)
+        {
+            return (double) FloatVectorOperations::findMaximum (lanes, numLanes);
+        }
 
-        float centroid = (float) (intermediates.weightedMagnitudeSum / intermediates.magnitudeSum);
-        
-        const double flatnessMags = intermediates.numMagnitudesUsedInFlatnessCalculation;
-        double invNumMagnitudes = 1.0 / (flatnessMags > 0.0 ? flatnessMags : 1.0);
-        float flatness = intermediates.calculateFlatness (eps, invNumMagnitudes);
-        float logFlatness = log10 (flatness * 9.0 + 1.0);
-        float c = centroid / (float)(nyquist / 2.0);
-        float logCentroid = log10 (c * 9.0f + 1.0f);
-        for (size_t i = 0; i < (size_t) numMagnitudes; ++i)
+    private:
+        template <bool includeExtendedSums>
+        inline void accumulateBin (int lane, int bin, const float* __restrict p, float* __restrict previous) noexcept
         {
-            intermediates.varMagnitudeSum += pow ((intermediates.binCentreFrequencies[i] / nyquist) - (centroid / nyquist), 2.0) * intermediates.binMagnitudes[i];
-            previousBinMagnitudes[i] = intermediates.binMagnitudes[i];
+            const float  k    = (float) bin;
+            const float  x    = p[bin];
+            const double kx   = (double) k * (double) x;
+            const float  diff = x - previous[bin];
+            previous[bin]     = x;
+
+            sum[lane]             += x;
+            weightedSum[lane]     += kx;
+            squaredSum[lane]      += kx * k;
+            powerSquaredSum[lane] += x * x;
+            flux[lane]            += diff > 0.0f ? diff : 0.0f;
+            maximum[lane]          = x > maximum[lane] ? x : maximum[lane];
+
+            if (includeExtendedSums)
+            {
+                cubedSum[lane]           += kx * k * k;
+                fourthPowerSum[lane]     += kx * k * k * k;
+                inverseWeightedSum[lane] += bin > 0 ? x / k : 0.0f;
+            }
         }
-        float maxSpread = (float) ((centroid / nyquist) * (1.0 - (centroid / nyquist)));
-        float spread = (float) ((intermediates.varMagnitudeSum / intermediates.magnitudeSum) / maxSpread);
-        return {logCentroid, spread, logFlatness, (float) intermediates.lhr, (float) intermediates.flux};
-    }
 
-    float calculateNormalisedSpectralSlope (AudioSampleBuffer& fftResults, int channel)
-    {
-        //calc means
-        const int numFFTElements = (int) fftResults.getNumSamples() / 2;
-        const int numMagnitudes  = numFFTElements / 2;
-        double meanBin = 0.5;
-        double meanEnergy = 0.0;
-        double prodSum = 0.0;
-        double maxFFTMagnitude = fftResults.getMagnitude (channel, 0, numMagnitudes);
-        std::vector<double> binMagnitudes ((size_t)numMagnitudes);
-
-        for (int i = 0; i < numMagnitudes; i++)
+        inline void accumulateFlatness (int lane, float x, float flatnessThreshold) noexcept
         {
-            double binValue = fftResults.getSample (channel, i * 2);
-            double binMagnitude = binValue * binValue;
-            binMagnitudes[i] = binMagnitude;
-            if (binMagnitude > maxFFTMagnitude)
-                maxFFTMagnitude = binMagnitude;
+            if (x > flatnessThreshold)
+            {
+                const float logX = std::log (x);
+                logSum[lane]          += logX;
+                entropySum[lane]      += x * logX;
+                flatnessSum[lane]     += x;
+                numFlatnessBins[lane] += 1.0f;
+            }
         }
+    };
 
-        double eps = 0.0001;
-        if (! (maxFFTMagnitude > eps))
-            return 0.0f;
-        
-        for (int i = 0; i < (int) numMagnitudes; i++)
+    /* 
+        powerSpectrum holds numMagnitudes bins, from 0 Hz up to (but not including) nyquist. If includeExtendedSums 
+        is true the pass also accumulates the sums the extended descriptors need, see getPartialSums().
+    */
+    SpectralCharacteristics calculateSpectralCharacteristics (const float* powerSpectrum, int numMagnitudes, double rms, double nyquist, 
+                                                              bool includeExtendedSums = false)
+    {
+        jassert (previousBinMagnitudes.getSize() == numMagnitudes);
+        const double eps = 0.01 * rms;
+
+        /* The low energy ratio is the share of energy up to and including bin numMagnitudes / 5, so the pass is split there. */
+        const int lowerPortion = numMagnitudes / 5;
+        PartialSums& sums = partialSums;
+        sums.reset();
+        double lowerSum = 0.0;
+
+        if (includeExtendedSums)
         {
-            double binMagnitude = binMagnitudes[i];
-            double normedEnergy = binMagnitude / maxFFTMagnitude;
-            jassert (normedEnergy >= 0.0 && normedEnergy <= 1.0);
-            meanEnergy += normedEnergy;
-            prodSum += (double)i * normedEnergy;
+            sums.accumulate<true> (powerSpectrum, previousBinMagnitudes.getData(), 0, lowerPortion + 1, (float) eps);
+            lowerSum = PartialSums::total (sums.sum);
+            sums.accumulate<true> (powerSpectrum, previousBinMagnitudes.getData(), lowerPortion + 1, numMagnitudes, (float) eps);
         }
-        meanEnergy /= (double) numMagnitudes;
-        
-        //calc std devs
-        double binVar = 0.0;
-        double energyVar = 0.0;
-        for (double i = 0.0; i < numMagnitudes; i++)
+        else
         {
-            double normedI = i / (double) numMagnitudes;
-            binVar += (normedI - meanBin) * (normedI - meanBin);
-            double normedEnergy = binMagnitudes[(int)i] / maxFFTMagnitude;
-            energyVar += (normedEnergy - meanEnergy) * (normedEnergy - meanEnergy);
+            sums.accumulate<false> (powerSpectrum, previousBinMagnitudes.getData(), 0, lowerPortion + 1, (float) eps);
+            lowerSum = PartialSums::total (sums.sum);
+            sums.accumulate<false> (powerSpectrum, previousBinMagnitudes.getData(), lowerPortion + 1, numMagnitudes, (float) eps);
         }
-        binVar /= (double) numMagnitudes;
-        energyVar /= (double) numMagnitudes;
-        double binStd = sqrt (binVar);
-        double energyStd = sqrt (energyVar);
-        
-        //calculate sample correlation coefficient
-        double rMagBin = (prodSum - (numMagnitudes * meanEnergy * meanBin)) / (numMagnitudes - 1.0f) * energyStd * binStd;
-        
-        //calculate gradient of best fit
-        double grad = rMagBin * (binStd / energyStd);
-        return (float) grad;
+
+        const double n            = (double) numMagnitudes;
+        const double magnitudeSum = PartialSums::total (sums.sum);
+        const float  slope        = calculateNormalisedSpectralSlope (sums, numMagnitudes);
+
+        const double maxFlux = (n * (n + 1.0)) / 2.0;
+        const double flux    = PartialSums::total (sums.flux) / maxFlux;
+
+        double epsSum = 0.05;
+        if (!(magnitudeSum > epsSum))
+            return {0.0f, 0.0f, 0.0f, 0.0f, 0.0f, slope};
+
+        const double lhr = lowerSum / magnitudeSum;
+
+        /* centroid and spread, from the first and second moments about bin 0 */
+        const double meanBin        = PartialSums::total (sums.weightedSum) / magnitudeSum;
+        const double meanSquaredBin = PartialSums::total (sums.squaredSum)  / magnitudeSum;
+        const double binVariance    = jmax (0.0, meanSquaredBin - meanBin * meanBin);
+        const double centroid       = meanBin * (nyquist / n);
+        const double normalisedCentroid = centroid / nyquist;
+        const double normalisedVariance = binVariance / (n * n);
+
+        /* flatness: the geometric mean over the arithmetic mean, with the geometric mean taken in the log domain */
+        const double flatnessBins = PartialSums::total (sums.numFlatnessBins);
+        const double flatnessSum  = PartialSums::total (sums.flatnessSum);
+        double flatness = 0.0;
+        if (flatnessBins > 0.0 && flatnessSum > eps)
+            flatness = exp (PartialSums::total (sums.logSum) / flatnessBins) / (flatnessSum / flatnessBins);
+
+        float logFlatness = (float) log10 (flatness * 9.0 + 1.0);
+        float c = (float) (centroid / (nyquist / 2.0));
+        float logCentroid = log10 (c * 9.0f + 1.0f);
+        float maxSpread = (float) (normalisedCentroid * (1.0 - normalisedCentroid));
+        float spread = (float) (normalisedVariance / maxSpread);
+        return {logCentroid, spread, logFlatness, (float) lhr, (float) flux, slope};
     }
 
+    /* The sums accumulated by the last call to calculateSpectralCharacteristics(). */
+    const PartialSums& getPartialSums() const { return partialSums; }
+
+    /* Forgets the previous frame's spectrum, so the next flux is measured against silence. */
+    void clearPreviousSpectrum() { previousBinMagnitudes.clear(); }
+
 private:
-    std::vector<double> previousBinMagnitudes;
+    /* 
+        The gradient of the line of best fit through the max-normalised spectrum, over bin positions normalised 
+        to [0, 1). The correlation's energy deviation cancels out of the gradient, leaving only sums the 
+        descriptor pass has already made.
+    */
+    static float calculateNormalisedSpectralSlope (const PartialSums& sums, int numMagnitudes)
+    {
+        const double maxFFTMagnitude = PartialSums::largest (sums.maximum);
+
+        double eps = 0.0001;
+        if (! (maxFFTMagnitude > eps) || numMagnitudes < 2)
+            return 0.0f;
+
+        const double n          = (double) numMagnitudes;
+        const double meanBin    = 0.5;
+        const double meanEnergy = PartialSums::total (sums.sum) / (maxFFTMagnitude * n);
+        const double prodSum    = PartialSums::total (sums.weightedSum) / maxFFTMagnitude;
+
+        /* a flat spectrum has no energy deviation to fit a line to */
+        const double energyVar  = PartialSums::total (sums.powerSquaredSum) / (maxFFTMagnitude * maxFFTMagnitude * n) - meanEnergy * meanEnergy;
+        if (! (energyVar > 0.0))
+            return 0.0f;
+
+        /* the variance of i / n for i in [0, n), about 0.5 */
+        const double binVar = (n - 1.0) * (2.0 * n - 1.0) / (6.0 * n * n) - (n - 1.0) / (2.0 * n) + 0.25;
+
+        //sample correlation coefficient times the ratio of deviations
+        double grad = (prodSum - (n * meanEnergy * meanBin)) / (n - 1.0) * binVar;
+        return (float) grad;
+    }
+
+    AlignedFloatBuffer previousBinMagnitudes;
+    PartialSums        partialSums;
 
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (SpectralCharacteristicsAnalyser)
 };
@@ -25,9 +25,14 @@
 
 
 #include "AudioDataCollector.h"
+#include "FFTBackend.h"
 #include "RealTimeAudioAnalysis.h"
 #include "PitchAnalyser.h"
 #include "SpectralCharacteristics.h"
+#include "ExtendedSpectralCharacteristics.h"
+#include "MFCCAnalyser.h"
+#include "ChromaAnalyser.h"
+#include "MultiPitchAnalyser.h"
 #include "HarmonicCharacteristics.h"
 #include "AudioFeatures.h"
 #include "AudioAnalysis.h"
@@ -0,0 +1,547 @@
+/*
+  ==============================================================================
+
+    CaptureTests.cpp
+    Created: 21 Nov 2016 4:10:38pm
+    Author:  Sean
+
+  ==============================================================================
+*/
+
+#include "TestIncludes.h"
+
+//==============================================================================
+/*
+    Reads hops through an overlapper while the capture ring is written in device sized blocks, as the
+    audio and analysis threads do. Once the window has filled, no hop should allocate.
+*/
+class CaptureAllocationTest : public UnitTest
+{
+public:
+    CaptureAllocationTest() : UnitTest ("Capture read path allocations") {}
+
+    static int ringSize()    noexcept { return 8192; }
+    static int blockSize()   noexcept { return 256; }
+    static int windowSize()  noexcept { return 1920; }
+    static int hopSize()     noexcept { return windowSize() / 4; }
+    static int numHops()     noexcept { return 1000; }
+
+    void runTest() override
+    {
+        AudioCaptureRing ring (ringSize());
+        ring.addReader();
+        AudioDataCollector collector (ring);
+        RealTimeAudioDataOverlapper overlapper (1, windowSize(), collector);
+        overlapper.setHopSize (hopSize());
+
+        HeapBlock<float> block ((size_t) blockSize());
+
+        for (int i = 0; i < blockSize(); ++i)
+            block[i] = std::sin (0.05f * (float) i);
+
+        readHops (ring, overlapper, block, windowSize() / hopSize());
+
+        beginTest ("Hops at a constant gain");
+        {
+            const int64 numAllocationsBefore = getNumAllocations();
+            readHops (ring, overlapper, block, numHops());
+            expectEquals (getNumAllocations() - numAllocationsBefore, (int64) 0);
+        }
+
+        beginTest ("Hops with the gain ramping");
+        {
+            const int64 numAllocationsBefore = getNumAllocations();
+
+            for (int hop = 0; hop < numHops(); ++hop)
+            {
+                collector.setGain (hop % 2 == 0 ? 0.5f : 1.0f);
+                readHops (ring, overlapper, block, 1);
+            }
+
+            expectEquals (getNumAllocations() - numAllocationsBefore, (int64) 0);
+        }
+
+        expectEquals (collector.getStats().numOverruns, (int64) 0);
+    }
+
+private:
+    void readHops (AudioCaptureRing& ring, RealTimeAudioDataOverlapper& overlapper, const float* block, int numHopsToRead)
+    {
+        for (int hop = 0; hop < numHopsToRead; ++hop)
+        {
+            while (! overlapper.isNextBufferReady())
+                ring.write (block, blockSize());
+
+            overlapper.readNextHop();
+        }
+    }
+};
+
+static CaptureAllocationTest captureAllocationTest;
+
+//==============================================================================
+/*
+    Writes the ring with a ramp of each sample's capture position, so every sample read back shows where 
+    it came from.
+*/
+class OverlapperTest : public UnitTest
+{
+public:
+    OverlapperTest() : UnitTest ("Overlapper hops") {}
+
+    static int ringSize()    noexcept { return 8192; }
+    static int blockSize()   noexcept { return 256; }
+    static int windowSize()  noexcept { return 1920; }
+    static int hopSize()     noexcept { return windowSize() / 4; }
+
+    void runTest() override
+    {
+        AudioCaptureRing ring (ringSize());
+        ring.addReader();
+        AudioDataCollector collector (ring);
+        RealTimeAudioDataOverlapper overlapper (1, windowSize(), collector);
+        overlapper.setHopSize (hopSize());
+
+        beginTest ("Each hop ends the window at the newest sample read");
+
+        for (int hop = 0; hop < 8; ++hop)
+        {
+            writeUntilReady (ring, overlapper);
+            expect (overlapper.readNextHop());
+            expectWindowEndsAt (overlapper, (hop + 1) * hopSize());
+        }
+
+        beginTest ("A clear between the ready check and the read leaves the window alone");
+        {
+            const int64 windowEndPosition = overlapper.getWindowEndPosition();
+            writeUntilReady (ring, overlapper);
+            collector.clearBuffer();
+
+            expect (! overlapper.readNextHop());
+            expectEquals (overlapper.getWindowEndPosition(), windowEndPosition);
+            expectWindowEndsAt (overlapper, windowEndPosition);
+
+            /* the next hop starts from where the clear left the ring */
+            const int64 clearPosition = ring.getWritePosition();
+            writeUntilReady (ring, overlapper);
+            expect (overlapper.readNextHop());
+            expectWindowEndsAt (overlapper, clearPosition + hopSize());
+        }
+    }
+
+private:
+    void writeUntilReady (AudioCaptureRing& ring, RealTimeAudioDataOverlapper& overlapper)
+    {
+        float block[256];
+        jassert (blockSize() == numElementsInArray (block));
+
+        while (! overlapper.isNextBufferReady())
+        {
+            for (int i = 0; i < blockSize(); ++i)
+                block[i] = (float) (ring.getWritePosition() + i);
+
+            ring.write (block, blockSize());
+        }
+    }
+
+    void expectWindowEndsAt (const RealTimeAudioDataOverlapper& overlapper, int64 windowEndPosition)
+    {
+        expectEquals (overlapper.getWindowEndPosition(), windowEndPosition);
+
+        const AudioSampleBuffer& window = overlapper.getWindow();
+        const int numSamples = window.getNumSamples();
+        expectEquals (window.getSample (0, numSamples - 1), (float) (windowEndPosition - 1));
+        expectEquals (window.getSample (0, numSamples - hopSize()), (float) (windowEndPosition - hopSize()));
+    }
+};
+
+static OverlapperTest overlapperTest;
+
+//==============================================================================
+/* The collector's health counters, for reads that keep up, fall behind, get ahead and are cleared. */
+class CaptureStatsTest : public UnitTest
+{
+public:
+    CaptureStatsTest() : UnitTest ("Capture stats") {}
+
+    static int ringSize()   noexcept { return 4096; }
+    static int blockSize()  noexcept { return 256; }
+    static int readSize()   noexcept { return 512; }
+
+    void runTest() override
+    {
+        beginTest ("The fill level");
+        {
+            AudioCaptureRing ring (ringSize());
+            ring.addReader();
+            AudioDataCollector collector (ring);
+
+            write (ring, collector, ringSize() / 4);
+            readAndRelease (collector);
+
+            const CaptureStats stats = collector.getStats();
+            expectEquals (stats.getMaxFillProportion(), 0.25f);
+            expectEquals (stats.numOverruns, (int64) 0);
+            expectEquals (stats.numUnderruns, (int64) 0);
+            expectEquals (stats.samplesDropped, (int64) 0);
+        }
+
+        AudioCaptureRing ring (ringSize());
+        ring.addReader();
+        AudioDataCollector collector (ring);
+
+        beginTest ("Writing more than the ring holds before reading");
+        {
+            write (ring, collector, ringSize() + 4 * blockSize());
+            readAndRelease (collector);
+
+            /* the reader skips to the newest hop */
+            const CaptureStats stats = collector.getStats();
+            expectEquals (stats.numOverruns, (int64) 1);
+            expectEquals (stats.samplesDropped, (int64) (ringSize() + 4 * blockSize() - readSize()));
+            expectEquals (stats.getMaxFillProportion(), 1.0f);
+            expectEquals (stats.numUnderruns, (int64) 0);
+        }
+
+        beginTest ("Reading before the samples have arrived");
+        {
+            write (ring, collector, blockSize());
+            readAndRelease (collector);
+            expectEquals (collector.getStats().numUnderruns, (int64) 1);
+        }
+
+        beginTest ("A read cut short by a clear isn't an underrun");
+        {
+            write (ring, collector, readSize());
+            collector.clearBuffer();
+            readAndRelease (collector);
+            expectEquals (collector.getStats().numUnderruns, (int64) 1);
+            expectEquals (collector.getStats().numOverruns, (int64) 1);
+        }
+    }
+
+private:
+    /* Writes a ramp in device blocks, notifying the collector after each as the capture does. */
+    void write (AudioCaptureRing& ring, AudioDataCollector& collector, int numSamples)
+    {
+        float block[256];
+        jassert (blockSize() == numElementsInArray (block));
+
+        for (int written = 0; written < numSamples; written += blockSize())
+        {
+            for (int i = 0; i < blockSize(); ++i)
+                block[i] = (float) (ring.getWritePosition() + i);
+
+            ring.write (block, blockSize());
+            collector.notifyIfReady();
+        }
+    }
+
+    static void readAndRelease (AudioDataCollector& collector)
+    {
+        collector.finishedReading (collector.getAnalysisBufferView (readSize()));
+    }
+};
+
+static CaptureStatsTest captureStatsTest;
+
+//==============================================================================
+/*
+    Feeds an analyser a tone, then near-silence, then a level between the gate's thresholds, then a tone just
+    above the open threshold, and steps it hop by hop as run() would. Every hop holds whole segments of the
+    ring's level record and whole periods of the tone, so each hop's level is exactly the one written.
+*/
+class SilenceGateTest : public UnitTest
+{
+public:
+    SilenceGateTest() : UnitTest ("Silence gate") {}
+
+    static int    ringSize()    noexcept { return 8192; }
+    static int    blockSize()   noexcept { return 256; }
+    static int    windowSize()  noexcept { return 1920; }
+    static int    hopSize()     noexcept { return windowSize() / 4; }
+    static double sampleRate()  noexcept { return 48000.0; }
+
+    /* the default 250 ms hold, in hops */
+    static int numHoldHops() noexcept { return (int) std::ceil (SilenceGate::getDefaultHoldSeconds() * sampleRate() / hopSize()); }
+
+    void runTest() override
+    {
+        AudioCaptureRing ring (ringSize());
+        ring.addReader();
+        AudioDataCollector collector (ring);
+        AudioFeatures features;
+        CountingStage stage;
+        RealTimeAnalyser analyser (collector, features, windowSize(), sampleRate());
+        analyser.getOverlapper().setHopSize (hopSize());
+        analyser.addStage (&stage);
+
+        beginTest ("A tone is analysed");
+        {
+            for (int hop = 0; hop < 10; ++hop)
+                expect (! readHop (ring, analyser, -20.0f), "gated the tone at hop " + String (hop));
+
+            expectEquals (stage.numFrames, 10);
+            expectEquals (stage.numSilentFrames, 0);
+        }
+
+        beginTest ("The gate closes after the hold below the close threshold");
+        {
+            /* the first hop below the close threshold starts the hold, and the gate closes on the hop that completes it */
+            for (int hop = 0; hop < numHoldHops() - 1; ++hop)
+                expect (! readHop (ring, analyser, SilenceGate::getDefaultCloseThresholdDb() - 4.0f), "closed early, at hop " + String (hop));
+
+            expect (readHop (ring, analyser, SilenceGate::getDefaultCloseThresholdDb() - 4.0f), "didn't close after the hold");
+
+            for (int hop = 0; hop < 10; ++hop)
+                expect (readHop (ring, analyser, SilenceGate::getDefaultCloseThresholdDb() - 4.0f));
+
+            expectEquals (stage.numSilentFrames, 11);
+        }
+
+        beginTest ("A level between the thresholds doesn't reopen it");
+        {
+            for (int hop = 0; hop < 5; ++hop)
+                expect (readHop (ring, analyser, -63.0f), "reopened below the open threshold");
+
+            expectEquals (stage.numSilentFrames, 16);
+        }
+
+        beginTest ("The first hop above the open threshold reopens it");
+        {
+            expect (! readHop (ring, analyser, SilenceGate::getDefaultOpenThresholdDb() + 1.0f), "didn't reopen");
+            expect (! readHop (ring, analyser, -63.0f), "closed again without a hold");
+            expectEquals (stage.numSilentFrames, 16);
+        }
+
+        beginTest ("The capture stats count the gated frames");
+        {
+            const CaptureStats stats = collector.getStats();
+            expectEquals (stats.numFrames, (int64) (stage.numFrames + stage.numSilentFrames));
+            expectEquals (stats.numGatedFrames, (int64) stage.numSilentFrames);
+            expectEquals (stats.numUnderruns, (int64) 0);
+            expectEquals (stats.numOverruns, (int64) 0);
+        }
+    }
+
+private:
+    struct CountingStage : public AnalysisStage
+    {
+        void processFrame (const AnalysisFrame&, AudioFeatures&) override        { ++numFrames; }
+        void processSilentFrame (const AnalysisFrame&, AudioFeatures&) override  { ++numSilentFrames; }
+
+        int numFrames       { 0 };
+        int numSilentFrames { 0 };
+    };
+
+    /* Writes the next hop of a 1 kHz tone at levelDb (dBFS RMS), analyses it and returns whether it was gated. */
+    bool readHop (AudioCaptureRing& ring, RealTimeAnalyser& analyser, float levelDb)
+    {
+        const float amplitude = Decibels::decibelsToGain (levelDb) * std::sqrt (2.0f);
+        const int64 hopEnd    = ring.getWritePosition() + hopSize();
+        float block[256];
+        jassert (blockSize() == numElementsInArray (block));
+
+        while (! analyser.readNextWindowIfReady())
+        {
+            /* the hop's level stays the same to its last sample, whatever the block size */
+            const int numSamples = (int) jmin ((int64) blockSize(), hopEnd - ring.getWritePosition());
+            jassert (numSamples > 0);
+
+            for (int i = 0; i < numSamples; ++i)
+                block[i] = amplitude * std::sin ((float) (2.0 * double_Pi * 1000.0 * (double) ((ring.getWritePosition() + i) % 48) / sampleRate()));
+
+            ring.write (block, numSamples);
+        }
+
+        if (analyser.isFrameGated())
+        {
+            analyser.processSilentFrame();
+            return true;
+        }
+
+        analyser.getFFTAnalyser().computeSpectrum (analyser.getWindowedAudio(), windowSize());
+        analyser.processBatchedFrame();
+        return false;
+    }
+};
+
+static SilenceGateTest silenceGateTest;
+
+//==============================================================================
+/*
+    The capture buffer's write and read as they were before the ring was copied in blocks: a per-sample
+    modulo loop for any block that wraps, and a per-sample read with the gain applied. (The old read also
+    allocated a new AudioSampleBuffer for every hop, which isn't timed here.)
+*/
+struct ReferenceCaptureBuffer
+{
+    ReferenceCaptureBuffer (int size)
+    {
+        buffer.setSize (1, size);
+        buffer.clear();
+    }
+
+    void write (const float* data, int numSamples)
+    {
+        if (writeIndex + numSamples <= buffer.getNumSamples())
+        {
+            buffer.copyFrom (0, writeIndex, data, numSamples);
+        }
+        else
+        {
+            for (int index = 0; index < numSamples; index++)
+            {
+                const int modIndex = (index + writeIndex) % buffer.getNumSamples();
+                buffer.setSample (0, modIndex, data[index]);
+            }
+        }
+
+        writeIndex = (writeIndex + numSamples) % buffer.getNumSamples();
+    }
+
+    void read (float* destination, int numSamples, float gain)
+    {
+        const bool wrap = readIndex + numSamples > buffer.getNumSamples();
+
+        for (int index = 0; index < numSamples; index++)
+        {
+            int rIndex = index + readIndex;
+
+            if (wrap)
+                rIndex = rIndex % buffer.getNumSamples();
+
+            destination[index] = buffer.getReadPointer (0)[rIndex] * gain;
+        }
+
+        readIndex = (readIndex + numSamples) % buffer.getNumSamples();
+    }
+
+    AudioSampleBuffer buffer;
+    int writeIndex { 0 };
+    int readIndex  { 0 };
+};
+
+//==============================================================================
+/*
+    Times writing device blocks into the capture ring, and reading them back with the collector's gain, 
+    against the reference buffer. The first write is a few samples long so later blocks straddle the end 
+    of the ring, as they do when the device block size doesn't divide it.
+*/
+class CaptureBenchmark : public UnitTest
+{
+public:
+    CaptureBenchmark() : UnitTest ("Capture benchmark") {}
+
+    static int   ringSize()     noexcept { return 4096; }
+    static int   startOffset()  noexcept { return 37; }
+    static int   maxBlockSize() noexcept { return 1024; }
+    static float gain()         noexcept { return 0.7f; }
+
+    void runTest() override
+    {
+        HeapBlock<float> source ((size_t) maxBlockSize()), destination ((size_t) maxBlockSize()), 
+                         referenceDestination ((size_t) maxBlockSize());
+        Random random (1);
+
+        for (int i = 0; i < maxBlockSize(); ++i)
+            source[i] = random.nextFloat() * 2.0f - 1.0f;
+
+        const int blockSizes[] = { 64, 256, 1024 };
+
+        for (const int blockSize : blockSizes)
+        {
+            beginTest ("Blocks of " + String (blockSize) + " samples");
+            checkReadsMatch (source, blockSize);
+
+            const int numBlocks = (1 << 27) / blockSize;
+            volatile float sink = 0.0f;
+
+            ReferenceCaptureBuffer reference (ringSize());
+            reference.write (source, startOffset());
+            const double oldWrite = getNanosecondsPerCall (numBlocks, [&] { reference.write (source, blockSize); });
+
+            reference.readIndex = reference.writeIndex;
+            const double oldRead = getNanosecondsPerCall (numBlocks, [&] 
+            { 
+                reference.read (referenceDestination, blockSize, gain());
+                sink += referenceDestination[0];
+            });
+
+            AudioCaptureRing ring (ringSize());
+            ring.addReader();
+            AudioDataCollector collector (ring);
+            collector.setGain (gain());
+            ring.write (source, startOffset());
+            const double newWrite = getNanosecondsPerCall (numBlocks, [&] { ring.write (source, blockSize); });
+
+            /* advancing the ring's clock is the only cost the read loop adds to the read */
+            collector.clearBuffer();
+            const double newRead = getNanosecondsPerCall (numBlocks, [&] 
+            {
+                ring.advance (blockSize);
+                const AudioDataCollector::AnalysisBufferView view = collector.getAnalysisBufferView (blockSize);
+                collector.copyViewWithGain (view, destination);
+                collector.finishedReading (view);
+                sink += destination[0];
+            });
+
+            logMessage (String (blockSize) + " sample blocks (old -> new): write " + String (oldWrite, 1) + " -> " 
+                        + String (newWrite, 1) + " ns, read with gain " + String (oldRead, 1) + " -> " 
+                        + String (newRead, 1) + " ns");
+        }
+    }
+
+private:
+    /* The ring and collector should read back exactly what the reference does. */
+    void checkReadsMatch (const float* source, int blockSize)
+    {
+        HeapBlock<float> destination ((size_t) blockSize), referenceDestination ((size_t) blockSize);
+        AudioCaptureRing ring (ringSize());
+        ring.addReader();
+        AudioDataCollector collector (ring);
+        ReferenceCaptureBuffer reference (ringSize());
+
+        /* the collector ramps to its gain over the first read */
+        collector.setGain (gain());
+        ring.write (source, startOffset());
+        reference.write (source, startOffset());
+        readBlock (collector, startOffset(), destination);
+        reference.read (referenceDestination, startOffset(), gain());
+
+        float maxDifference = 0.0f;
+
+        for (int block = 0; block < 2 * ringSize() / blockSize; ++block)
+        {
+            ring.write (source, blockSize);
+            reference.write (source, blockSize);
+            readBlock (collector, blockSize, destination);
+            reference.read (referenceDestination, blockSize, gain());
+
+            for (int i = 0; i < blockSize; ++i)
+                maxDifference = jmax (maxDifference, std::abs (destination[i] - referenceDestination[i]));
+        }
+
+        expectEquals (maxDifference, 0.0f);
+    }
+
+    static void readBlock (AudioDataCollector& collector, int numSamples, float* destination)
+    {
+        const AudioDataCollector::AnalysisBufferView view = collector.getAnalysisBufferView (numSamples);
+        collector.copyViewWithGain (view, destination);
+        collector.finishedReading (view);
+    }
+
+    template <typename Function>
+    static double getNanosecondsPerCall (int numCalls, Function function)
+    {
+        const int64 startTicks = Time::getHighResolutionTicks();
+
+        for (int i = 0; i < numCalls; ++i)
+            function();
+
+        return Time::highResolutionTicksToSeconds (Time::getHighResolutionTicks() - startTicks) * 1.0e9 / numCalls;
+    }
+};
+
+static CaptureBenchmark captureBenchmark;
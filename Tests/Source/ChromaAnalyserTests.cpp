@@ -0,0 +1,80 @@
+/*
+  ==============================================================================
+
+    ChromaAnalyserTests.cpp
+    Created: 21 Nov 2016 7:48:22pm
+    Author:  Sean
+
+  ==============================================================================
+*/
+
+#include "TestIncludes.h"
+
+//==============================================================================
+/* Where A440 lands in the chromagram, and how the tuning offset moves it. */
+class ChromaAnalyserTest : public UnitTest
+{
+public:
+    ChromaAnalyserTest() : UnitTest ("ChromaAnalyser") {}
+
+    /* 10 Hz bins, so 440 Hz is exactly bin 44 */
+    static int    windowSize() noexcept { return 4800; }
+    static double sampleRate() noexcept { return 48000.0; }
+    static int    a440Bin()    noexcept { return 44; }
+
+    void runTest() override
+    {
+        ChromaAnalyser analyser (windowSize(), sampleRate());
+        HeapBlock<float> powerSpectrum ((size_t) windowSize() / 2, true);
+        powerSpectrum[a440Bin()] = 1.0f;
+
+        beginTest ("A440 is all in bin 0");
+        expectOnlyBin (analyser.calculateChroma (powerSpectrum, windowSize() / 2), analyser.getNumBins(), 0);
+
+        beginTest ("Tuning down a semitone moves A440 to bin 1");
+        analyser.setResolutionAndTuning (ChromaAnalyser::defaultBinsPerOctave, -100.0);
+        expectOnlyBin (analyser.calculateChroma (powerSpectrum, windowSize() / 2), analyser.getNumBins(), 1);
+
+        beginTest ("Tuning up a third of a semitone moves A440 to the last of 36 bins");
+        analyser.setResolutionAndTuning (36, 100.0 / 3.0);
+        expectOnlyBin (analyser.calculateChroma (powerSpectrum, windowSize() / 2), analyser.getNumBins(), 35);
+
+        beginTest ("Tuning up a quarter tone splits A440 between bins 11 and 0");
+        {
+            analyser.setResolutionAndTuning (ChromaAnalyser::defaultBinsPerOctave, 50.0);
+            const float* chroma = analyser.calculateChroma (powerSpectrum, windowSize() / 2);
+
+            for (int bin = 0; bin < analyser.getNumBins(); ++bin)
+                expectWithinAbsoluteError (chroma[bin], bin == 0 || bin == 11 ? 1.0f : 0.0f, 1.0e-4f);
+        }
+
+        beginTest ("A windowed A440 tone peaks in bin 0");
+        {
+            const int toneWindowSize = 1920;
+            ChromaAnalyser toneAnalyser (toneWindowSize, sampleRate());
+            FFTAnalyser fft (toneWindowSize, sampleRate());
+            RealTimeWindower windower;
+            windower.setWindowSize (toneWindowSize);
+            AnalysisFrame frame (toneWindowSize);
+
+            for (int i = 0; i < toneWindowSize; ++i)
+                frame.windowedAudio.setSample (0, i, std::sin ((float) (2.0 * double_Pi * 440.0 * i / sampleRate())));
+
+            windower.applyWindow (frame.windowedAudio);
+            frame.spectrum = fft.computeSpectrum (frame.windowedAudio.getReadPointer (0), toneWindowSize);
+            frame.updatePowerSpectrum();
+
+            const float* chroma = toneAnalyser.calculateChroma (frame.getPowerSpectrum(), frame.getNumBins());
+            expectEquals ((int) (std::max_element (chroma, chroma + toneAnalyser.getNumBins()) - chroma), 0);
+        }
+    }
+
+private:
+    void expectOnlyBin (const float* chroma, int numBins, int expectedBin)
+    {
+        for (int bin = 0; bin < numBins; ++bin)
+            expectWithinAbsoluteError (chroma[bin], bin == expectedBin ? 1.0f : 0.0f, 1.0e-4f);
+    }
+};
+
+static ChromaAnalyserTest chromaAnalyserTest;
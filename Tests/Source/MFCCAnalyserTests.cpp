@@ -0,0 +1,50 @@
+/*
+  ==============================================================================
+
+    MFCCAnalyserTests.cpp
+    Created: 21 Nov 2016 7:31:05pm
+    Author:  Sean
+
+  ==============================================================================
+*/
+
+#include "TestIncludes.h"
+
+//==============================================================================
+/*
+    The gated path publishes getSilentMFCCs() without running the filterbank or the DCT, so it has to be
+    exactly what calculateMFCCs() gives for a spectrum with no energy, for every size the tracks use.
+*/
+class MFCCAnalyserTest : public UnitTest
+{
+public:
+    MFCCAnalyserTest() : UnitTest ("MFCCAnalyser") {}
+
+    void runTest() override
+    {
+        const int windowSizes[]                = { 480, 1920, 7680 };
+        const int numCoefficientsAndBands[][2] = { { MFCCAnalyser::defaultNumCoefficients, MFCCAnalyser::defaultNumBands }, { 20, 26 }, { 40, 40 } };
+
+        for (const int windowSize : windowSizes)
+        {
+            for (const auto& configuration : numCoefficientsAndBands)
+            {
+                beginTest ("Silent coefficients, a window of " + String (windowSize) + " samples, " + String (configuration[0])
+                           + " coefficients from " + String (configuration[1]) + " bands");
+
+                MFCCAnalyser analyser (windowSize, 48000.0, configuration[0], configuration[1]);
+                HeapBlock<float> zeroSpectrum ((size_t) windowSize / 2, true);
+                HeapBlock<float> silentCoefficients ((size_t) configuration[0]);
+
+                FloatVectorOperations::copy (silentCoefficients, analyser.getSilentMFCCs(), configuration[0]);
+                const float* coefficients = analyser.calculateMFCCs (zeroSpectrum, windowSize / 2);
+
+                /* coefficient 0 is about -146 for 40 bands, and the float DCT sums 40 terms of that size */
+                for (int k = 0; k < configuration[0]; ++k)
+                    expectWithinAbsoluteError (silentCoefficients[k], coefficients[k], 1.0e-3f);
+            }
+        }
+    }
+};
+
+static MFCCAnalyserTest mfccAnalyserTest;
@@ -0,0 +1,87 @@
+/*
+  ==============================================================================
+
+    Main.cpp
+    Created: 21 Nov 2016 4:02:11pm
+    Author:  Sean
+
+    Runs the unit tests, and with --benchmarks the benchmarks too. Returns 1 if
+    any test fails.
+
+  ==============================================================================
+*/
+
+#include "TestIncludes.h"
+#include <new>
+
+//==============================================================================
+/*
+    Every allocation the process makes is counted, so tests can check that the real-time paths don't
+    allocate. JUCE's HeapBlock (and so AudioBuffer) allocates with malloc rather than new, so on Linux
+    malloc itself is replaced as well; elsewhere only new is counted.
+*/
+static Atomic<int64> numAllocations;
+
+int64 getNumAllocations() noexcept { return numAllocations.get(); }
+
+#if JUCE_LINUX
+ extern "C"
+ {
+     void* __libc_malloc (size_t);
+     void* __libc_calloc (size_t, size_t);
+     void* __libc_realloc (void*, size_t);
+
+     void* malloc (size_t size) noexcept                { ++numAllocations; return __libc_malloc (size); }
+     void* calloc (size_t num, size_t size) noexcept    { ++numAllocations; return __libc_calloc (num, size); }
+     void* realloc (void* block, size_t size) noexcept  { ++numAllocations; return __libc_realloc (block, size); }
+ }
+
+ static void* allocateUncounted (size_t size) noexcept  { return __libc_malloc (size); }
+#else
+ static void* allocateUncounted (size_t size) noexcept  { return std::malloc (size); }
+#endif
+
+void* operator new (size_t size)
+{
+    ++numAllocations;
+
+    if (void* block = allocateUncounted (size > 0 ? size : 1))
+        return block;
+
+    throw std::bad_alloc();
+}
+
+void* operator new[] (size_t size)                      { return operator new (size); }
+void  operator delete (void* block) noexcept            { std::free (block); }
+void  operator delete[] (void* block) noexcept          { std::free (block); }
+void  operator delete (void* block, size_t) noexcept    { std::free (block); }
+void  operator delete[] (void* block, size_t) noexcept  { std::free (block); }
+
+//==============================================================================
+static bool isBenchmark (UnitTest& test) { return test.getName().endsWith ("benchmark"); }
+
+int main (int argc, char* argv[])
+{
+    bool runBenchmarks = false;
+
+    for (int i = 1; i < argc; ++i)
+        if (String (argv[i]) == "--benchmarks")
+            runBenchmarks = true;
+
+    Array<UnitTest*> tests;
+
+    for (UnitTest* test : UnitTest::getAllTests())
+        if (runBenchmarks || ! isBenchmark (*test))
+            tests.add (test);
+
+    UnitTestRunner runner;
+    runner.setAssertOnFailure (false);
+    runner.runTests (tests);
+
+    int numFailures = 0;
+
+    for (int i = 0; i < runner.getNumResults(); ++i)
+        numFailures += runner.getResult (i)->failures;
+
+    return numFailures > 0 ? 1 : 0;
+}
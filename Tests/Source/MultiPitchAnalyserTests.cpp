@@ -0,0 +1,133 @@
+/*
+  ==============================================================================
+
+    MultiPitchAnalyserTests.cpp
+    Created: 21 Nov 2016 7:12:40pm
+    Author:  Sean
+
+  ==============================================================================
+*/
+
+#include "TestIncludes.h"
+
+//==============================================================================
+/* A multi-pitch analyser and the frame it reads, as the multi-pitch stage is set up for a medium window. */
+struct MultiPitchAnalyserFixture
+{
+    static int    windowSize() noexcept { return 1920; }
+    static double sampleRate() noexcept { return 48000.0; }
+
+    /* C4, E4 and G4 */
+    static const double* chord() noexcept
+    {
+        static const double frequencies[] = { 261.63, 329.63, 392.0 };
+        return frequencies;
+    }
+
+    enum { numChordNotes = 3 };
+
+    MultiPitchAnalyserFixture()
+    :   analyser (windowSize(), sampleRate()),
+        fft      (windowSize(), sampleRate()),
+        frame    (windowSize()),
+        random   (1)
+    {
+        windower.setWindowSize (windowSize());
+        frame.nyquist = sampleRate() / 2.0;
+    }
+
+    /* Each note has six harmonics, falling off as 1 / harmonic. */
+    void fillChord()
+    {
+        frame.windowedAudio.clear();
+
+        for (int note = 0; note < numChordNotes; ++note)
+            for (int harmonic = 1; harmonic <= 6; ++harmonic)
+                for (int i = 0; i < windowSize(); ++i)
+                    frame.windowedAudio.addSample (0, i, 0.1f * std::sin ((float) (2.0 * double_Pi * chord()[note] * harmonic * i / sampleRate())) / (float) harmonic);
+
+        updateFrame();
+    }
+
+    void fillNoise()
+    {
+        for (int i = 0; i < windowSize(); ++i)
+            frame.windowedAudio.setSample (0, i, 0.3f * (random.nextFloat() * 2.0f - 1.0f));
+
+        updateFrame();
+    }
+
+    int estimate()
+    {
+        return analyser.estimatePitches (frame.getPowerSpectrum(), frame.getNumBins(), frame.peaks);
+    }
+
+    MultiPitchAnalyser analyser;
+    FFTAnalyser        fft;
+    RealTimeWindower   windower;
+    AnalysisFrame      frame;
+    Random             random;
+
+private:
+    void updateFrame()
+    {
+        windower.applyWindow (frame.windowedAudio);
+        frame.spectrum = fft.computeSpectrum (frame.windowedAudio.getReadPointer (0), windowSize());
+        frame.updatePowerSpectrum();
+        frame.updatePeaks();
+    }
+};
+
+//==============================================================================
+class MultiPitchAnalyserTest : public UnitTest
+{
+public:
+    MultiPitchAnalyserTest() : UnitTest ("MultiPitchAnalyser") {}
+
+    void runTest() override
+    {
+        MultiPitchAnalyserFixture fixture;
+
+        beginTest ("Finds the three notes of a C major triad");
+        {
+            fixture.fillChord();
+            expectEquals (fixture.estimate(), (int) MultiPitchAnalyserFixture::numChordNotes);
+
+            for (int note = 0; note < MultiPitchAnalyserFixture::numChordNotes; ++note)
+            {
+                const double expected = MultiPitchAnalyserFixture::chord()[note];
+                double closestCents = std::numeric_limits<double>::max();
+
+                for (int pitch = 0; pitch < fixture.analyser.getNumPitches(); ++pitch)
+                    closestCents = jmin (closestCents, std::abs (1200.0 * log2 (fixture.analyser.getFrequencies()[pitch] / expected)));
+
+                logMessage (String (expected) + " Hz found within " + String (closestCents) + " cents");
+                expect (closestCents <= 5.0, String (expected) + " Hz is " + String (closestCents) + " cents from the closest pitch");
+            }
+        }
+
+        beginTest ("Finds no pitches in white noise");
+        {
+            for (int i = 0; i < 20; ++i)
+            {
+                fixture.fillNoise();
+                expectEquals (fixture.estimate(), 0);
+            }
+        }
+
+        beginTest ("Estimating doesn't allocate");
+        {
+            fixture.fillChord();
+            fixture.estimate();
+
+            const int64 numAllocationsBefore = getNumAllocations();
+
+            for (int i = 0; i < 100; ++i)
+                fixture.estimate();
+
+            expectEquals (getNumAllocations() - numAllocationsBefore, (int64) 0);
+        }
+    }
+};
+
+static MultiPitchAnalyserTest multiPitchAnalyserTest;
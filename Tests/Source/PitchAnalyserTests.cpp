@@ -0,0 +1,361 @@
+/*
+  ==============================================================================
+
+    PitchAnalyserTests.cpp
+    Created: 21 Nov 2016 5:24:52pm
+    Author:  Sean
+
+  ==============================================================================
+*/
+
+#include "TestIncludes.h"
+
+//==============================================================================
+/* A pitch analyser set up as the harmonic stage sets it up, holding the spectrum of a windowed harmonic tone. */
+struct PitchAnalyserFixture
+{
+    static int    windowSize()  noexcept { return 1920; }
+    static double sampleRate()  noexcept { return 48000.0; }
+    static double toneF0()      noexcept { return 220.0; }
+
+    PitchAnalyserFixture (double f0 = toneF0())
+    :   fft           (windowSize(), sampleRate()),
+        pitchAnalyser (fft),
+        audio         ((size_t) windowSize())
+    {
+        pitchAnalyser.setAnalysisWindow (WindowTable::get (WindowTable::enHann, windowSize()));
+        setTone (f0);
+    }
+
+    /* Replaces the spectrum with that of a five harmonic tone at f0. */
+    void setTone (double f0)
+    {
+        for (int i = 0; i < windowSize(); ++i)
+        {
+            audio[i] = 0.0f;
+
+            for (int harmonic = 1; harmonic <= 5; ++harmonic)
+                audio[i] += std::sin ((float) (2.0 * double_Pi * f0 * harmonic * i / sampleRate())) / (float) harmonic;
+        }
+
+        WindowTable::get (WindowTable::enHann, windowSize()).apply (audio);
+        fft.computeSpectrum (audio, windowSize());
+    }
+
+    /* One frame's worth of pitch analysis, as HarmonicAnalysisStage::processFrame() does it. */
+    double estimate()
+    {
+        const double pitch = pitchAnalyser.estimatePitch (fft.getSpectrum(), windowSize() * 2);
+        pitchAnalyser.findPitchCandidates();
+        return pitch;
+    }
+
+    FFTAnalyser      fft;
+    PitchAnalyser    pitchAnalyser;
+    HeapBlock<float> audio;
+};
+
+//==============================================================================
+class PitchAnalyserAllocationTest : public UnitTest
+{
+public:
+    PitchAnalyserAllocationTest() : UnitTest ("PitchAnalyser allocations") {}
+
+    void runTest() override
+    {
+        PitchAnalyserFixture fixture;
+        fixture.estimate();
+
+        beginTest ("Estimating doesn't allocate");
+        {
+            const int64 numAllocationsBefore = getNumAllocations();
+
+            for (int i = 0; i < 100; ++i)
+            {
+                /* the GUI's display requests are served from the same preallocated buffers */
+                if (i % 10 == 0)
+                    fixture.pitchAnalyser.enableAutoCorrelationBufferToDrawNeedsUpdating();
+
+                fixture.estimate();
+            }
+
+            expectEquals (getNumAllocations() - numAllocationsBefore, (int64) 0);
+        }
+
+        beginTest ("Estimates the tone's pitch");
+        expectWithinAbsoluteError (fixture.estimate(), PitchAnalyserFixture::toneF0(), 2.0);
+    }
+};
+
+static PitchAnalyserAllocationTest pitchAnalyserAllocationTest;
+
+//==============================================================================
+/* The lag search only covers setPitchRange(), and its longest lag is cut to what two periods in the window allow. */
+class PitchAnalyserRangeTest : public UnitTest
+{
+public:
+    PitchAnalyserRangeTest() : UnitTest ("PitchAnalyser pitch range") {}
+
+    void runTest() override
+    {
+        beginTest ("A tone below the range isn't found");
+        {
+            PitchAnalyserFixture fixture (150.0);
+            fixture.pitchAnalyser.setPitchRange (300.0, 1000.0);
+            expectOutsideTone (fixture, 150.0);
+        }
+
+        beginTest ("A tone above the range isn't found");
+        {
+            PitchAnalyserFixture fixture (1500.0);
+            fixture.pitchAnalyser.setPitchRange (100.0, 1000.0);
+            expectOutsideTone (fixture, 1500.0);
+        }
+
+        beginTest ("A tone near the minimum pitch, with the longest lag clamped to the window");
+        {
+            /* 48 kHz / 40 Hz is a 1200 sample lag, but the search has to stop at windowSize / 2 - 1 = 959, or 50.05 Hz */
+            const double lowestPitch = PitchAnalyserFixture::sampleRate() / (PitchAnalyserFixture::windowSize() / 2 - 1);
+            PitchAnalyserFixture fixture (52.0);
+            fixture.pitchAnalyser.setPitchRange (40.0, 2000.0);
+
+            expectWithinAbsoluteError (fixture.estimate(), 52.0, lowToneTolerance (52.0));
+            expectCandidatesWithin (fixture, lowestPitch, 2000.0);
+
+            fixture.setTone (55.0);
+            expectWithinAbsoluteError (fixture.estimate(), 55.0, lowToneTolerance (55.0));
+        }
+
+        beginTest ("The default range reaches the clamped lag");
+        {
+            PitchAnalyserFixture fixture (51.0);
+            expectWithinAbsoluteError (fixture.estimate(), 51.0, lowToneTolerance (51.0));
+        }
+    }
+
+private:
+    /* A quarter tone: with barely two periods in the window, the windowed estimate runs a little sharp. */
+    static double lowToneTolerance (double frequency) noexcept { return frequency * 0.029; }
+
+    /* Every estimate and candidate stays within the range, so none is the tone's own pitch. */
+    void expectOutsideTone (PitchAnalyserFixture& fixture, double toneFrequency)
+    {
+        const double minPitch = fixture.pitchAnalyser.getMinPitch();
+        const double maxPitch = fixture.pitchAnalyser.getMaxPitch();
+        const double estimate = fixture.estimate();
+
+        expect (std::abs (estimate - toneFrequency) > toneFrequency * 0.05, "estimated the out of range tone: " + String (estimate));
+        expectCandidatesWithin (fixture, minPitch, maxPitch);
+
+        const PitchCandidates& candidates = fixture.pitchAnalyser.findPitchCandidates();
+
+        for (int i = 0; i < candidates.numCandidates; ++i)
+            expect (std::abs (candidates.frequencies[i] - toneFrequency) > toneFrequency * 0.05,
+                    "found a candidate at the out of range tone: " + String (candidates.frequencies[i]));
+    }
+
+    /* Allows a sample's worth of interpolation past the ends of the lag search. */
+    void expectCandidatesWithin (PitchAnalyserFixture& fixture, double minPitch, double maxPitch)
+    {
+        const double sampleRate = PitchAnalyserFixture::sampleRate();
+        const double lowest     = sampleRate / (std::ceil (sampleRate / minPitch) + 1.0);
+        const double highest    = sampleRate / (std::floor (sampleRate / maxPitch) - 1.0);
+        const PitchCandidates& candidates = fixture.pitchAnalyser.findPitchCandidates();
+
+        for (int i = 0; i < candidates.numCandidates; ++i)
+            expect (candidates.frequencies[i] >= lowest && candidates.frequencies[i] <= highest,
+                    "candidate outside the range: " + String (candidates.frequencies[i]));
+    }
+};
+
+static PitchAnalyserRangeTest pitchAnalyserRangeTest;
+
+//==============================================================================
+/* A harmonic stage fed frames as its analyser would feed them, a hop apart. */
+struct HarmonicStageFixture
+{
+    static int windowSize() noexcept { return PitchAnalyserFixture::windowSize(); }
+    static int hopSize()    noexcept { return windowSize() / 2; }
+
+    HarmonicStageFixture()
+    :   stage (windowSize(), PitchAnalyserFixture::sampleRate()),
+        fft   (windowSize(), PitchAnalyserFixture::sampleRate()),
+        frame (windowSize()),
+        audio (1, windowSize()),
+        random (1)
+    {
+        windower.setWindowSize (windowSize());
+        frame.audio   = &audio;
+        frame.nyquist = PitchAnalyserFixture::sampleRate() / 2.0;
+    }
+
+    void processTone (double f0)
+    {
+        for (int i = 0; i < windowSize(); ++i)
+        {
+            const double t = (double) (numFrames * hopSize() + i) / PitchAnalyserFixture::sampleRate();
+            float sample = 0.0f;
+
+            for (int harmonic = 1; harmonic <= 5; ++harmonic)
+                sample += 0.2f * std::sin ((float) (2.0 * double_Pi * f0 * harmonic * t)) / (float) harmonic;
+
+            audio.setSample (0, i, sample);
+        }
+
+        processFrame();
+    }
+
+    void processNoise()
+    {
+        for (int i = 0; i < windowSize(); ++i)
+            audio.setSample (0, i, 0.5f * (random.nextFloat() * 2.0f - 1.0f));
+
+        processFrame();
+    }
+
+    /* The sample position processFrame() gave the frame processed numFramesAgo frames before the latest. */
+    int64 getFramePosition (int numFramesAgo) const noexcept { return (int64) (numFrames - 1 - numFramesAgo) * hopSize(); }
+
+    float getF0() const { return features.getValue (AudioFeatures::eAudioFeature::enF0) * 5000.0f; }
+
+    HarmonicAnalysisStage stage;
+    FFTAnalyser           fft;
+    RealTimeWindower      windower;
+    AnalysisFrame         frame;
+    AudioSampleBuffer     audio;
+    AudioFeatures         features;
+    Random                random;
+    int                   numFrames { 0 };
+
+private:
+    void processFrame()
+    {
+        frame.windowedAudio.copyFrom (0, 0, audio, 0, 0, windowSize());
+        windower.applyWindow (frame.windowedAudio);
+        frame.spectrum       = fft.computeSpectrum (frame.windowedAudio.getReadPointer (0), windowSize());
+        frame.samplePosition = (int64) numFrames * hopSize();
+        frame.updatePowerSpectrum();
+        frame.updatePeaks();
+        stage.processFrame (frame, features);
+        ++numFrames;
+    }
+};
+
+//==============================================================================
+class PitchTrackerTest : public UnitTest
+{
+public:
+    PitchTrackerTest() : UnitTest ("PitchTracker") {}
+
+    void runTest() override
+    {
+        beginTest ("A glide through octave errors is tracked without jumping");
+        {
+            for (int lag : { 0, 3 })
+            {
+                PitchTracker tracker;
+                tracker.setDecodingLag (lag);
+
+                for (int i = 0; i < 40; ++i)
+                {
+                    const PitchTrack track = tracker.processFrame (getGlideCandidates (i), i);
+
+                    expect (track.isVoiced, "unvoiced at frame " + String (track.samplePosition));
+                    expectWithinAbsoluteError (track.frequency, getGlidePitch ((int) track.samplePosition), 
+                                               getGlidePitch ((int) track.samplePosition) * 0.01);
+                }
+            }
+        }
+
+        beginTest ("Noise is unvoiced, with no pitch");
+        {
+            HarmonicStageFixture fixture;
+
+            for (int i = 0; i < 30; ++i)
+                fixture.processTone (220.0);
+
+            expectWithinAbsoluteError (fixture.getF0(), 220.0f, 3.0f);
+            expect (fixture.features.getValue (AudioFeatures::eAudioFeature::enPitchConfidence) > 0.5f, "the tone has a low confidence");
+
+            for (int i = 0; i < 30; ++i)
+                fixture.processNoise();
+
+            /* the features average their last 10 values, so every one of those was 0 */
+            expectEquals (fixture.getF0(), 0.0f);
+            expect (fixture.features.getValue (AudioFeatures::eAudioFeature::enPitchConfidence) < 0.5f, "the noise has a high confidence");
+            expectEquals (fixture.features.getValue (AudioFeatures::eAudioFeature::enHarmonicEnergyRatio), 0.0f);
+        }
+
+        beginTest ("The pitch is decided the tracking lag's frames late");
+        {
+            for (int lag : { 0, 1, 4, PitchTracker::maxLookback - 1 })
+            {
+                HarmonicStageFixture fixture;
+                fixture.stage.setPitchTrackingLag (lag);
+                expectEquals (fixture.stage.getPitchTracker().getDecodingLag(), lag);
+
+                for (int i = 0; i < PitchTracker::maxLookback * 2; ++i)
+                {
+                    fixture.processTone (220.0);
+                    const int decidedLag = jmin (lag, i);
+
+                    expectEquals (fixture.features.getSamplePosition (AudioFeatures::eAudioFeature::enF0), fixture.getFramePosition (decidedLag));
+                    expectEquals (fixture.features.getSamplePosition (AudioFeatures::eAudioFeature::enHarmonicEnergyRatio), fixture.getFramePosition (0));
+                }
+            }
+        }
+    }
+
+private:
+    /* A rise of a major third over 40 frames, half a tracker bin per frame. */
+    static double getGlidePitch (int frame) noexcept { return 200.0 * std::pow (2.0, frame / 120.0); }
+
+    /* YIN's candidates for the glide: usually the octave above is the weaker, but every seventh frame it is the stronger. */
+    static PitchCandidates getGlideCandidates (int frame) noexcept
+    {
+        const bool  isOctaveError = frame % 7 == 3;
+        const float f0            = (float) getGlidePitch (frame);
+
+        PitchCandidates candidates;
+        candidates.add (f0 * 2.0f, isOctaveError ? 0.7f : 0.3f);
+        candidates.add (f0,        isOctaveError ? 0.2f : 0.6f);
+        return candidates;
+    }
+};
+
+static PitchTrackerTest pitchTrackerTest;
+
+//==============================================================================
+class PitchAnalyserBenchmark : public UnitTest
+{
+public:
+    PitchAnalyserBenchmark() : UnitTest ("PitchAnalyser benchmark") {}
+
+    void runTest() override
+    {
+        const int numEstimates = 2000;
+        PitchAnalyserFixture fixture;
+
+        beginTest ("estimatePitch() and findPitchCandidates()");
+
+        for (int i = 0; i < 100; ++i)
+            fixture.estimate();
+
+        const int64 numAllocationsBefore = getNumAllocations();
+        const int64 startTicks           = Time::getHighResolutionTicks();
+
+        for (int i = 0; i < numEstimates; ++i)
+            fixture.estimate();
+
+        const double seconds = Time::highResolutionTicksToSeconds (Time::getHighResolutionTicks() - startTicks);
+        const int64 numAllocations = getNumAllocations() - numAllocationsBefore;
+
+        logMessage ("Window of " + String (PitchAnalyserFixture::windowSize()) + " samples: "
+                    + String (seconds * 1.0e6 / numEstimates, 2) + " us and "
+                    + String ((double) numAllocations / numEstimates, 2) + " allocations per estimate");
+
+        expectEquals (numAllocations, (int64) 0);
+    }
+};
+
+static PitchAnalyserBenchmark pitchAnalyserBenchmark;
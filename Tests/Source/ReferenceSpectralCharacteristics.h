@@ -0,0 +1,180 @@
+/*
+  ==============================================================================
+
+    ReferenceSpectralCharacteristics.h
+    Created: 21 Nov 2016 6:37:15pm
+    Author:  Sean
+
+  ==============================================================================
+*/
+
+#ifndef REFERENCESPECTRALCHARACTERISTICS_H_INCLUDED
+#define REFERENCESPECTRALCHARACTERISTICS_H_INCLUDED
+
+//==============================================================================
+/*
+    The spectral descriptors as they were calculated before the fused single-pass kernel in 
+    SpectralCharacteristicsAnalyser: separate passes in double precision, and the slope from its own 
+    two passes. Kept so the kernel's results and speed can be compared against it.
+*/
+class ReferenceSpectralCharacteristicsAnalyser
+{
+public:
+    ReferenceSpectralCharacteristicsAnalyser (int numSamplesPerWindow) 
+    {
+        setWindowSize (numSamplesPerWindow);
+    }
+
+    /* Resets the flux history to match a new window size. */
+    void setWindowSize (int numSamplesPerWindow)
+    {
+        previousBinMagnitudes.setSize (numSamplesPerWindow / 2);
+        previousBinMagnitudes.clear();
+    }
+
+    struct IntermediateSpectralCharacteristics
+    {
+        double weightedMagnitudeSum = 0.0;
+        double varMagnitudeSum      = 0.0;
+        double magnitudeSum         = 0.0;
+        double magnitudeProduct     = 1.0;
+        double flatnessMagnitudeSum = 0.0;
+        double flux                 = 0.0;
+        double lhr                  = 0.0;
+        double numMagnitudesUsedInFlatnessCalculation = 0.0;
+
+        float calculateFlatness (double eps, double invNumMagnitudes)
+        {
+            return flatnessMagnitudeSum > eps ? (float) (pow (magnitudeProduct, invNumMagnitudes) / (invNumMagnitudes * flatnessMagnitudeSum)) : 0.0f;
+        }
+
+        void fillIntermediateValues (const float* powerSpectrum, const float* previousBinMags, int numMagnitudes, double eps, double nyquist)
+        {
+            double frequencyRangePerBin = nyquist / numMagnitudes;
+            int lowerPortion = numMagnitudes / 5;
+            for (int magnitude = 0; magnitude < numMagnitudes; magnitude++)
+            {
+                //bin k is centred on k * sampleRate / windowSize, whatever the window size
+                double binCentreFrequency = double(magnitude) * frequencyRangePerBin;
+                double binMagnitude = (double) powerSpectrum[magnitude];
+
+                /*flux*/
+                double diff = binMagnitude - (double) previousBinMags[magnitude];
+                if (diff > 0.0)
+                    flux += diff;
+                ///////
+            
+                magnitudeSum += binMagnitude;
+            
+                if (magnitude == lowerPortion)
+                    lhr = magnitudeSum;
+
+                if (binMagnitude > eps)
+                {
+                    flatnessMagnitudeSum += binMagnitude;
+                    magnitudeProduct     *= binMagnitude;
+                    numMagnitudesUsedInFlatnessCalculation ++;
+                }
+                weightedMagnitudeSum += binCentreFrequency * binMagnitude;
+            }
+        }
+    };
+
+    /* powerSpectrum holds numMagnitudes bins, from 0 Hz up to (but not including) nyquist. */
+    SpectralCharacteristics calculateSpectralCharacteristics (const float* powerSpectrum, int numMagnitudes, double rms, double nyquist)
+    {
+        IntermediateSpectralCharacteristics intermediates;
+        jassert (previousBinMagnitudes.getSize() == numMagnitudes);
+        double eps = 0.01 * rms;
+        intermediates.fillIntermediateValues (powerSpectrum, previousBinMagnitudes.getData(), numMagnitudes, eps, nyquist);
+        
+        float maxFlux = (numMagnitudes * (numMagnitudes + 1)) / 2.0f;
+        intermediates.flux /= maxFlux;
+        return calculateSpectralCharacteristicsFromIntermediates (intermediates, powerSpectrum, eps, nyquist, numMagnitudes);
+    }
+
+    SpectralCharacteristics calculateSpectralCharacteristicsFromIntermediates (IntermediateSpectralCharacteristics intermediates, 
+                                                                               const float* powerSpectrum,
+                                                                               double eps,
+                                                                               double nyquist,
+                                                                               int numMagnitudes)
+    {
+        double epsSum = 0.05;
+        if (!(intermediates.magnitudeSum > epsSum))
+            return {0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f};
+
+        intermediates.lhr /= intermediates.magnitudeSum;
+
+        float centroid = (float) (intermediates.weightedMagnitudeSum / intermediates.magnitudeSum);
+        
+        const double flatnessMags = intermediates.numMagnitudesUsedInFlatnessCalculation;
+        double invNumMagnitudes = 1.0 / (flatnessMags > 0.0 ? flatnessMags : 1.0);
+        float flatness = intermediates.calculateFlatness (eps, invNumMagnitudes);
+        float logFlatness = log10 (flatness * 9.0 + 1.0);
+        float c = centroid / (float)(nyquist / 2.0);
+        float logCentroid = log10 (c * 9.0f + 1.0f);
+        const double normalisedCentroid = centroid / nyquist;
+        const double normalisedBinWidth = 1.0 / (double) numMagnitudes;
+        for (int i = 0; i < numMagnitudes; ++i)
+        {
+            const double distance = (double) i * normalisedBinWidth - normalisedCentroid;
+            intermediates.varMagnitudeSum += distance * distance * (double) powerSpectrum[i];
+        }
+        FloatVectorOperations::copy (previousBinMagnitudes.getData(), powerSpectrum, numMagnitudes);
+        float maxSpread = (float) ((centroid / nyquist) * (1.0 - (centroid / nyquist)));
+        float spread = (float) ((intermediates.varMagnitudeSum / intermediates.magnitudeSum) / maxSpread);
+        return {logCentroid, spread, logFlatness, (float) intermediates.lhr, (float) intermediates.flux, 0.0f};
+    }
+
+    float calculateNormalisedSpectralSlope (const float* powerSpectrum, int numMagnitudes)
+    {
+        //calc means
+        double meanBin = 0.5;
+        double meanEnergy = 0.0;
+        double prodSum = 0.0;
+        const double maxFFTMagnitude = (double) FloatVectorOperations::findMaximum (powerSpectrum, numMagnitudes);
+
+        double eps = 0.0001;
+        if (! (maxFFTMagnitude > eps))
+            return 0.0f;
+        
+        const double invMaxFFTMagnitude = 1.0 / maxFFTMagnitude;
+        for (int i = 0; i < (int) numMagnitudes; i++)
+        {
+            double normedEnergy = (double) powerSpectrum[i] * invMaxFFTMagnitude;
+            jassert (normedEnergy >= 0.0 && normedEnergy <= 1.0);
+            meanEnergy += normedEnergy;
+            prodSum += (double)i * normedEnergy;
+        }
+        meanEnergy /= (double) numMagnitudes;
+        
+        //calc std devs
+        double binVar = 0.0;
+        double energyVar = 0.0;
+        for (int i = 0; i < numMagnitudes; i++)
+        {
+            double normedI = (double) i / (double) numMagnitudes;
+            binVar += (normedI - meanBin) * (normedI - meanBin);
+            double normedEnergy = (double) powerSpectrum[i] * invMaxFFTMagnitude;
+            energyVar += (normedEnergy - meanEnergy) * (normedEnergy - meanEnergy);
+        }
+        binVar /= (double) numMagnitudes;
+        energyVar /= (double) numMagnitudes;
+        double binStd = sqrt (binVar);
+        double energyStd = sqrt (energyVar);
+        
+        //calculate sample correlation coefficient
+        double rMagBin = (prodSum - (numMagnitudes * meanEnergy * meanBin)) / (numMagnitudes - 1.0f) * energyStd * binStd;
+        
+        //calculate gradient of best fit
+        double grad = rMagBin * (binStd / energyStd);
+        return (float) grad;
+    }
+
+private:
+    AlignedFloatBuffer previousBinMagnitudes;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (ReferenceSpectralCharacteristicsAnalyser)
+};
+
+#endif  // REFERENCESPECTRALCHARACTERISTICS_H_INCLUDED
@@ -0,0 +1,222 @@
+/*
+  ==============================================================================
+
+    SpectralCharacteristicsTests.cpp
+    Created: 21 Nov 2016 6:37:15pm
+    Author:  Sean
+
+  ==============================================================================
+*/
+
+#include "TestIncludes.h"
+#include "ReferenceSpectralCharacteristics.h"
+
+//==============================================================================
+/* Power spectra of a few shapes for the descriptors to be measured on, plus both analysers. */
+struct SpectralCharacteristicsFixture
+{
+    enum { numDescriptors = 6 };
+
+    static int    numMagnitudes() noexcept { return 960; }
+    static double rms()           noexcept { return 0.3; }
+    static double nyquist()       noexcept { return 24000.0; }
+
+    SpectralCharacteristicsFixture()
+    :   analyser          (numMagnitudes() * 2),
+        referenceAnalyser (numMagnitudes() * 2),
+        powerSpectrum     ((size_t) numMagnitudes()),
+        random            (1)
+    {}
+
+    /* Noise, a single narrow peak over a near-silent floor, a falling slope and a spiky spectrum, in turn. */
+    void fillSpectrum (int index)
+    {
+        for (int k = 0; k < numMagnitudes(); ++k)
+        {
+            const float r = random.nextFloat();
+
+            switch (index % 4)
+            {
+                case 0:  powerSpectrum[k] = r; break;
+                case 1:  powerSpectrum[k] = std::abs (k - index % numMagnitudes()) < 3 ? 50.0f * r : 1.0e-4f * r; break;
+                case 2:  powerSpectrum[k] = 10.0f / (float) (1 + k) * r; break;
+                default: powerSpectrum[k] = r * random.nextFloat() * random.nextFloat() * 3.0f; break;
+            }
+        }
+    }
+
+    /* Fills both arrays with the descriptors of the current spectrum, in the order getName() lists them. */
+    void calculate (float* values, float* referenceValues)
+    {
+        getValues (analyser.calculateSpectralCharacteristics (powerSpectrum, numMagnitudes(), rms(), nyquist()), values);
+        getValues (referenceAnalyser.calculateSpectralCharacteristics (powerSpectrum, numMagnitudes(), rms(), nyquist()), referenceValues);
+        referenceValues[5] = referenceAnalyser.calculateNormalisedSpectralSlope (powerSpectrum, numMagnitudes());
+    }
+
+    static void getValues (const SpectralCharacteristics& s, float* values) noexcept
+    {
+        values[0] = s.centroid;
+        values[1] = s.spread;
+        values[2] = s.flatness;
+        values[3] = s.ler;
+        values[4] = s.flux;
+        values[5] = s.slope;
+    }
+
+    static String getName (int descriptor)
+    {
+        const char* const names[] = { "centroid", "spread", "flatness", "LER", "flux", "slope" };
+        return names[descriptor];
+    }
+
+    SpectralCharacteristicsAnalyser          analyser;
+    ReferenceSpectralCharacteristicsAnalyser referenceAnalyser;
+    HeapBlock<float>                         powerSpectrum;
+    Random                                   random;
+};
+
+//==============================================================================
+/*
+    The fused kernel sums in float lanes where the reference summed in double, so the two aren't identical,
+    but every descriptor should stay well within what an OSC receiver could notice.
+*/
+class SpectralCharacteristicsAccuracyTest : public UnitTest
+{
+public:
+    SpectralCharacteristicsAccuracyTest() : UnitTest ("Spectral characteristics against the reference") {}
+
+    void runTest() override
+    {
+        const float tolerances[] = { 1.0e-6f, 1.0e-4f, 1.0e-6f, 1.0e-6f, 1.0e-9f, 1.0e-5f };
+        float maxDifferences[SpectralCharacteristicsFixture::numDescriptors] = {};
+        SpectralCharacteristicsFixture fixture;
+
+        beginTest ("Descriptors of 2000 spectra");
+
+        for (int i = 0; i < 2000; ++i)
+        {
+            fixture.fillSpectrum (i);
+
+            float values[SpectralCharacteristicsFixture::numDescriptors], referenceValues[SpectralCharacteristicsFixture::numDescriptors];
+            fixture.calculate (values, referenceValues);
+
+            for (int d = 0; d < SpectralCharacteristicsFixture::numDescriptors; ++d)
+            {
+                /* 
+                    The reference's running product of the bins underflows to 0 on quiet spectra, which it reports as 
+                    a flatness of 0. The kernel sums logs instead, so those frames can't be compared.
+                */
+                if (d == 2 && referenceValues[d] == 0.0f)
+                    continue;
+
+                maxDifferences[d] = jmax (maxDifferences[d], std::abs (values[d] - referenceValues[d]));
+            }
+        }
+
+        for (int d = 0; d < SpectralCharacteristicsFixture::numDescriptors; ++d)
+        {
+            logMessage ("Largest " + SpectralCharacteristicsFixture::getName (d) + " difference: " + String (maxDifferences[d]));
+            expect (maxDifferences[d] <= tolerances[d], SpectralCharacteristicsFixture::getName (d) + " differs from the reference by "
+                                                        + String (maxDifferences[d]));
+        }
+    }
+};
+
+static SpectralCharacteristicsAccuracyTest spectralCharacteristicsAccuracyTest;
+
+//==============================================================================
+/* Rolloff and crest of spectra whose answers can be worked out by hand. */
+class ExtendedSpectralCharacteristicsTest : public UnitTest
+{
+public:
+    ExtendedSpectralCharacteristicsTest() : UnitTest ("Extended spectral characteristics") {}
+
+    void runTest() override
+    {
+        const int numMagnitudes = SpectralCharacteristicsFixture::numMagnitudes();
+        SpectralCharacteristicsFixture fixture;
+        ExtendedSpectralCharacteristicsAnalyser extendedAnalyser (numMagnitudes * 2, SpectralCharacteristicsFixture::nyquist() * 2.0);
+
+        beginTest ("All the energy in one bin");
+        {
+            const int bin = numMagnitudes / 4;
+            FloatVectorOperations::clear (fixture.powerSpectrum, numMagnitudes);
+            fixture.powerSpectrum[bin] = 2.0f;
+
+            const ExtendedSpectralCharacteristics e = calculate (fixture, extendedAnalyser);
+
+            /* every proportion of the energy is reached at the bin, and its peak is numMagnitudes times the mean */
+            expectEquals (e.rolloff85, (float) bin / (float) numMagnitudes);
+            expectEquals (e.rolloff95, (float) bin / (float) numMagnitudes);
+            expectWithinAbsoluteError (e.crest, 1.0f, 1.0e-6f);
+        }
+
+        beginTest ("A flat spectrum");
+        {
+            FloatVectorOperations::fill (fixture.powerSpectrum, 0.5f, numMagnitudes);
+
+            const ExtendedSpectralCharacteristics e = calculate (fixture, extendedAnalyser);
+
+            /* the cumulative energy first reaches 85% (95%) at bin ceil (0.85 * n) - 1 */
+            const float binWidth = 1.0f / (float) numMagnitudes;
+            expectWithinAbsoluteError (e.rolloff85, (std::ceil (0.85f * numMagnitudes) - 1.0f) * binWidth, binWidth);
+            expectWithinAbsoluteError (e.rolloff95, (std::ceil (0.95f * numMagnitudes) - 1.0f) * binWidth, binWidth);
+            expectWithinAbsoluteError (e.crest, 0.0f, 1.0e-6f);
+        }
+    }
+
+private:
+    static ExtendedSpectralCharacteristics calculate (SpectralCharacteristicsFixture& fixture, ExtendedSpectralCharacteristicsAnalyser& extendedAnalyser)
+    {
+        const int numMagnitudes = SpectralCharacteristicsFixture::numMagnitudes();
+        fixture.analyser.calculateSpectralCharacteristics (fixture.powerSpectrum, numMagnitudes, SpectralCharacteristicsFixture::rms(), 
+                                                           SpectralCharacteristicsFixture::nyquist(), true);
+        return extendedAnalyser.calculateExtendedSpectralCharacteristics (fixture.powerSpectrum, numMagnitudes, fixture.analyser.getPartialSums());
+    }
+};
+
+static ExtendedSpectralCharacteristicsTest extendedSpectralCharacteristicsTest;
+
+//==============================================================================
+class SpectralCharacteristicsBenchmark : public UnitTest
+{
+public:
+    SpectralCharacteristicsBenchmark() : UnitTest ("Spectral characteristics benchmark") {}
+
+    void runTest() override
+    {
+        const int numFrames = 20000;
+        const int numMagnitudes = SpectralCharacteristicsFixture::numMagnitudes();
+        const double rms = SpectralCharacteristicsFixture::rms();
+        const double nyquist = SpectralCharacteristicsFixture::nyquist();
+        SpectralCharacteristicsFixture fixture;
+        fixture.fillSpectrum (0);
+        volatile float sink = 0.0f;
+
+        beginTest ("Fused kernel against the reference, " + String (numMagnitudes) + " bins");
+
+        int64 startTicks = Time::getHighResolutionTicks();
+
+        for (int i = 0; i < numFrames; ++i)
+        {
+            const SpectralCharacteristics s = fixture.analyser.calculateSpectralCharacteristics (fixture.powerSpectrum, numMagnitudes, rms, nyquist);
+            sink += s.centroid + s.slope;
+        }
+
+        const double seconds = Time::highResolutionTicksToSeconds (Time::getHighResolutionTicks() - startTicks);
+        startTicks = Time::getHighResolutionTicks();
+
+        for (int i = 0; i < numFrames; ++i)
+        {
+            const SpectralCharacteristics s = fixture.referenceAnalyser.calculateSpectralCharacteristics (fixture.powerSpectrum, numMagnitudes, rms, nyquist);
+            sink += s.centroid + fixture.referenceAnalyser.calculateNormalisedSpectralSlope (fixture.powerSpectrum, numMagnitudes);
+        }
+
+        const double referenceSeconds = Time::highResolutionTicksToSeconds (Time::getHighResolutionTicks() - startTicks);
+
+        logMessage ("Per frame: " + String (seconds * 1.0e6 / numFrames, 2) + " us, against "
+                    + String (referenceSeconds * 1.0e6 / numFrames, 2) + " us for the reference");
+    }
+};
+
+static SpectralCharacteristicsBenchmark spectralCharacteristicsBenchmark;
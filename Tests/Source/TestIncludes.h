@@ -0,0 +1,32 @@
+/*
+  ==============================================================================
+
+    TestIncludes.h
+    Created: 21 Nov 2016 4:02:11pm
+    Author:  Sean
+
+  ==============================================================================
+*/
+
+#ifndef TESTINCLUDES_H_INCLUDED
+#define TESTINCLUDES_H_INCLUDED
+
+#include "../JuceLibraryCode/JuceHeader.h"
+
+#include "../../Source/AudioDataCollector.h"
+#include "../../Source/FFTBackend.h"
+#include "../../Source/RealTimeAudioAnalysis.h"
+#include "../../Source/PitchAnalyser.h"
+#include "../../Source/SpectralCharacteristics.h"
+#include "../../Source/ExtendedSpectralCharacteristics.h"
+#include "../../Source/MFCCAnalyser.h"
+#include "../../Source/ChromaAnalyser.h"
+#include "../../Source/MultiPitchAnalyser.h"
+#include "../../Source/HarmonicCharacteristics.h"
+#include "../../Source/AudioFeatures.h"
+#include "../../Source/RealTimeAnalyser.h"
+
+/* The number of heap allocations the process has made so far (see Main.cpp). */
+int64 getNumAllocations() noexcept;
+
+#endif  // TESTINCLUDES_H_INCLUDED